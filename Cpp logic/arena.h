@@ -0,0 +1,114 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "stats.h"
+using namespace std;
+
+const size_t ARENA_MAX_CHUNK = 16 * 1024 * 1024;
+
+class Arena {
+private:
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+        size_t used;
+    };
+
+    struct Finalizer {
+        void (*destroy)(void*);
+        void* object;
+        Finalizer* next;
+    };
+
+    Chunk* chunks;
+    Finalizer* finalizers;
+    size_t firstChunkSize;
+    size_t chunkSize;
+
+    template <typename T>
+    static void destroyObject(void* p) { static_cast<T*>(p)->~T(); }
+
+    static size_t alignUp(size_t n, size_t align) { return (n + align - 1) & ~(align - 1); }
+
+    static char* chunkData(Chunk* c) { return (char*)c + alignUp(sizeof(Chunk), alignof(max_align_t)); }
+
+    Chunk* newChunk(size_t minimum) {
+        size_t size = chunkSize;
+        while (size < minimum) size *= 2;
+        if (chunkSize < ARENA_MAX_CHUNK) chunkSize *= 2;
+        size_t header = alignUp(sizeof(Chunk), alignof(max_align_t));
+        Chunk* c = (Chunk*)::operator new(header + size);
+        c->next = chunks;
+        c->size = size;
+        c->used = 0;
+        chunks = c;
+        chunkCount++;
+        reservedBytes += header + size;
+        return c;
+    }
+
+public:
+    size_t allocatedBytes;
+    size_t reservedBytes;
+    int chunkCount;
+    int objectCount;
+
+    Arena(size_t firstChunk = 64 * 1024)
+        : chunks(NULL), finalizers(NULL), firstChunkSize(firstChunk), chunkSize(firstChunk),
+          allocatedBytes(0), reservedBytes(0), chunkCount(0), objectCount(0) {}
+
+    ~Arena() { release(); }
+
+    void* allocate(size_t size, size_t align = alignof(max_align_t)) {
+        Chunk* c = chunks;
+        size_t offset = (c != NULL) ? alignUp(c->used, align) : 0;
+        if (c == NULL || offset + size > c->size) {
+            c = newChunk(size);
+            offset = 0;
+        }
+        c->used = offset + size;
+        allocatedBytes += size;
+        return chunkData(c) + offset;
+    }
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!is_trivially_destructible<T>::value) {
+            Finalizer* f = (Finalizer*)allocate(sizeof(Finalizer), alignof(Finalizer));
+            f->destroy = &destroyObject<T>;
+            f->object = object;
+            f->next = finalizers;
+            finalizers = f;
+        }
+        objectCount++;
+        TRACE_COUNT(CTR_OBJECTS, 1);
+        TRACE_COUNT(CTR_OBJECT_BYTES, sizeof(T));
+        return object;
+    }
+
+    void release() {
+        for (Finalizer* f = finalizers; f != NULL; f = f->next) f->destroy(f->object);
+        finalizers = NULL;
+        while (chunks != NULL) {
+            Chunk* next = chunks->next;
+            ::operator delete(chunks);
+            chunks = next;
+        }
+        chunkSize = firstChunkSize;
+        allocatedBytes = 0;
+        reservedBytes = 0;
+        chunkCount = 0;
+        objectCount = 0;
+    }
+
+private:
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+};
+
+#endif
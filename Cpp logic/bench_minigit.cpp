@@ -0,0 +1,273 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+#include "minigit.h"
+#include "repository.h"
+#include "json.h"
+using namespace std;
+
+static long long allocations = 0;
+static long long allocatedBytes = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    allocatedBytes += (long long)size;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == NULL) throw bad_alloc();
+    return p;
+}
+
+class Sample {
+public:
+    long long allocs;
+    long long bytes;
+    long long nanos;
+    long long ops;
+
+    Sample() : allocs(0), bytes(0), nanos(0), ops(0) {}
+};
+
+class Timer {
+public:
+    Sample& sample;
+    long long count;
+    long long startAllocs;
+    long long startBytes;
+    chrono::steady_clock::time_point start;
+
+    Timer(Sample& s, long long n = 1)
+        : sample(s), count(n), startAllocs(allocations), startBytes(allocatedBytes), start(chrono::steady_clock::now()) {}
+
+    ~Timer() {
+        sample.nanos += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        sample.allocs += allocations - startAllocs;
+        sample.bytes += allocatedBytes - startBytes;
+        sample.ops += count;
+    }
+};
+
+long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+class Results {
+public:
+    JsonWriter json;
+    bool quiet;
+
+    Results(bool q) : quiet(q) {
+        json.beginObject().field("suite", "minigit").field("format", 1).key("results").beginArray();
+    }
+
+    void add(const char* group, const char* name, long long param, const Sample& s, long long bytesProcessed = 0) {
+        long long ops = s.ops > 0 ? s.ops : 1;
+        double nsPerOp = (double)s.nanos / ops;
+        json.beginObject().field("group", group).field("name", name).field("param", param).field("ops", s.ops);
+        json.field("nsPerOp", nsPerOp).field("bytesPerOp", (double)s.bytes / ops).field("allocsPerOp", (double)s.allocs / ops);
+        if (bytesProcessed > 0) json.field("mbPerSec", bytesProcessed * 1000.0 / (s.nanos > 0 ? s.nanos : 1));
+        json.field("peakRssKb", (long long)peakRssKb()).endObject();
+        if (quiet) return;
+        cout << "  " << group << "/" << name << "[" << param << "]: " << (long long)nsPerOp << " ns/op, "
+             << s.bytes / ops << " B/op, " << (double)s.allocs / ops << " alloc/op";
+        if (bytesProcessed > 0) cout << ", " << bytesProcessed * 1000 / (s.nanos > 0 ? s.nanos : 1) << " MB/s";
+        cout << "  (" << s.ops << " ops, peak RSS " << peakRssKb() << " KB)" << endl;
+    }
+
+    string finish(bool budgetOk) {
+        json.endArray().field("budgetOk", budgetOk).field("peakRssKb", (long long)peakRssKb()).endObject();
+        return json.out;
+    }
+};
+
+void benchHash(Results& results) {
+    int sizes[] = {64, 4096, 1 << 20};
+    for (int s = 0; s < 3; s++) {
+        string data(sizes[s], 'x');
+        for (int i = 0; i < sizes[s]; i++) data[i] = (char)(i * 31 + 7);
+        int rounds = (int)((64LL << 20) / sizes[s]);
+        if (rounds > 200000) rounds = 200000;
+        Sample sha, fast;
+        size_t sink = 0;
+        {
+            Timer t(sha, rounds);
+            for (int i = 0; i < rounds; i++) sink += generateHash(data).bytes[0];
+        }
+        {
+            Timer t(fast, rounds);
+            for (int i = 0; i < rounds; i++) sink += (size_t)fastHash(data);
+        }
+        if (sink == 1) cout << "";
+        results.add("hash", "generateHash", sizes[s], sha, (long long)rounds * sizes[s]);
+        results.add("hash", "fastHash", sizes[s], fast, (long long)rounds * sizes[s]);
+    }
+}
+
+void benchFileState(Results& results, int maxFiles) {
+    for (int n = 100; n <= maxFiles; n *= 10) {
+        BlobStore blobs;
+        FileState files(&blobs);
+        string* names = new string[n];
+        for (int i = 0; i < n; i++) names[i] = "src/dir" + to_string(i % 97) + "/file_" + to_string(i) + ".cpp";
+        Sample add, get, miss;
+        {
+            Timer t(add, n);
+            for (int i = 0; i < n; i++) files.addFile(names[i], names[i]);
+        }
+        long long found = 0;
+        {
+            Timer t(get, n);
+            for (int i = 0; i < n; i++) found += files.getFile(names[(int)((i * 7919LL) % n)]) != NULL;
+        }
+        string absent = "src/missing/file.cpp";
+        {
+            Timer t(miss, n);
+            for (int i = 0; i < n; i++) found += files.getFile(absent) != NULL;
+        }
+        if (found != n) cout << "  getFile found " << found << " of " << n << endl;
+        results.add("filestate", "addFile", n, add);
+        results.add("filestate", "getFile", n, get);
+        results.add("filestate", "getFile(miss)", n, miss);
+        delete[] names;
+    }
+}
+
+void benchHistory(Results& results, int maxDepth) {
+    ostream discard(NULL);
+    ConsoleCapture capture(discard);
+    MiniGit repo;
+    repo.init();
+    for (int i = 0; i < 200; i++) repo.add("tracked/file_" + to_string(i) + ".txt", "base " + to_string(i));
+    repo.commit("base");
+    repo.branch("side");
+
+    int depth = 1;
+    for (int target = 10; target <= maxDepth; target *= 10) {
+        while (depth < target - 20) {
+            repo.add("tracked/file_" + to_string(depth % 200) + ".txt", "rev " + to_string(depth));
+            repo.commit("history");
+            depth++;
+        }
+        Sample commit, checkout, merge, log;
+        for (int i = 0; i < 20; i++, depth++) {
+            repo.add("tracked/file_" + to_string(depth % 200) + ".txt", "rev " + to_string(depth));
+            Timer t(commit);
+            repo.commit("timed");
+        }
+        for (int i = 0; i < 10; i++) {
+            Timer t(checkout, 2);
+            repo.checkout("side");
+            repo.checkout("main");
+        }
+        for (int i = 0; i < 5; i++) {
+            repo.checkout("side");
+            repo.add("side/file_" + to_string(i) + ".txt", "side " + to_string(depth));
+            repo.commit("side work");
+            repo.checkout("main");
+            Timer t(merge);
+            repo.merge("side");
+        }
+        depth += 5;
+        LogOptions opts;
+        for (int i = 0; i < 3; i++) {
+            Timer t(log);
+            repo.log(opts);
+        }
+        results.add("history", "commit", target, commit);
+        results.add("history", "checkout", target, checkout);
+        results.add("history", "merge", target, merge);
+        results.add("history", "log", target, log);
+    }
+}
+
+void runCycles(int trackedFiles, int cycles, int changedPerCycle, Sample& add, Sample& commit) {
+    ostream discard(NULL);
+    ConsoleCapture capture(discard);
+    MiniGit repo;
+    repo.init();
+
+    string name, content;
+    name.reserve(64);
+    content.reserve(256);
+    for (int cycle = 0; cycle <= cycles; cycle++) {
+        int changed = (cycle == 0) ? trackedFiles : changedPerCycle;
+        for (int i = 0; i < changed; i++) {
+            int file = (cycle * 7 + i) % trackedFiles;
+            name.assign("src/module_");
+            name += to_string(file);
+            name += ".cpp";
+            content.assign("// generated source file\nint value = ");
+            content += to_string(cycle * 100000 + file);
+            content += ";\n";
+            if (cycle == 0) {
+                repo.add(name, content);
+                continue;
+            }
+            Timer t(add);
+            repo.add(name, content);
+        }
+
+        Sample ignored;
+        Timer t(cycle == 0 ? ignored : commit);
+        repo.commit("bench");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int cycles = 2000, maxFiles = 1000000, maxDepth = 10000;
+    bool jsonOnly = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--json") jsonOnly = true;
+        else if (arg == "--max-files" && i + 1 < argc) maxFiles = atoi(argv[++i]);
+        else if (arg == "--max-depth" && i + 1 < argc) maxDepth = atoi(argv[++i]);
+        else cycles = atoi(argv[i]);
+    }
+    Results results(jsonOnly);
+    if (!jsonOnly) cout << "\n  ========= MiniGit Allocation Benchmark =========\n" << endl;
+
+    bool blobOk = true, flatOk = true;
+    long long commitAllocs[2] = {0, 0};
+    double perBlob = 0;
+    int sizes[] = {10, 1000};
+    for (int s = 0; s < 2; s++) {
+        Sample add, commit;
+        runCycles(sizes[s], cycles, 4, add, commit);
+        Sample cycle = commit;
+        cycle.allocs += add.allocs;
+        cycle.bytes += add.bytes;
+        cycle.nanos += add.nanos;
+        cycle.ops = add.ops;
+        if (!jsonOnly) cout << "  --- " << sizes[s] << " tracked file(s), 4 changed per commit ---" << endl;
+        results.add("cycles", "add", sizes[s], add);
+        results.add("cycles", "commit", sizes[s], commit);
+        results.add("cycles", "cyclePerBlob", sizes[s], cycle);
+        if (cycle.allocs > cycle.ops) blobOk = false;
+        commitAllocs[s] = commit.allocs;
+        if ((double)cycle.allocs / cycle.ops > perBlob) perBlob = (double)cycle.allocs / cycle.ops;
+        if (!jsonOnly) cout << endl;
+    }
+    if (commitAllocs[1] > commitAllocs[0]) flatOk = false;
+    bool ok = blobOk && flatOk;
+
+    if (!jsonOnly) {
+        cout << "  Budget: add + commit <= 1 allocation per new blob: " << (blobOk ? "OK" : "EXCEEDED")
+             << " (" << perBlob << " per blob)" << endl;
+        cout << "  Budget: commit allocations independent of tree size: " << (flatOk ? "OK" : "EXCEEDED")
+             << " (" << commitAllocs[0] << " at " << sizes[0] << " files, " << commitAllocs[1] << " at " << sizes[1]
+             << ")" << endl << endl;
+        cout << "  ========= Throughput and Scaling =========\n" << endl;
+    }
+    benchHash(results);
+    benchFileState(results, maxFiles);
+    benchHistory(results, maxDepth);
+
+    string report = results.finish(ok);
+    if (jsonOnly) cout << report << endl;
+    else cout << "\n  Peak RSS: " << peakRssKb() << " KB (run with --json for machine-readable output)" << endl << endl;
+    return ok ? 0 : 1;
+}
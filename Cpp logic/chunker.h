@@ -0,0 +1,197 @@
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "minigit.h"
+#include "objectstore.h"
+using namespace std;
+
+const size_t CHUNK_MIN_SIZE = 16 * 1024;
+const size_t CHUNK_AVG_SIZE = 64 * 1024;
+const size_t CHUNK_MAX_SIZE = 256 * 1024;
+const size_t CHUNK_THRESHOLD = 1024 * 1024;
+const size_t CHUNK_READ_SIZE = 1024 * 1024;
+const u64 CHUNK_MASK_STRICT = 0xa94a52a529400000ULL;
+const u64 CHUNK_MASK_LOOSE = 0x9249224924800000ULL;
+
+class GearTable {
+public:
+    u64 values[256];
+
+    GearTable() {
+        u64 x = 0x6d696e6967697421ULL;
+        for (int i = 0; i < 256; i++) {
+            x += 0x9e3779b97f4a7c15ULL;
+            u64 z = x;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            values[i] = z ^ (z >> 31);
+        }
+    }
+};
+
+const u64* gearTable() {
+    static GearTable table;
+    return table.values;
+}
+
+size_t cutPoint(const char* data, size_t n) {
+    if (n <= CHUNK_MIN_SIZE) return n;
+    if (n > CHUNK_MAX_SIZE) n = CHUNK_MAX_SIZE;
+    size_t normal = n < CHUNK_AVG_SIZE ? n : CHUNK_AVG_SIZE;
+    const u64* gear = gearTable();
+    const unsigned char* p = (const unsigned char*)data;
+    u64 h = 0;
+    size_t i = CHUNK_MIN_SIZE;
+    for (; i < normal; i++) {
+        h = (h << 1) + gear[p[i]];
+        if ((h & CHUNK_MASK_STRICT) == 0) return i + 1;
+    }
+    for (; i < n; i++) {
+        h = (h << 1) + gear[p[i]];
+        if ((h & CHUNK_MASK_LOOSE) == 0) return i + 1;
+    }
+    return n;
+}
+
+class Chunker {
+private:
+    ObjectStore& store;
+    BlobStore& blobs;
+    Blob** parts;
+    int count;
+    int capacity;
+    u64 total;
+
+    Chunker(const Chunker&);
+    Chunker& operator=(const Chunker&);
+
+    Blob* chunk(string_view data) {
+        u64 fast = fastHash(data);
+        Blob* known = blobs.match(data, fast);
+        if (known != NULL) return known;
+        BlobId id(generateHash(data));
+        hashedBytes += (long long)data.length();
+        freshChunks++;
+        if (!store.isOpen()) return blobs.intern(data, id, fast);
+        int type;
+        u64 storedFast, size;
+        const char* mapped;
+        if ((store.has(id) || store.write(OBJ_BLOB, id, fast, data))
+            && store.read(id, type, storedFast, mapped, size) && type == OBJ_BLOB)
+            return blobs.adopt(id, fast, mapped, size);
+        return blobs.intern(data, id, fast);
+    }
+
+    void push(string_view data) {
+        if (count == capacity) parts = growArray(parts, count, capacity);
+        parts[count++] = chunk(data);
+        total += data.length();
+    }
+
+    Blob* finish() {
+        string list = encodeChunkList(parts, count, total);
+        Blob* blob = blobs.adoptChunks(BlobId(generateHash(list)), fastHash(list), parts, count, total);
+        count = 0;
+        total = 0;
+        return blob;
+    }
+
+public:
+    long long hashedBytes;
+    int freshChunks;
+
+    Chunker(ObjectStore& s, BlobStore& b)
+        : store(s), blobs(b), parts(NULL), count(0), capacity(0), total(0), hashedBytes(0), freshChunks(0) {}
+
+    ~Chunker() { delete[] parts; }
+
+    Blob* fromMemory(string_view content) {
+        while (!content.empty()) {
+            size_t cut = cutPoint(content.data(), content.length());
+            push(content.substr(0, cut));
+            content.remove_prefix(cut);
+        }
+        return finish();
+    }
+
+    Blob* fromFile(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return NULL;
+        char* buffer = new char[CHUNK_READ_SIZE];
+        size_t start = 0, end = 0;
+        bool eof = false, failed = false;
+        while (!failed) {
+            while (!eof && end < CHUNK_READ_SIZE) {
+                ssize_t n = ::read(fd, buffer + end, CHUNK_READ_SIZE - end);
+                if (n < 0) failed = true;
+                if (n <= 0) eof = true;
+                else end += (size_t)n;
+            }
+            while (end - start >= CHUNK_MAX_SIZE || (eof && end > start)) {
+                size_t cut = cutPoint(buffer + start, end - start);
+                push(string_view(buffer + start, cut));
+                start += cut;
+            }
+            if (eof) break;
+            memmove(buffer, buffer + start, end - start);
+            end -= start;
+            start = 0;
+        }
+        delete[] buffer;
+        ::close(fd);
+        if (failed) {
+            count = 0;
+            total = 0;
+            return NULL;
+        }
+        return finish();
+    }
+};
+
+bool writeBlob(Blob* blob, const string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = true;
+    for (int i = 0; i < blob->pieces() && ok; i++) {
+        string_view part = blob->piece(i);
+        while (ok && !part.empty()) {
+            ssize_t n = ::write(fd, part.data(), part.length());
+            ok = n > 0;
+            if (ok) part.remove_prefix((size_t)n);
+        }
+    }
+    return ::close(fd) == 0 && ok;
+}
+
+bool beforeBlob(Blob* a, Blob* b) { return a < b; }
+
+int sharedChunks(Blob* a, Blob* b) {
+    if (!a->isChunked() || !b->isChunked()) return 0;
+    Blob** left = new Blob*[a->chunkCount > 0 ? a->chunkCount : 1];
+    Blob** right = new Blob*[b->chunkCount > 0 ? b->chunkCount : 1];
+    copy(a->chunks, a->chunks + a->chunkCount, left);
+    copy(b->chunks, b->chunks + b->chunkCount, right);
+    sort(left, left + a->chunkCount, beforeBlob);
+    sort(right, right + b->chunkCount, beforeBlob);
+    int shared = 0, i = 0, j = 0;
+    while (i < a->chunkCount && j < b->chunkCount) {
+        if (left[i] < right[j]) i++;
+        else if (right[j] < left[i]) j++;
+        else {
+            shared++;
+            i++;
+            j++;
+        }
+    }
+    delete[] left;
+    delete[] right;
+    return shared;
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef COMMITGRAPH_H
+#define COMMITGRAPH_H
+
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include "minigit.h"
+#include "tree.h"
+#include "objectstore.h"
+using namespace std;
+
+const u32 COMMIT_GRAPH_VERSION = 1;
+const int COMMIT_GRAPH_HEADER_SIZE = 20;
+const int COMMIT_GRAPH_RECORD_SIZE = 40;
+
+class PathKeys : public TreeVisitor {
+public:
+    u64* keys;
+    int count;
+    int capacity;
+    u64* words;
+    int wordCapacity;
+    string path;
+
+    PathKeys() : keys(NULL), count(0), capacity(0), words(NULL), wordCapacity(0) {}
+
+    ~PathKeys() {
+        delete[] keys;
+        delete[] words;
+    }
+
+    void changed(const string& path, Blob* before, Blob* after) {
+        (void)before;
+        (void)after;
+        if (count > BLOOM_MAX_PATHS) return;
+        if (count == capacity) keys = growArray(keys, count, capacity);
+        keys[count++] = fastHash(path);
+    }
+
+    u64* clearWords(int n) {
+        if (n > wordCapacity) {
+            delete[] words;
+            wordCapacity = max(n, wordCapacity * 2);
+            words = new u64[wordCapacity];
+        }
+        fill(words, words + n, 0);
+        return words;
+    }
+
+private:
+    PathKeys(const PathKeys&);
+    PathKeys& operator=(const PathKeys&);
+};
+
+void buildPathFilter(Commit* c, PathKeys& paths) {
+    Commit* p = c->parent();
+    paths.count = 0;
+    paths.path.clear();
+    diffTrees(p != NULL ? p->tree : NULL, c->tree, paths.path, paths);
+    if (paths.count > BLOOM_MAX_PATHS) {
+        c->graph->setBloom(c->node, NULL, BLOOM_SATURATED);
+        return;
+    }
+    int n = bloomWordsFor(paths.count);
+    u64* words = paths.clearWords(n > 0 ? n : 1);
+    for (int i = 0; i < paths.count; i++) bloomAdd(words, n, paths.keys[i]);
+    c->graph->setBloom(c->node, words, n);
+}
+
+void buildPathFilter(Commit* c) {
+    PathKeys paths;
+    buildPathFilter(c, paths);
+}
+
+bool olderCommit(Commit* a, Commit* b) {
+    if (a->generation() != b->generation()) return a->generation() < b->generation();
+    return a->commitId < b->commitId;
+}
+
+string encodeCommitGraph(CommitIndex& index) {
+    int n = index.count;
+    Commit** order = new Commit*[n > 0 ? n : 1];
+    for (int i = 0; i < n; i++) order[i] = index.at(i);
+    sort(order, order + n, olderCommit);
+    CommitGraph* g = n > 0 ? order[0]->graph : NULL;
+    int* position = new int[g != NULL ? g->nodeCount : 1];
+    for (int i = 0; i < n; i++) position[order[i]->node] = i;
+
+    string records, edges, blooms;
+    u32 edgeCount = 0, wordCount = 0;
+    for (int i = 0; i < n; i++) {
+        Commit* c = order[i];
+        int node = c->node;
+        putId(records, c->commitId);
+        putU32(records, (u32)c->generation());
+        putU32(records, edgeCount);
+        putU32(records, (u32)c->parentCount());
+        for (int p = 0; p < c->parentCount(); p++) {
+            Commit* parent = c->parent(p);
+            Commit* indexed = parent != NULL ? index.find(parent->commitId) : NULL;
+            putU32(edges, indexed != NULL ? (u32)position[indexed->node] : 0xffffffffu);
+            edgeCount++;
+        }
+        putU32(records, wordCount);
+        putU32(records, (u32)g->bloomWords[node]);
+        for (int w = 0; w < g->bloomWords[node]; w++) {
+            putU64(blooms, g->bloomArena[g->bloomStart[node] + w]);
+            wordCount++;
+        }
+    }
+    delete[] order;
+    delete[] position;
+
+    string out = "MGCG";
+    putU32(out, COMMIT_GRAPH_VERSION);
+    putU32(out, (u32)n);
+    putU32(out, edgeCount);
+    putU32(out, wordCount);
+    return out + records + edges + blooms;
+}
+
+int loadCommitGraph(string_view data, CommitIndex& index) {
+    const unsigned char* p = (const unsigned char*)data.data();
+    if (data.length() < (size_t)COMMIT_GRAPH_HEADER_SIZE || data.substr(0, 4) != "MGCG"
+        || readU32(p + 4) != COMMIT_GRAPH_VERSION)
+        return 0;
+    u64 n = readU32(p + 8), edgeCount = readU32(p + 12), wordCount = readU32(p + 16);
+    u64 edgeStart = COMMIT_GRAPH_HEADER_SIZE + n * COMMIT_GRAPH_RECORD_SIZE;
+    u64 bloomStart = edgeStart + edgeCount * 4;
+    if (bloomStart + wordCount * 8 != data.length()) return 0;
+
+    int loaded = 0;
+    u64* words = new u64[wordCount > 0 ? wordCount : 1];
+    for (u64 w = 0; w < wordCount; w++) words[w] = readU64(p + bloomStart + w * 8);
+    for (u64 i = 0; i < n; i++) {
+        const unsigned char* r = p + COMMIT_GRAPH_HEADER_SIZE + i * COMMIT_GRAPH_RECORD_SIZE;
+        Commit* c = index.find(ObjectId::fromRaw(r));
+        if (c == NULL || (u32)c->generation() != readU32(r + 20) || (u32)c->parentCount() != readU32(r + 28)) continue;
+        u32 first = readU32(r + 32);
+        int count = (int)readU32(r + 36);
+        if (count == BLOOM_UNKNOWN || (count > 0 && (u64)first + count > wordCount)) continue;
+        c->graph->setBloom(c->node, words + first, count);
+        loaded++;
+    }
+    delete[] words;
+    return loaded;
+}
+
+bool isAncestor(Commit* ancestor, Commit* c) {
+    if (ancestor == NULL || c == NULL || ancestor->graph != c->graph) return false;
+    CommitGraph* g = c->graph;
+    int floor = ancestor->generation();
+    unsigned char* seen = new unsigned char[g->nodeCount]();
+    int top = 0, capacity = 16;
+    int* stack = new int[capacity];
+    stack[top++] = c->node;
+    seen[c->node] = 1;
+    bool found = false;
+    while (top > 0 && !found) {
+        int node = stack[--top];
+        if (node == ancestor->node) found = true;
+        for (int i = 0; i < g->parentCounts[node]; i++) {
+            int p = g->parent(node, i);
+            if (seen[p] || g->generations[p] < floor) continue;
+            seen[p] = 1;
+            if (top == capacity) stack = growArray(stack, top, capacity);
+            stack[top++] = p;
+        }
+    }
+    delete[] seen;
+    delete[] stack;
+    return found;
+}
+
+#endif
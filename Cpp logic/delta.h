@@ -0,0 +1,146 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include "digest.h"
+using namespace std;
+
+const int DELTA_BLOCK = 16;
+const int DELTA_OP_INSERT = 0;
+const int DELTA_OP_COPY = 1;
+
+void putVarint(string& out, u64 v) {
+    while (v >= 0x80) {
+        out += (char)((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+bool getVarint(const unsigned char*& p, const unsigned char* end, u64& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char b = *p++;
+        v |= (u64)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+u64 blockHash(const char* p) {
+    u64 a, b;
+    memcpy(&a, p, 8);
+    memcpy(&b, p + 8, 8);
+    u64 h = (a ^ (b * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL;
+    return h ^ (h >> 29);
+}
+
+void emitInsert(string& out, string_view target, size_t from, size_t to) {
+    if (to <= from) return;
+    out += (char)DELTA_OP_INSERT;
+    putVarint(out, to - from);
+    out.append(target.data() + from, to - from);
+}
+
+string createDelta(string_view base, string_view target) {
+    string out;
+    putVarint(out, base.length());
+    putVarint(out, target.length());
+
+    size_t blocks = base.length() / DELTA_BLOCK;
+    if (blocks == 0) {
+        emitInsert(out, target, 0, target.length());
+        return out;
+    }
+
+    size_t tableSize = 16;
+    while (tableSize < blocks * 2) tableSize *= 2;
+    size_t mask = tableSize - 1;
+    u64* hashes = new u64[tableSize];
+    size_t* offsets = new size_t[tableSize];
+    for (size_t i = 0; i < tableSize; i++) offsets[i] = (size_t)-1;
+    for (size_t b = 0; b < blocks; b++) {
+        u64 h = blockHash(base.data() + b * DELTA_BLOCK);
+        size_t slot = h & mask;
+        while (offsets[slot] != (size_t)-1) slot = (slot + 1) & mask;
+        hashes[slot] = h;
+        offsets[slot] = b * DELTA_BLOCK;
+    }
+
+    size_t pendingStart = 0;
+    size_t i = 0;
+    while (i + DELTA_BLOCK <= target.length()) {
+        u64 h = blockHash(target.data() + i);
+        size_t match = (size_t)-1;
+        for (size_t slot = h & mask; offsets[slot] != (size_t)-1; slot = (slot + 1) & mask) {
+            if (hashes[slot] == h && memcmp(base.data() + offsets[slot], target.data() + i, DELTA_BLOCK) == 0) {
+                match = offsets[slot];
+                break;
+            }
+        }
+        if (match == (size_t)-1) {
+            i++;
+            continue;
+        }
+
+        size_t len = DELTA_BLOCK;
+        while (match + len < base.length() && i + len < target.length() && base[match + len] == target[i + len])
+            len++;
+        while (i > pendingStart && match > 0 && base[match - 1] == target[i - 1]) {
+            i--;
+            match--;
+            len++;
+        }
+        emitInsert(out, target, pendingStart, i);
+        out += (char)DELTA_OP_COPY;
+        putVarint(out, match);
+        putVarint(out, len);
+        i += len;
+        pendingStart = i;
+    }
+    emitInsert(out, target, pendingStart, target.length());
+
+    delete[] hashes;
+    delete[] offsets;
+    return out;
+}
+
+bool deltaTargetSize(string_view delta, u64& size) {
+    const unsigned char* p = (const unsigned char*)delta.data();
+    const unsigned char* end = p + delta.length();
+    u64 baseSize;
+    return getVarint(p, end, baseSize) && getVarint(p, end, size);
+}
+
+bool applyDelta(string_view base, string_view delta, string& out) {
+    const unsigned char* p = (const unsigned char*)delta.data();
+    const unsigned char* end = p + delta.length();
+    u64 baseSize, targetSize;
+    if (!getVarint(p, end, baseSize) || !getVarint(p, end, targetSize)) return false;
+    if (baseSize != base.length()) return false;
+
+    out.clear();
+    out.reserve(targetSize);
+    while (p < end) {
+        int op = *p++;
+        if (op == DELTA_OP_INSERT) {
+            u64 len;
+            if (!getVarint(p, end, len) || len > (u64)(end - p)) return false;
+            out.append((const char*)p, len);
+            p += len;
+        } else if (op == DELTA_OP_COPY) {
+            u64 offset, len;
+            if (!getVarint(p, end, offset) || !getVarint(p, end, len)) return false;
+            if (offset > base.length() || len > base.length() - offset) return false;
+            out.append(base.data() + offset, len);
+        } else {
+            return false;
+        }
+        if (out.length() > targetSize) return false;
+    }
+    return out.length() == targetSize;
+}
+
+#endif
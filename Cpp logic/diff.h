@@ -0,0 +1,412 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include "digest.h"
+using namespace std;
+
+const int DIFF_EQUAL = 0;
+const int DIFF_DELETE = 1;
+const int DIFF_INSERT = 2;
+
+const int MYERS_MAX_EDITS = 1000;
+
+class DiffOp {
+public:
+    int kind;
+    int oldLine;
+    int newLine;
+};
+
+class EditScript {
+public:
+    DiffOp* ops;
+    int count;
+    int capacity;
+
+    EditScript() : ops(new DiffOp[64]), count(0), capacity(64) {}
+
+    ~EditScript() { delete[] ops; }
+
+    void push(int kind, int oldLine, int newLine) {
+        if (count == capacity) {
+            capacity *= 2;
+            DiffOp* grown = new DiffOp[capacity];
+            for (int i = 0; i < count; i++) grown[i] = ops[i];
+            delete[] ops;
+            ops = grown;
+        }
+        ops[count].kind = kind;
+        ops[count].oldLine = oldLine;
+        ops[count].newLine = newLine;
+        count++;
+    }
+
+private:
+    EditScript(const EditScript&);
+    EditScript& operator=(const EditScript&);
+};
+
+class LineTokens {
+public:
+    string_view* lines;
+    int* tokens;
+    int count;
+
+    LineTokens() : lines(NULL), tokens(NULL), count(0) {}
+
+    ~LineTokens() {
+        delete[] lines;
+        delete[] tokens;
+    }
+
+    void split(string_view text) {
+        count = 0;
+        if (!text.empty()) {
+            count = 1;
+            for (size_t i = 0; i + 1 < text.length(); i++) {
+                if (text[i] == '\n') count++;
+            }
+        }
+        lines = new string_view[count > 0 ? count : 1];
+        tokens = new int[count > 0 ? count : 1];
+        size_t start = 0;
+        for (int i = 0; i < count; i++) {
+            size_t end = text.find('\n', start);
+            if (end == string_view::npos) end = text.length();
+            lines[i] = text.substr(start, end - start);
+            start = end + 1;
+        }
+    }
+
+private:
+    LineTokens(const LineTokens&);
+    LineTokens& operator=(const LineTokens&);
+};
+
+class TokenTable {
+private:
+    string_view* keys;
+    u64* hashes;
+    int* ids;
+    int size;
+
+    void grow() {
+        string_view* oldKeys = keys;
+        u64* oldHashes = hashes;
+        int* oldIds = ids;
+        int oldSize = size;
+        size *= 2;
+        keys = new string_view[size];
+        hashes = new u64[size];
+        ids = new int[size];
+        for (int i = 0; i < size; i++) ids[i] = -1;
+        for (int i = 0; i < oldSize; i++) {
+            if (oldIds[i] < 0) continue;
+            int slot = (int)(oldHashes[i] & (size - 1));
+            while (ids[slot] >= 0) slot = (slot + 1) & (size - 1);
+            keys[slot] = oldKeys[i];
+            hashes[slot] = oldHashes[i];
+            ids[slot] = oldIds[i];
+        }
+        delete[] oldKeys;
+        delete[] oldHashes;
+        delete[] oldIds;
+    }
+
+    TokenTable(const TokenTable&);
+    TokenTable& operator=(const TokenTable&);
+
+public:
+    int count;
+
+    TokenTable() : size(256), count(0) {
+        keys = new string_view[size];
+        hashes = new u64[size];
+        ids = new int[size];
+        for (int i = 0; i < size; i++) ids[i] = -1;
+    }
+
+    ~TokenTable() {
+        delete[] keys;
+        delete[] hashes;
+        delete[] ids;
+    }
+
+    int intern(string_view line) {
+        if ((count + 1) * 2 > size) grow();
+        FastHasher hasher;
+        hasher.update(line.data(), line.length());
+        u64 h = hasher.digest();
+        int slot = (int)(h & (size - 1));
+        while (ids[slot] >= 0) {
+            if (hashes[slot] == h && keys[slot] == line) return ids[slot];
+            slot = (slot + 1) & (size - 1);
+        }
+        keys[slot] = line;
+        hashes[slot] = h;
+        ids[slot] = count;
+        return count++;
+    }
+
+    void tokenize(LineTokens& t) {
+        for (int i = 0; i < t.count; i++) t.tokens[i] = intern(t.lines[i]);
+    }
+};
+
+bool myersDiff(const int* a, int aStart, int n, const int* b, int bStart, int m, EditScript& out) {
+    int maxD = n + m;
+    if (maxD > MYERS_MAX_EDITS) maxD = MYERS_MAX_EDITS;
+    int offset = maxD + 1;
+    int* v = new int[2 * maxD + 3];
+    for (int i = 0; i < 2 * maxD + 3; i++) v[i] = 0;
+    int* trace = new int[(size_t)(maxD + 1) * (maxD + 1)];
+    int* traceStart = new int[maxD + 1];
+    int traceUsed = 0;
+    int found = -1;
+
+    for (int d = 0; d <= maxD && found < 0; d++) {
+        traceStart[d] = traceUsed;
+        for (int k = -d; k <= d; k++) trace[traceUsed++] = v[offset + k];
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) x = v[offset + k + 1];
+            else x = v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && a[aStart + x] == b[bStart + y]) {
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) {
+                found = d;
+                break;
+            }
+        }
+    }
+
+    if (found >= 0) {
+        int first = out.count;
+        int x = n, y = m;
+        for (int d = found; d >= 0; d--) {
+            int* prev = trace + traceStart[d] + d;
+            int k = x - y;
+            int prevK;
+            if (k == -d || (k != d && prev[k - 1] < prev[k + 1])) prevK = k + 1;
+            else prevK = k - 1;
+            int prevX = (d == 0) ? 0 : prev[prevK];
+            int prevY = prevX - prevK;
+            if (d == 0) prevY = 0;
+            while (x > prevX && y > prevY) {
+                x--;
+                y--;
+                out.push(DIFF_EQUAL, aStart + x, bStart + y);
+            }
+            if (d > 0) {
+                if (x == prevX) out.push(DIFF_INSERT, aStart + x, bStart + prevY);
+                else out.push(DIFF_DELETE, aStart + prevX, bStart + y);
+            }
+            x = prevX;
+            y = prevY;
+        }
+        for (int i = first, j = out.count - 1; i < j; i++, j--) {
+            DiffOp temp = out.ops[i];
+            out.ops[i] = out.ops[j];
+            out.ops[j] = temp;
+        }
+    }
+
+    delete[] v;
+    delete[] trace;
+    delete[] traceStart;
+    return found >= 0;
+}
+
+void diffRange(const int* a, int aStart, int aEnd, const int* b, int bStart, int bEnd,
+               int tokenCount, int depth, EditScript& out);
+
+void replaceRange(int aStart, int aEnd, int bStart, int bEnd, EditScript& out) {
+    for (int i = aStart; i < aEnd; i++) out.push(DIFF_DELETE, i, bStart);
+    for (int j = bStart; j < bEnd; j++) out.push(DIFF_INSERT, aEnd, j);
+}
+
+void patienceDiff(const int* a, int aStart, int aEnd, const int* b, int bStart, int bEnd,
+                  int tokenCount, int depth, EditScript& out) {
+    int* countA = new int[tokenCount]();
+    int* countB = new int[tokenCount]();
+    int* posB = new int[tokenCount];
+    for (int i = aStart; i < aEnd; i++) countA[a[i]]++;
+    for (int j = bStart; j < bEnd; j++) {
+        countB[b[j]]++;
+        posB[b[j]] = j;
+    }
+
+    int n = aEnd - aStart;
+    int* pairA = new int[n + 1];
+    int* pairB = new int[n + 1];
+    int pairs = 0;
+    for (int i = aStart; i < aEnd; i++) {
+        if (countA[a[i]] == 1 && countB[a[i]] == 1) {
+            pairA[pairs] = i;
+            pairB[pairs] = posB[a[i]];
+            pairs++;
+        }
+    }
+    delete[] countA;
+    delete[] countB;
+    delete[] posB;
+
+    int* tails = new int[pairs + 1];
+    int* prevPair = new int[pairs + 1];
+    int length = 0;
+    for (int p = 0; p < pairs; p++) {
+        int lo = 0, hi = length;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (pairB[tails[mid]] < pairB[p]) lo = mid + 1;
+            else hi = mid;
+        }
+        prevPair[p] = (lo > 0) ? tails[lo - 1] : -1;
+        tails[lo] = p;
+        if (lo == length) length++;
+    }
+
+    int* anchorA = new int[length + 1];
+    int* anchorB = new int[length + 1];
+    for (int i = length - 1, p = (length > 0) ? tails[length - 1] : -1; i >= 0; i--, p = prevPair[p]) {
+        anchorA[i] = pairA[p];
+        anchorB[i] = pairB[p];
+    }
+    delete[] pairA;
+    delete[] pairB;
+    delete[] tails;
+    delete[] prevPair;
+
+    if (length == 0) {
+        replaceRange(aStart, aEnd, bStart, bEnd, out);
+    } else {
+        int ai = aStart, bi = bStart;
+        for (int i = 0; i < length; i++) {
+            diffRange(a, ai, anchorA[i], b, bi, anchorB[i], tokenCount, depth + 1, out);
+            out.push(DIFF_EQUAL, anchorA[i], anchorB[i]);
+            ai = anchorA[i] + 1;
+            bi = anchorB[i] + 1;
+        }
+        diffRange(a, ai, aEnd, b, bi, bEnd, tokenCount, depth + 1, out);
+    }
+    delete[] anchorA;
+    delete[] anchorB;
+}
+
+void diffRange(const int* a, int aStart, int aEnd, const int* b, int bStart, int bEnd,
+               int tokenCount, int depth, EditScript& out) {
+    while (aStart < aEnd && bStart < bEnd && a[aStart] == b[bStart]) {
+        out.push(DIFF_EQUAL, aStart++, bStart++);
+    }
+    int suffix = 0;
+    while (aEnd - suffix > aStart && bEnd - suffix > bStart && a[aEnd - suffix - 1] == b[bEnd - suffix - 1]) {
+        suffix++;
+    }
+    aEnd -= suffix;
+    bEnd -= suffix;
+
+    int n = aEnd - aStart, m = bEnd - bStart;
+    if (n == 0 || m == 0) {
+        replaceRange(aStart, aEnd, bStart, bEnd, out);
+    } else {
+        bool tryMyers = (depth == 0 || n + m <= 64);
+        if (!tryMyers || !myersDiff(a, aStart, n, b, bStart, m, out)) {
+            if (depth < 64) patienceDiff(a, aStart, aEnd, b, bStart, bEnd, tokenCount, depth, out);
+            else replaceRange(aStart, aEnd, bStart, bEnd, out);
+        }
+    }
+
+    for (int s = 0; s < suffix; s++) out.push(DIFF_EQUAL, aEnd + s, bEnd + s);
+}
+
+class DiffHunk {
+public:
+    int start;
+    int end;
+    int oldStart;
+    int oldCount;
+    int newStart;
+    int newCount;
+};
+
+class LineDiff {
+public:
+    LineTokens oldLines;
+    LineTokens newLines;
+    EditScript script;
+    int added;
+    int removed;
+
+    LineDiff() : added(0), removed(0) {}
+
+    void compute(string_view oldText, string_view newText) {
+        oldLines.split(oldText);
+        newLines.split(newText);
+        TokenTable table;
+        table.tokenize(oldLines);
+        table.tokenize(newLines);
+        diffRange(oldLines.tokens, 0, oldLines.count, newLines.tokens, 0, newLines.count, table.count, 0, script);
+        for (int i = 0; i < script.count; i++) {
+            if (script.ops[i].kind == DIFF_INSERT) added++;
+            else if (script.ops[i].kind == DIFF_DELETE) removed++;
+        }
+    }
+
+    bool nextHunk(int& i, DiffHunk& hunk, int context = 3) const {
+        DiffOp* ops = script.ops;
+        while (i < script.count && ops[i].kind == DIFF_EQUAL) i++;
+        if (i >= script.count) return false;
+
+        int start = (i - context > 0) ? i - context : 0;
+        int end = i;
+        int lastChange = i;
+        while (end < script.count) {
+            if (ops[end].kind != DIFF_EQUAL) lastChange = end;
+            else if (end - lastChange > 2 * context) break;
+            end++;
+        }
+        end = (lastChange + context + 1 < script.count) ? lastChange + context + 1 : script.count;
+
+        hunk.start = start;
+        hunk.end = end;
+        hunk.oldCount = hunk.newCount = 0;
+        for (int j = start; j < end; j++) {
+            if (ops[j].kind != DIFF_INSERT) hunk.oldCount++;
+            if (ops[j].kind != DIFF_DELETE) hunk.newCount++;
+        }
+        hunk.oldStart = (hunk.oldCount > 0) ? ops[start].oldLine + 1 : ops[start].oldLine;
+        hunk.newStart = (hunk.newCount > 0) ? ops[start].newLine + 1 : ops[start].newLine;
+        i = end;
+        return true;
+    }
+
+    char marker(int j) const {
+        if (script.ops[j].kind == DIFF_EQUAL) return ' ';
+        return script.ops[j].kind == DIFF_DELETE ? '-' : '+';
+    }
+
+    string_view line(int j) const {
+        const DiffOp& op = script.ops[j];
+        return op.kind == DIFF_INSERT ? newLines.lines[op.newLine] : oldLines.lines[op.oldLine];
+    }
+
+    void writeUnified(ostream& out, const string& oldName, const string& newName, int context = 3) {
+        if (added == 0 && removed == 0) return;
+        out << "  --- " << oldName << '\n' << "  +++ " << newName << '\n';
+        DiffHunk hunk;
+        for (int i = 0; nextHunk(i, hunk, context); ) {
+            out << "  @@ -" << hunk.oldStart << "," << hunk.oldCount
+                << " +" << hunk.newStart << "," << hunk.newCount << " @@\n";
+            for (int j = hunk.start; j < hunk.end; j++) out << "  " << marker(j) << line(j) << '\n';
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,454 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <ostream>
+#include "stats.h"
+using namespace std;
+
+typedef unsigned long long u64;
+typedef unsigned int u32;
+
+const int ID_BYTES = 20;
+const int ID_HEX_LENGTH = 40;
+
+class HexTables {
+public:
+    char pairs[512];
+    signed char values[256];
+
+    constexpr HexTables() : pairs(), values() {
+        const char digits[] = "0123456789abcdef";
+        for (int i = 0; i < 256; i++) {
+            pairs[i * 2] = digits[i >> 4];
+            pairs[i * 2 + 1] = digits[i & 15];
+            values[i] = -1;
+        }
+        for (int i = 0; i < 10; i++) values['0' + i] = (signed char)i;
+        for (int i = 0; i < 6; i++) {
+            values['a' + i] = (signed char)(10 + i);
+            values['A' + i] = (signed char)(10 + i);
+        }
+    }
+};
+
+constexpr HexTables HEX_TABLES;
+
+constexpr bool isHexDigit(char c) { return HEX_TABLES.values[(unsigned char)c] >= 0; }
+
+constexpr int hexValue(char c) { return isHexDigit(c) ? HEX_TABLES.values[(unsigned char)c] : 0; }
+
+constexpr void writeHex(const unsigned char* bytes, int len, char* out) {
+    for (int i = 0; i < len; i++) {
+        out[i * 2] = HEX_TABLES.pairs[bytes[i] * 2];
+        out[i * 2 + 1] = HEX_TABLES.pairs[bytes[i] * 2 + 1];
+    }
+}
+
+string toHex(const unsigned char* bytes, int len) {
+    string result(len * 2, '0');
+    writeHex(bytes, len, &result[0]);
+    return result;
+}
+
+constexpr void fromHex(string_view hex, unsigned char* bytes, int len) {
+    for (int i = 0; i < len; i++) {
+        int hi = (i * 2 < (int)hex.length()) ? hexValue(hex[i * 2]) : 0;
+        int lo = (i * 2 + 1 < (int)hex.length()) ? hexValue(hex[i * 2 + 1]) : 0;
+        bytes[i] = (unsigned char)((hi << 4) | lo);
+    }
+}
+
+enum ObjectKind { KIND_ANY = 0, KIND_BLOB = 1, KIND_COMMIT = 2, KIND_DELTA = 3, KIND_TREE = 4, KIND_CHUNKS = 5 };
+
+class ObjectId {
+public:
+    unsigned char bytes[ID_BYTES];
+
+    constexpr ObjectId() : bytes() {}
+
+    static constexpr ObjectId fromRaw(const unsigned char* raw) {
+        ObjectId id;
+        for (int i = 0; i < ID_BYTES; i++) id.bytes[i] = raw[i];
+        return id;
+    }
+
+    static constexpr bool parse(string_view hex, ObjectId& out) {
+        if (hex.length() != (size_t)ID_HEX_LENGTH) return false;
+        for (int i = 0; i < ID_HEX_LENGTH; i++) {
+            if (!isHexDigit(hex[i])) return false;
+        }
+        fromHex(hex, out.bytes, ID_BYTES);
+        return true;
+    }
+
+    constexpr bool isNull() const {
+        for (int i = 0; i < ID_BYTES; i++) {
+            if (bytes[i] != 0) return false;
+        }
+        return true;
+    }
+
+    constexpr u64 prefix() const {
+        u64 v = 0;
+        for (int i = 0; i < 8; i++) v = (v << 8) | bytes[i];
+        return v;
+    }
+
+    constexpr int nibble(int i) const { return (i & 1) ? (bytes[i >> 1] & 15) : (bytes[i >> 1] >> 4); }
+
+    constexpr int compareHex(string_view hexPrefix) const {
+        for (int i = 0; i < (int)hexPrefix.length() && i < ID_HEX_LENGTH; i++) {
+            int d = nibble(i) - hexValue(hexPrefix[i]);
+            if (d != 0) return d;
+        }
+        return 0;
+    }
+
+    constexpr int commonNibbles(const ObjectId& other) const {
+        int n = 0;
+        while (n < ID_HEX_LENGTH && nibble(n) == other.nibble(n)) n++;
+        return n;
+    }
+
+    constexpr int compare(const ObjectId& other) const {
+        for (int i = 0; i < ID_BYTES; i++) {
+            if (bytes[i] != other.bytes[i]) return bytes[i] < other.bytes[i] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    void appendHex(string& out) const {
+        size_t at = out.length();
+        out.resize(at + ID_HEX_LENGTH);
+        writeHex(bytes, ID_BYTES, &out[at]);
+    }
+
+    string hex() const { return toHex(bytes, ID_BYTES); }
+
+    string abbrev(int len) const {
+        char text[ID_HEX_LENGTH];
+        writeHex(bytes, ID_BYTES, text);
+        return string(text, len < ID_HEX_LENGTH ? len : ID_HEX_LENGTH);
+    }
+};
+
+constexpr bool operator==(const ObjectId& a, const ObjectId& b) { return a.compare(b) == 0; }
+constexpr bool operator!=(const ObjectId& a, const ObjectId& b) { return a.compare(b) != 0; }
+constexpr bool operator<(const ObjectId& a, const ObjectId& b) { return a.compare(b) < 0; }
+
+ostream& operator<<(ostream& out, const ObjectId& id) {
+    char text[ID_HEX_LENGTH];
+    writeHex(id.bytes, ID_BYTES, text);
+    return out.write(text, ID_HEX_LENGTH);
+}
+
+template <ObjectKind K>
+class TypedId : public ObjectId {
+public:
+    static constexpr ObjectKind kind = K;
+
+    constexpr TypedId() {}
+    constexpr explicit TypedId(const ObjectId& id) : ObjectId(id) {}
+};
+
+template <ObjectKind A, ObjectKind B>
+bool operator==(const TypedId<A>& a, const TypedId<B>& b) = delete;
+template <ObjectKind A, ObjectKind B>
+bool operator!=(const TypedId<A>& a, const TypedId<B>& b) = delete;
+
+template <ObjectKind K>
+constexpr bool operator==(const TypedId<K>& a, const TypedId<K>& b) { return a.compare(b) == 0; }
+template <ObjectKind K>
+constexpr bool operator!=(const TypedId<K>& a, const TypedId<K>& b) { return a.compare(b) != 0; }
+
+typedef TypedId<KIND_BLOB> BlobId;
+typedef TypedId<KIND_TREE> TreeId;
+typedef TypedId<KIND_COMMIT> CommitId;
+
+template <class Impl>
+class Hasher {
+public:
+    void update(string_view data) { static_cast<Impl*>(this)->update(data.data(), data.length()); }
+
+    void updateHex(const ObjectId& id) {
+        char text[ID_HEX_LENGTH];
+        writeHex(id.bytes, ID_BYTES, text);
+        static_cast<Impl*>(this)->update(text, ID_HEX_LENGTH);
+    }
+};
+
+class FastHasher : public Hasher<FastHasher> {
+private:
+    static const u64 P1 = 11400714785074694791ULL;
+    static const u64 P2 = 14029467366897019727ULL;
+    static const u64 P3 = 1609587929392839161ULL;
+    static const u64 P4 = 9650029242287828579ULL;
+    static const u64 P5 = 2870177450012600261ULL;
+
+    u64 lanes[4];
+    unsigned char buffer[32];
+    int buffered;
+    u64 totalLen;
+    u64 seed;
+
+    static u64 rotl(u64 x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static u64 read64(const unsigned char* p) {
+        u64 v = 0;
+        for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+        return v;
+    }
+
+    static u64 read32(const unsigned char* p) {
+        u64 v = 0;
+        for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+        return v;
+    }
+
+    static u64 round(u64 acc, u64 input) {
+        acc += input * P2;
+        acc = rotl(acc, 31);
+        return acc * P1;
+    }
+
+    static u64 mergeRound(u64 acc, u64 val) {
+        acc ^= round(0, val);
+        return acc * P1 + P4;
+    }
+
+    void stripe(const unsigned char* p) {
+        lanes[0] = round(lanes[0], read64(p));
+        lanes[1] = round(lanes[1], read64(p + 8));
+        lanes[2] = round(lanes[2], read64(p + 16));
+        lanes[3] = round(lanes[3], read64(p + 24));
+    }
+
+public:
+    FastHasher(u64 s = 0) { reset(s); }
+
+    void reset(u64 s = 0) {
+        seed = s;
+        lanes[0] = seed + P1 + P2;
+        lanes[1] = seed + P2;
+        lanes[2] = seed;
+        lanes[3] = seed - P1;
+        buffered = 0;
+        totalLen = 0;
+    }
+
+    using Hasher::update;
+
+    void update(const char* data, size_t len) {
+        const unsigned char* p = (const unsigned char*)data;
+        totalLen += len;
+        if (buffered + len < 32) {
+            memcpy(buffer + buffered, p, len);
+            buffered += (int)len;
+            return;
+        }
+        if (buffered > 0) {
+            int fill = 32 - buffered;
+            memcpy(buffer + buffered, p, fill);
+            stripe(buffer);
+            p += fill;
+            len -= fill;
+            buffered = 0;
+        }
+        while (len >= 32) {
+            stripe(p);
+            p += 32;
+            len -= 32;
+        }
+        memcpy(buffer, p, len);
+        buffered = (int)len;
+    }
+
+    u64 digest() {
+        TRACE_COUNT(CTR_FAST_HASH_BYTES, totalLen);
+        TRACE_COUNT(CTR_FAST_HASH_CALLS, 1);
+        u64 h;
+        if (totalLen >= 32) {
+            h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+            for (int i = 0; i < 4; i++) h = mergeRound(h, lanes[i]);
+        } else {
+            h = seed + P5;
+        }
+        h += totalLen;
+
+        const unsigned char* p = buffer;
+        int len = buffered;
+        while (len >= 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * P1 + P4;
+            p += 8;
+            len -= 8;
+        }
+        if (len >= 4) {
+            h ^= read32(p) * P1;
+            h = rotl(h, 23) * P2 + P3;
+            p += 4;
+            len -= 4;
+        }
+        while (len > 0) {
+            h ^= (*p) * P5;
+            h = rotl(h, 11) * P1;
+            p++;
+            len--;
+        }
+
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    string hexDigest() {
+        u64 h = digest();
+        unsigned char bytes[8];
+        for (int i = 7; i >= 0; i--) {
+            bytes[i] = (unsigned char)(h & 0xff);
+            h >>= 8;
+        }
+        return toHex(bytes, 8);
+    }
+};
+
+class Sha1Hasher : public Hasher<Sha1Hasher> {
+private:
+    u32 state[5];
+    unsigned char buffer[64];
+    int buffered;
+    u64 totalLen;
+
+    static u32 rotl(u32 x, int r) { return (x << r) | (x >> (32 - r)); }
+
+    void block(const unsigned char* p) {
+        u32 w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = ((u32)p[i * 4] << 24) | ((u32)p[i * 4 + 1] << 16) |
+                   ((u32)p[i * 4 + 2] << 8) | (u32)p[i * 4 + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        u32 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int i = 0; i < 80; i++) {
+            u32 f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5a827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ed9eba1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }
+            else             { f = b ^ c ^ d;                   k = 0xca62c1d6; }
+            u32 temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+
+public:
+    Sha1Hasher() { reset(); }
+
+    void reset() {
+        state[0] = 0x67452301;
+        state[1] = 0xefcdab89;
+        state[2] = 0x98badcfe;
+        state[3] = 0x10325476;
+        state[4] = 0xc3d2e1f0;
+        buffered = 0;
+        totalLen = 0;
+    }
+
+    using Hasher::update;
+
+    void update(const char* data, size_t len) {
+        const unsigned char* p = (const unsigned char*)data;
+        totalLen += len;
+        if (buffered > 0) {
+            size_t fill = 64 - buffered;
+            if (len < fill) {
+                memcpy(buffer + buffered, p, len);
+                buffered += (int)len;
+                return;
+            }
+            memcpy(buffer + buffered, p, fill);
+            block(buffer);
+            p += fill;
+            len -= fill;
+            buffered = 0;
+        }
+        while (len >= 64) {
+            block(p);
+            p += 64;
+            len -= 64;
+        }
+        memcpy(buffer, p, len);
+        buffered = (int)len;
+    }
+
+    void digest(unsigned char out[20]) {
+        TRACE_COUNT(CTR_SHA1_BYTES, totalLen);
+        TRACE_COUNT(CTR_SHA1_CALLS, 1);
+        u64 bitLen = totalLen * 8;
+        unsigned char pad = 0x80;
+        update((const char*)&pad, 1);
+        unsigned char zero = 0;
+        while (buffered != 56) update((const char*)&zero, 1);
+        unsigned char lenBytes[8];
+        for (int i = 7; i >= 0; i--) {
+            lenBytes[i] = (unsigned char)(bitLen & 0xff);
+            bitLen >>= 8;
+        }
+        update((const char*)lenBytes, 8);
+        for (int i = 0; i < 5; i++) {
+            out[i * 4] = (unsigned char)(state[i] >> 24);
+            out[i * 4 + 1] = (unsigned char)(state[i] >> 16);
+            out[i * 4 + 2] = (unsigned char)(state[i] >> 8);
+            out[i * 4 + 3] = (unsigned char)state[i];
+        }
+    }
+
+    string hexDigest() {
+        unsigned char out[20];
+        digest(out);
+        return toHex(out, 20);
+    }
+
+    ObjectId id() {
+        ObjectId out;
+        digest(out.bytes);
+        return out;
+    }
+};
+
+typedef Sha1Hasher ObjectHasher;
+
+u64 fastHash(string_view data) {
+    FastHasher h;
+    h.update(data);
+    return h.digest();
+}
+
+template <class H = ObjectHasher>
+ObjectId digestOf(string_view data) {
+    TRACE_SPAN(SPAN_HASH);
+    H h;
+    h.update(data);
+    return h.id();
+}
+
+ObjectId generateHash(string_view data) { return digestOf(data); }
+
+#endif
@@ -0,0 +1,419 @@
+#ifndef GC_H
+#define GC_H
+
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#include "minigit.h"
+#include "tree.h"
+#include "objectstore.h"
+using namespace std;
+
+const long long GC_SLICE_MICROS = 2000;
+const int GC_CLOCK_INTERVAL = 64;
+
+enum GcPhase { GC_IDLE, GC_COMMITS, GC_TREES, GC_COPY, GC_SWEEP, GC_DONE };
+
+class IdSet {
+private:
+    unsigned char* keys;
+    bool* used;
+    int size;
+    int count;
+
+    IdSet(const IdSet&);
+    IdSet& operator=(const IdSet&);
+
+    bool place(const unsigned char* raw) {
+        int mask = size - 1;
+        int i = (int)(readU64(raw) & mask);
+        while (used[i]) {
+            if (memcmp(keys + i * 20, raw, 20) == 0) return false;
+            i = (i + 1) & mask;
+        }
+        memcpy(keys + i * 20, raw, 20);
+        used[i] = true;
+        count++;
+        return true;
+    }
+
+    void rehash(int newSize) {
+        unsigned char* oldKeys = keys;
+        bool* oldUsed = used;
+        int oldSize = size;
+        size = newSize;
+        count = 0;
+        keys = new unsigned char[size * 20];
+        used = new bool[size];
+        for (int i = 0; i < size; i++) used[i] = false;
+        for (int i = 0; i < oldSize; i++) {
+            if (oldUsed[i]) place(oldKeys + i * 20);
+        }
+        delete[] oldKeys;
+        delete[] oldUsed;
+    }
+
+public:
+    IdSet() : keys(NULL), used(NULL), size(0), count(0) {}
+
+    ~IdSet() {
+        delete[] keys;
+        delete[] used;
+    }
+
+    bool insert(const ObjectId& id) {
+        if ((count + 1) * 2 > size) rehash(size == 0 ? 256 : size * 2);
+        return place(id.bytes);
+    }
+
+    void clear() {
+        for (int i = 0; i < size; i++) used[i] = false;
+        count = 0;
+    }
+
+    bool contains(const ObjectId& id) const {
+        if (size == 0) return false;
+        int mask = size - 1;
+        for (int i = (int)(readU64(id.bytes) & mask); used[i]; i = (i + 1) & mask) {
+            if (memcmp(keys + i * 20, id.bytes, 20) == 0) return true;
+        }
+        return false;
+    }
+
+    int length() const { return count; }
+};
+
+class GarbageCollector {
+private:
+    ObjectStore& store;
+    BlobStore& blobs;
+    TreeStore& trees;
+    CommitIndex& index;
+    CommitGraph& graph;
+    CommitPool& pool;
+    ObjectStore fresh;
+    string freshDir;
+    IdSet marked;
+    FileState* files[3];
+    int fileCount;
+    Commit** commitStack;
+    int commitTop;
+    int commitCapacity;
+    unsigned char* existed;
+    int existedCount;
+    Tree** treeStack;
+    int treeTop;
+    int treeCapacity;
+    ObjectId* order[3];
+    int orderCount[3];
+    int orderCapacity[3];
+    int copyPos[3];
+    Tree** sweepTrees;
+    int treeTotal;
+    int treePos;
+    Blob** sweepBlobs;
+    int blobTotal;
+    int blobPos;
+    u64 startSize;
+    u64 tailOffset;
+    bool pruned;
+    chrono::steady_clock::time_point deadline;
+    int ticks;
+
+    GarbageCollector(const GarbageCollector&);
+    GarbageCollector& operator=(const GarbageCollector&);
+
+    void enqueue(int list, const ObjectId& id) {
+        if (orderCount[list] == orderCapacity[list])
+            order[list] = growArray(order[list], orderCount[list], orderCapacity[list]);
+        order[list][orderCount[list]++] = id;
+    }
+
+    void pushCommit(Commit* c) {
+        if (c == NULL) return;
+        if (commitTop == commitCapacity) commitStack = growArray(commitStack, commitTop, commitCapacity);
+        commitStack[commitTop++] = c;
+    }
+
+    void pushTree(Tree* t) {
+        if (t == NULL || !marked.insert(t->hash)) return;
+        enqueue(1, t->hash);
+        if (treeTop == treeCapacity) treeStack = growArray(treeStack, treeTop, treeCapacity);
+        treeStack[treeTop++] = t;
+    }
+
+    void markBlob(Blob* b) {
+        if (b == NULL || !marked.insert(b->hash)) return;
+        enqueue(2, b->hash);
+        if (b->isDelta()) markBlob(b->base);
+        for (int i = 0; i < b->chunkCount; i++) markBlob(b->chunks[i]);
+    }
+
+    void markFiles(FileState& state) {
+        for (File* file = state.first(); file != NULL; file = state.next(file)) markBlob(file->blob);
+    }
+
+    void markCommit(Commit* c) {
+        liveCommits++;
+        enqueue(0, c->commitId);
+        pushTree(c->tree);
+    }
+
+    void scanTree(Tree* t) {
+        for (int i = 0; i < t->count; i++) markBlob(t->entries[i].blob);
+        for (int i = t->count - 1; i >= 0; i--) pushTree(t->entries[i].tree);
+    }
+
+    void remark() {
+        for (int f = 0; f < fileCount; f++) markFiles(*files[f]);
+        while (treeTop > 0) scanTree(treeStack[--treeTop]);
+    }
+
+    bool outOfTime() {
+        if (++ticks % GC_CLOCK_INTERVAL != 0) return false;
+        return chrono::steady_clock::now() >= deadline;
+    }
+
+    void copyObject(const ObjectId& id) {
+        if (!fresh.isOpen() || fresh.has(id)) return;
+        int type;
+        u64 fast, size;
+        const char* data;
+        if (!store.read(id, type, fast, data, size)) return;
+        if (type == OBJ_DELTA && size >= 21) copyObject(ObjectId::fromRaw((const unsigned char*)data + 1));
+        fresh.write(type, id, fast, string_view(data, size));
+    }
+
+    bool copyQueued(bool bounded) {
+        for (int l = 0; l < 3; l++) {
+            while (copyPos[l] < orderCount[l]) {
+                copyObject(order[l][copyPos[l]++]);
+                if (bounded && outOfTime()) return false;
+            }
+        }
+        return true;
+    }
+
+    void prune() {
+        unsigned char* live = new unsigned char[graph.nodeCount > 0 ? graph.nodeCount : 1];
+        memset(live, 1, graph.nodeCount);
+        Commit** dead = new Commit*[index.count > 0 ? index.count : 1];
+        int deadCount = 0;
+        for (int i = 0; i < index.count; i++) {
+            Commit* c = index.at(i);
+            if (c->node < existedCount && existed[c->node] && !marked.contains(c->commitId)) {
+                live[c->node] = 0;
+                dead[deadCount++] = c;
+            }
+        }
+        prunedCommits = index.retain(live);
+        delete[] live;
+        for (int i = 0; i < deadCount; i++) pool.release(dead[i]);
+        if (deadCount > 0) graph.compact();
+        delete[] dead;
+        delete[] existed;
+        existed = NULL;
+        existedCount = 0;
+        pruned = true;
+    }
+
+    bool sweep() {
+        while (treePos < treeTotal) {
+            Tree* t = sweepTrees[treePos++];
+            if (!marked.contains(t->hash)) {
+                trees.release(t);
+                freedTrees++;
+            }
+            if (outOfTime()) return false;
+        }
+        while (blobPos < blobTotal) {
+            Blob* b = sweepBlobs[blobPos++];
+            if (!marked.contains(b->hash)) {
+                blobs.release(b);
+                freedBlobs++;
+            }
+            if (outOfTime()) return false;
+        }
+        return true;
+    }
+
+    void dropSweep() {
+        delete[] sweepTrees;
+        delete[] sweepBlobs;
+        sweepTrees = NULL;
+        sweepBlobs = NULL;
+        treeTotal = treePos = blobTotal = blobPos = 0;
+    }
+
+    void finish() {
+        dropSweep();
+        if (!fresh.isOpen()) {
+            phase = GC_DONE;
+            return;
+        }
+        Blob** all;
+        int n = blobs.collect(all);
+        bool* packed = new bool[n > 0 ? n : 1];
+        for (int i = 0; i < n; i++) {
+            packed[i] = store.maps(all[i]->mappedData());
+            if (packed[i] && !fresh.has(all[i]->hash)) all[i]->materialize();
+        }
+        fresh.close();
+        store.replacePack(freshDir);
+        for (int i = 0; i < n; i++) {
+            if (!packed[i] || !all[i]->isMapped()) continue;
+            int type;
+            u64 fast, size;
+            const char* data;
+            if (store.read(all[i]->hash, type, fast, data, size)) all[i]->remap(type == OBJ_DELTA ? data + 21 : data);
+        }
+        delete[] packed;
+        delete[] all;
+        objectsAfter = store.objectCount();
+        bytesAfter = store.packBytes();
+        phase = GC_DONE;
+    }
+
+public:
+    GcPhase phase;
+    int liveCommits;
+    int prunedCommits;
+    int freedBlobs;
+    int freedTrees;
+    int objectsBefore;
+    int objectsAfter;
+    u64 bytesBefore;
+    u64 bytesAfter;
+    int slices;
+
+    GarbageCollector(ObjectStore& s, BlobStore& b, TreeStore& t, CommitIndex& i, CommitGraph& g, CommitPool& p)
+        : store(s), blobs(b), trees(t), index(i), graph(g), pool(p), fileCount(0), commitStack(NULL), commitTop(0),
+          commitCapacity(0), existed(NULL), existedCount(0), treeStack(NULL), treeTop(0), treeCapacity(0),
+          sweepTrees(NULL), treeTotal(0), treePos(0), sweepBlobs(NULL), blobTotal(0), blobPos(0), startSize(0),
+          tailOffset(0), pruned(false), ticks(0), phase(GC_IDLE), liveCommits(0), prunedCommits(0), freedBlobs(0),
+          freedTrees(0), objectsBefore(0), objectsAfter(0), bytesBefore(0), bytesAfter(0), slices(0) {
+        for (int l = 0; l < 3; l++) {
+            order[l] = NULL;
+            orderCount[l] = orderCapacity[l] = copyPos[l] = 0;
+        }
+    }
+
+    ~GarbageCollector() {
+        abort();
+        delete[] commitStack;
+        delete[] treeStack;
+        for (int l = 0; l < 3; l++) delete[] order[l];
+    }
+
+    bool running() const { return phase != GC_IDLE && phase != GC_DONE; }
+
+    int pending() const {
+        if (!running()) return 0;
+        int left = commitTop + treeTop + (treeTotal - treePos) + (blobTotal - blobPos);
+        for (int l = 0; l < 3; l++) left += orderCount[l] - copyPos[l];
+        return left;
+    }
+
+    void start(Commit** roots, int rootCount, FileState** states, int stateCount) {
+        abort();
+        marked.clear();
+        commitTop = treeTop = 0;
+        for (int l = 0; l < 3; l++) orderCount[l] = copyPos[l] = 0;
+        slices = 0;
+        liveCommits = prunedCommits = freedBlobs = freedTrees = 0;
+        pruned = false;
+        fileCount = stateCount < 3 ? stateCount : 3;
+        for (int f = 0; f < fileCount; f++) files[f] = states[f];
+
+        existedCount = graph.nodeCount;
+        existed = new unsigned char[existedCount > 0 ? existedCount : 1];
+        memset(existed, 0, existedCount);
+        for (int i = 0; i < index.count; i++) existed[index.at(i)->node] = 1;
+        for (int i = 0; i < rootCount; i++) pushCommit(roots[i]);
+
+        objectsBefore = objectsAfter = store.objectCount();
+        bytesBefore = bytesAfter = store.packBytes();
+        phase = GC_COMMITS;
+        if (!store.isOpen()) return;
+        startSize = tailOffset = store.packBytes();
+        freshDir = store.directory() + "/gc.tmp";
+        if (fresh.open(freshDir)) fresh.destroy();
+        fresh.open(freshDir);
+    }
+
+    void addRoot(Commit* c) {
+        if (!running()) return;
+        int top = 0, capacity = 16;
+        Commit** stack = new Commit*[capacity];
+        stack[top++] = c;
+        while (top > 0) {
+            Commit* next = stack[--top];
+            if (next == NULL || !marked.insert(next->commitId)) continue;
+            markCommit(next);
+            for (int p = 0; p < next->parentCount(); p++) {
+                if (top == capacity) stack = growArray(stack, top, capacity);
+                stack[top++] = next->parent(p);
+            }
+        }
+        delete[] stack;
+    }
+
+    bool step(long long micros) {
+        if (!running()) return true;
+        slices++;
+        deadline = chrono::steady_clock::now() + chrono::microseconds(micros);
+        if (phase == GC_COMMITS) {
+            while (commitTop > 0) {
+                Commit* c = commitStack[--commitTop];
+                if (!marked.insert(c->commitId)) continue;
+                markCommit(c);
+                for (int p = 0; p < c->parentCount(); p++) pushCommit(c->parent(p));
+                if (outOfTime()) return false;
+            }
+            prune();
+            phase = GC_TREES;
+        }
+        if (phase == GC_TREES) {
+            while (treeTop > 0) {
+                scanTree(treeStack[--treeTop]);
+                if (outOfTime()) return false;
+            }
+            phase = GC_COPY;
+        }
+        if (phase == GC_COPY) {
+            if (!copyQueued(true)) return false;
+            treeTotal = trees.collect(sweepTrees);
+            blobTotal = blobs.collect(sweepBlobs);
+            treePos = blobPos = 0;
+            phase = GC_SWEEP;
+        }
+        remark();
+        if (!copyQueued(true) || !sweep()) return false;
+        ObjectId id;
+        while (fresh.isOpen() && store.nextRecord(tailOffset, id)) {
+            copyObject(id);
+            if (outOfTime()) return false;
+        }
+        finish();
+        return true;
+    }
+
+    bool takePruned() {
+        bool was = pruned;
+        pruned = false;
+        return was;
+    }
+
+    void abort() {
+        delete[] existed;
+        existed = NULL;
+        existedCount = 0;
+        dropSweep();
+        if (!running()) return;
+        fresh.destroy();
+        phase = GC_IDLE;
+    }
+};
+
+#endif
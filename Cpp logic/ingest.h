@@ -0,0 +1,124 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <string>
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "minigit.h"
+#include "pool.h"
+#include "chunker.h"
+using namespace std;
+
+class IngestItem {
+public:
+    string path;
+    string name;
+    string content;
+    BlobId hash;
+    u64 fast;
+    bool loaded;
+    bool large;
+
+    IngestItem() : fast(0), loaded(false), large(false) {}
+};
+
+bool itemBefore(const IngestItem& a, const IngestItem& b) { return a.name < b.name; }
+
+class IngestBatch : public ParallelTask {
+public:
+    IngestItem* items;
+    int count;
+    int capacity;
+    long long bytes;
+
+    IngestBatch() : items(NULL), count(0), capacity(0), bytes(0) {}
+
+    ~IngestBatch() { delete[] items; }
+
+    static string repoName(const string& path) {
+        size_t start = 0;
+        while (path.compare(start, 2, "./") == 0) start += 2;
+        size_t end = path.length();
+        while (end > start && path[end - 1] == '/') end--;
+        return path.substr(start, end - start);
+    }
+
+    void push(const string& path) {
+        if (count == capacity) items = growArray(items, count, capacity);
+        items[count].path = path;
+        items[count].name = repoName(path);
+        count++;
+    }
+
+    bool collect(const string& path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return false;
+        if (S_ISREG(st.st_mode)) {
+            push(path);
+            return true;
+        }
+        if (!S_ISDIR(st.st_mode)) return false;
+        DIR* dir = opendir(path.c_str());
+        if (dir == NULL) return false;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            string name = entry->d_name;
+            if (name == "." || name == ".." || name == ".minigit" || name == ".git") continue;
+            collect(path == "." ? name : (path.back() == '/' ? path + name : path + "/" + name));
+        }
+        closedir(dir);
+        return true;
+    }
+
+    int hashAll(WorkStealingPool& pool) {
+        sort(items, items + count, itemBefore);
+        int threads = pool.run(*this, count);
+        bytes = 0;
+        for (int i = 0; i < count; i++) {
+            if (items[i].loaded) bytes += (long long)items[i].content.length();
+        }
+        return threads;
+    }
+
+    void run(int i) {
+        IngestItem& item = items[i];
+        struct stat st;
+        if (stat(item.path.c_str(), &st) == 0 && (size_t)st.st_size >= CHUNK_THRESHOLD) {
+            item.large = item.loaded = true;
+            return;
+        }
+        item.loaded = readWhole(item.path, item.content);
+        if (!item.loaded) return;
+        item.fast = fastHash(item.content);
+        item.hash = BlobId(generateHash(item.content));
+    }
+
+    static bool readWhole(const string& path, string& out) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        out.resize((size_t)st.st_size);
+        size_t done = 0;
+        while (done < out.length()) {
+            ssize_t n = ::read(fd, &out[done], out.length() - done);
+            if (n <= 0) break;
+            done += (size_t)n;
+        }
+        ::close(fd);
+        out.resize(done);
+        return true;
+    }
+
+private:
+    IngestBatch(const IngestBatch&);
+    IngestBatch& operator=(const IngestBatch&);
+};
+
+#endif
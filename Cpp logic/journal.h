@@ -0,0 +1,285 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "minigit.h"
+using namespace std;
+
+enum JournalOp { OP_COMMIT, OP_MERGE, OP_REVERT, OP_CHECKOUT };
+
+const char* const JOURNAL_OP_NAMES[] = {"commit", "merge", "revert", "checkout"};
+const size_t JOURNAL_DEFAULT_BUDGET = 64 * 1024;
+const int JOURNAL_MIN_ENTRIES = 8;
+
+class JournalEntry {
+public:
+    JournalOp op;
+    Branch* from;
+    Branch* to;
+    Commit* before;
+    Commit* after;
+};
+
+class Journal {
+private:
+    JournalEntry* ring;
+    int capacity;
+    int head;
+    int length;
+    int undoable;
+    int spilledCount;
+    int restorableCount;
+    size_t budget;
+    FILE* spill;
+    BranchList* branches;
+    CommitIndex* commits;
+
+    Journal(const Journal&);
+    Journal& operator=(const Journal&);
+
+    JournalEntry& at(int i) { return ring[(head + i) & (capacity - 1)]; }
+
+    int limit() const {
+        int n = (int)(budget / sizeof(JournalEntry));
+        return n < JOURNAL_MIN_ENTRIES ? JOURNAL_MIN_ENTRIES : n;
+    }
+
+    void grow(int needed) {
+        int newCapacity = capacity;
+        while (newCapacity < needed) newCapacity *= 2;
+        if (newCapacity == capacity) return;
+        JournalEntry* bigger = new JournalEntry[newCapacity];
+        for (int i = 0; i < length; i++) bigger[i] = at(i);
+        delete[] ring;
+        ring = bigger;
+        capacity = newCapacity;
+        head = 0;
+    }
+
+    bool truncateTo(long size) {
+        fflush(spill);
+        return ftruncate(fileno(spill), size) == 0;
+    }
+
+    static void appendCommits(const JournalEntry& e, Commit**& out, int& n, int& outCapacity) {
+        Commit* refs[2] = {e.before, e.after};
+        for (int r = 0; r < 2; r++) {
+            if (refs[r] == NULL) continue;
+            if (n == outCapacity) out = growArray(out, n, outCapacity);
+            out[n++] = refs[r];
+        }
+    }
+
+    static void appendId(string& out, Commit* c) {
+        if (c != NULL) c->commitId.appendHex(out);
+        else out += "-";
+    }
+
+    bool spillOldest(int n) {
+        if (spill == NULL) spill = tmpfile();
+        if (spill == NULL) return false;
+        string block;
+        for (int i = 0; i < n; i++) {
+            JournalEntry& e = at(i);
+            block += JOURNAL_OP_NAMES[e.op];
+            block += ' ';
+            block += e.from->name;
+            block += ' ';
+            block += e.to->name;
+            block += ' ';
+            appendId(block, e.before);
+            block += ' ';
+            appendId(block, e.after);
+            block += '\n';
+        }
+        u32 trailer[2] = {(u32)block.length(), (u32)n};
+        if (fseek(spill, 0, SEEK_END) != 0) return false;
+        long start = ftell(spill);
+        if (fwrite(block.data(), 1, block.length(), spill) != block.length()
+            || fwrite(trailer, sizeof(trailer), 1, spill) != 1 || fflush(spill) != 0) {
+            truncateTo(start);
+            return false;
+        }
+        head = (head + n) & (capacity - 1);
+        length -= n;
+        undoable -= n;
+        spilledCount += n;
+        restorableCount += n;
+        return true;
+    }
+
+    Commit* resolveId(string_view id, bool& ok) {
+        if (id == "-") return NULL;
+        Commit* c = commits->find(id);
+        if (c == NULL) ok = false;
+        return c;
+    }
+
+    bool readBlock(long end, string& block, long& start, int& n) {
+        u32 trailer[2];
+        if (end < (long)sizeof(trailer) || fseek(spill, end - (long)sizeof(trailer), SEEK_SET) != 0) return false;
+        if (fread(trailer, sizeof(trailer), 1, spill) != 1 || (long)(trailer[0] + sizeof(trailer)) > end) return false;
+        start = end - (long)sizeof(trailer) - (long)trailer[0];
+        n = (int)trailer[1];
+        block.assign(trailer[0], '\0');
+        return fseek(spill, start, SEEK_SET) == 0 && fread(&block[0], 1, block.length(), spill) == block.length();
+    }
+
+    int decodeBlock(const string& block, int n, JournalEntry* loaded) {
+        int count = 0;
+        size_t pos = 0;
+        while (pos < block.length() && count < n) {
+            size_t eol = block.find('\n', pos);
+            if (eol == string::npos) eol = block.length();
+            string_view fields[5];
+            int f = 0;
+            size_t p = pos;
+            while (f < 5 && p <= eol) {
+                size_t sp = block.find(' ', p);
+                if (sp == string::npos || sp > eol) sp = eol;
+                fields[f++] = string_view(block).substr(p, sp - p);
+                p = sp + 1;
+            }
+            pos = eol + 1;
+            int op = 0;
+            while (op <= OP_CHECKOUT && fields[0] != JOURNAL_OP_NAMES[op]) op++;
+            bool ok = f == 5 && op <= OP_CHECKOUT;
+            JournalEntry& e = loaded[count];
+            e.op = (JournalOp)op;
+            e.from = branches->findBranch(fields[1]);
+            e.to = branches->findBranch(fields[2]);
+            e.before = resolveId(fields[3], ok);
+            e.after = resolveId(fields[4], ok);
+            if (ok && e.from != NULL && e.to != NULL) count++;
+        }
+        return count;
+    }
+
+    bool reload() {
+        int count = 0;
+        while (count == 0 && spilledCount > 0) {
+            if (spill == NULL || fseek(spill, 0, SEEK_END) != 0) return false;
+            string block;
+            long start;
+            int n;
+            if (!readBlock(ftell(spill), block, start, n)) return false;
+
+            grow(length + n);
+            JournalEntry* loaded = new JournalEntry[n];
+            count = decodeBlock(block, n, loaded);
+            for (int i = count - 1; i >= 0; i--) {
+                head = (head - 1) & (capacity - 1);
+                ring[head] = loaded[i];
+            }
+            delete[] loaded;
+            length += count;
+            undoable += count;
+            spilledCount -= n;
+            restorableCount = spilledCount > 0 ? restorableCount - count : 0;
+            if (!truncateTo(start)) return false;
+        }
+        return count > 0;
+    }
+
+public:
+    Journal(BranchList* b, CommitIndex* c, size_t bytes = defaultBudget())
+        : capacity(16), head(0), length(0), undoable(0), spilledCount(0), restorableCount(0), budget(bytes),
+          spill(NULL), branches(b), commits(c) {
+        ring = new JournalEntry[capacity];
+    }
+
+    ~Journal() {
+        delete[] ring;
+        if (spill != NULL) fclose(spill);
+    }
+
+    static size_t defaultBudget() {
+        const char* env = getenv("MINIGIT_JOURNAL_BUDGET");
+        if (env != NULL && atol(env) > 0) return (size_t)atol(env);
+        return JOURNAL_DEFAULT_BUDGET;
+    }
+
+    void setBudget(size_t bytes) { budget = bytes; }
+
+    void record(JournalOp op, Branch* from, Branch* to, Commit* before, Commit* after) {
+        length = undoable;
+        grow(length + 1);
+        JournalEntry& e = at(length);
+        e.op = op;
+        e.from = from;
+        e.to = to;
+        e.before = before;
+        e.after = after;
+        length++;
+        undoable++;
+        if (length > limit()) spillOldest(length - limit() / 2);
+    }
+
+    JournalEntry* undo() {
+        if (undoable == 0 && spilledCount > 0) reload();
+        if (undoable == 0) return NULL;
+        return &at(--undoable);
+    }
+
+    JournalEntry* redo() {
+        if (undoable == length) return NULL;
+        return &at(undoable++);
+    }
+
+    void clear() {
+        head = length = undoable = spilledCount = restorableCount = 0;
+        if (spill != NULL) {
+            fclose(spill);
+            spill = NULL;
+        }
+    }
+
+    void refresh() {
+        if (spilledCount == 0 || spill == NULL || fseek(spill, 0, SEEK_END) != 0) {
+            restorableCount = 0;
+            return;
+        }
+        long end = ftell(spill);
+        string block;
+        long start;
+        int n, total = 0;
+        while (end > 0 && readBlock(end, block, start, n)) {
+            JournalEntry* loaded = new JournalEntry[n];
+            total += decodeBlock(block, n, loaded);
+            delete[] loaded;
+            end = start;
+        }
+        restorableCount = total;
+    }
+
+    int collectCommits(Commit**& out) {
+        int n = 0, outCapacity = 0;
+        out = NULL;
+        for (int i = 0; i < length; i++) appendCommits(at(i), out, n, outCapacity);
+        if (spill == NULL || fseek(spill, 0, SEEK_END) != 0) return n;
+        long end = ftell(spill);
+        string block;
+        long start;
+        int count;
+        while (end > 0 && readBlock(end, block, start, count)) {
+            JournalEntry* loaded = new JournalEntry[count];
+            int decoded = decodeBlock(block, count, loaded);
+            for (int i = 0; i < decoded; i++) appendCommits(loaded[i], out, n, outCapacity);
+            delete[] loaded;
+            end = start;
+        }
+        return n;
+    }
+
+    int undoCount() const { return undoable + restorableCount; }
+    int redoCount() const { return length - undoable; }
+    int inMemory() const { return length; }
+    int spilled() const { return spilledCount; }
+    size_t memoryBytes() const { return (size_t)capacity * sizeof(JournalEntry); }
+};
+
+#endif
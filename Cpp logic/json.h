@@ -0,0 +1,119 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <string_view>
+#include <cstdio>
+using namespace std;
+
+const int JSON_MAX_DEPTH = 64;
+
+class JsonWriter {
+private:
+    bool needComma[JSON_MAX_DEPTH];
+    int depth;
+    bool afterKey;
+
+    void separate() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (needComma[depth]) out += ',';
+        needComma[depth] = true;
+    }
+
+    void open(char c) {
+        separate();
+        out += c;
+        if (depth + 1 < JSON_MAX_DEPTH) depth++;
+        needComma[depth] = false;
+    }
+
+    void close(char c) {
+        out += c;
+        if (depth > 0) depth--;
+    }
+
+    void writeString(string_view s) {
+        out += '"';
+        for (size_t i = 0; i < s.length(); i++) {
+            unsigned char c = (unsigned char)s[i];
+            if (c == '"') out += "\\\"";
+            else if (c == '\\') out += "\\\\";
+            else if (c == '\n') out += "\\n";
+            else if (c == '\r') out += "\\r";
+            else if (c == '\t') out += "\\t";
+            else if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += (char)c;
+            }
+        }
+        out += '"';
+    }
+
+public:
+    string out;
+
+    JsonWriter() : depth(0), afterKey(false) { needComma[0] = false; }
+
+    JsonWriter& beginObject() { open('{'); return *this; }
+    JsonWriter& endObject() { close('}'); return *this; }
+    JsonWriter& beginArray() { open('['); return *this; }
+    JsonWriter& endArray() { close(']'); return *this; }
+
+    JsonWriter& key(string_view k) {
+        separate();
+        writeString(k);
+        out += ':';
+        afterKey = true;
+        return *this;
+    }
+
+    JsonWriter& value(string_view v) {
+        separate();
+        writeString(v);
+        return *this;
+    }
+
+    JsonWriter& value(const char* v) { return v != NULL ? value(string_view(v)) : null(); }
+
+    JsonWriter& value(long long v) {
+        separate();
+        out += to_string(v);
+        return *this;
+    }
+
+    JsonWriter& value(int v) { return value((long long)v); }
+
+    JsonWriter& value(double v) {
+        separate();
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.6g", v);
+        out += buf;
+        return *this;
+    }
+
+    JsonWriter& value(bool v) {
+        separate();
+        out += v ? "true" : "false";
+        return *this;
+    }
+
+    JsonWriter& null() {
+        separate();
+        out += "null";
+        return *this;
+    }
+
+    template <typename T>
+    JsonWriter& field(string_view k, T v) {
+        key(k);
+        return value(v);
+    }
+};
+
+#endif
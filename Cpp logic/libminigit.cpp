@@ -0,0 +1,358 @@
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "libminigit.h"
+#include "repository.h"
+#include "json.h"
+#include "stats.h"
+using namespace std;
+
+struct mg_host {
+    RepoManager<MiniGit> repos;
+    string storageRoot;
+};
+
+string consoleMessage(const string& text) {
+    string out;
+    size_t pos = 0;
+    while (pos < text.length()) {
+        size_t end = text.find('\n', pos);
+        if (end == string::npos) end = text.length();
+        size_t start = pos;
+        while (start < end && start < pos + 2 && text[start] == ' ') start++;
+        if (end > start) {
+            if (!out.empty()) out += '\n';
+            out.append(text, start, end - start);
+        }
+        pos = end + 1;
+    }
+    return out;
+}
+
+void writeFiles(JsonWriter& json, const char* key, FileState& files) {
+    json.key(key).beginArray();
+    for (File* f = files.first(); f != NULL; f = files.next(f)) {
+        json.beginObject().field("name", f->name).field("hash", f->blob->hash.hex()).endObject();
+    }
+    json.endArray();
+}
+
+class JsonFileLister : public TreeVisitor {
+public:
+    JsonWriter& json;
+
+    JsonFileLister(JsonWriter& j) : json(j) {}
+
+    void changed(const string& path, Blob* before, Blob* after) {
+        (void)before;
+        json.beginObject().field("name", string_view(path)).field("hash", after->hash.hex()).endObject();
+    }
+};
+
+void writeTree(JsonWriter& json, const char* key, Tree* t) {
+    json.key(key).beginArray();
+    JsonFileLister lister(json);
+    diffTrees(NULL, t, lister);
+    json.endArray();
+}
+
+void writeCommit(JsonWriter& json, Commit* c) {
+    json.beginObject();
+    json.field("id", c->commitId.hex());
+    json.field("message", string_view(c->message));
+    json.field("timestamp", string_view(c->timestamp));
+    json.key("parent");
+    if (c->parent() != NULL) json.value(c->parent()->commitId.hex());
+    else json.null();
+    json.key("parents").beginArray();
+    for (int i = 0; i < c->parentCount(); i++) json.value(c->parent(i)->commitId.hex());
+    json.endArray();
+    json.field("generation", c->generation());
+    writeTree(json, "files", c->tree);
+    json.field("fileCount", c->tree->fileCount);
+    json.endObject();
+}
+
+void writeHunks(JsonWriter& json, const LineDiff& lines) {
+    json.field("added", lines.added).field("removed", lines.removed);
+    json.key("hunks").beginArray();
+    DiffHunk hunk;
+    string text;
+    for (int i = 0; lines.nextHunk(i, hunk); ) {
+        json.beginObject().field("oldStart", hunk.oldStart).field("oldCount", hunk.oldCount);
+        json.field("newStart", hunk.newStart).field("newCount", hunk.newCount).key("lines").beginArray();
+        for (int j = hunk.start; j < hunk.end; j++) {
+            text.assign(1, lines.marker(j));
+            text += lines.line(j);
+            json.value(string_view(text));
+        }
+        json.endArray().endObject();
+    }
+    json.endArray();
+}
+
+void writeHead(JsonWriter& json, const char* key, MiniGit& git) {
+    Commit* head = git.activeBranch() != NULL ? git.activeBranch()->head : NULL;
+    json.key(key);
+    if (head != NULL) json.value(head->commitId.hex());
+    else json.null();
+}
+
+bool isReadOp(const string& op) {
+    return op == "log" || op == "status" || op == "diff" || op == "branches";
+}
+
+bool runRepoOp(MiniGit& git, const string& name, const string& op, const string& arg1, const string& arg2,
+               JsonWriter& json) {
+    bool needsInit = op == "log" || op == "status" || op == "branches";
+    if (needsInit && !git.isInitialized()) {
+        console() << "  Error: repo not initialized." << endl;
+        return false;
+    }
+
+    if (op == "init") return git.init();
+    if (op == "add") {
+        bool ok = git.add(arg1, arg2);
+        File* f = git.working().getFile(arg1);
+        if (ok && f != NULL) json.field("hash", f->blob->hash.hex()).field("filename", string_view(arg1));
+        return ok;
+    }
+    if (op == "commit") {
+        bool ok = git.commit(arg1);
+        if (ok) {
+            writeHead(json, "commitId", git);
+            json.field("branch", string_view(git.activeBranch()->name));
+            json.field("fileCount", git.activeBranch()->head->tree->fileCount);
+        }
+        return ok;
+    }
+    if (op == "log") {
+        Branch* current = git.activeBranch();
+        json.field("branch", string_view(current->name));
+        int limit = arg1.empty() ? -1 : atoi(arg1.c_str());
+        int total = 0;
+        json.key("commits").beginArray();
+        HistoryIterator it(current->head);
+        u64 key = fastHash(arg2);
+        for (Commit* c = it.next(); c != NULL; c = it.next()) {
+            if (!arg2.empty() && !touchesPath(c, arg2, key)) continue;
+            if (limit < 0 || total < limit) writeCommit(json, c);
+            total++;
+        }
+        json.endArray();
+        json.field("total", total);
+        if (current->head == NULL) console() << "  No commits yet." << endl;
+        else console() << "  Commit History (" << current->name << ")" << endl;
+        return true;
+    }
+    if (op == "status") {
+        json.field("branch", string_view(git.activeBranch()->name));
+        json.field("repo", string_view(name));
+        writeFiles(json, "staged", git.staged());
+        writeFiles(json, "working", git.working());
+        json.field("undoCount", git.history().undoCount());
+        json.field("redoCount", git.history().redoCount());
+        return true;
+    }
+    if (op == "diff") {
+        LineDiff lines;
+        bool ok = git.diff(arg1, &lines);
+        File* work = git.working().getFile(arg1);
+        Commit* head = git.activeBranch() != NULL ? git.activeBranch()->head : NULL;
+        Blob* committed = (head != NULL) ? lookupPath(head->tree, arg1) : NULL;
+        if (ok && work != NULL) {
+            json.field("filename", string_view(arg1));
+            json.field("workingHash", work->blob->hash.hex());
+            json.field("size", (long long)work->blob->size);
+            if (committed == NULL) {
+                json.field("status", "new");
+                if (!work->blob->isChunked()) lines.compute(string_view(), work->content());
+            } else if (committed == work->blob) {
+                json.field("status", "unchanged");
+            } else {
+                json.field("status", "modified");
+                json.field("committedHash", committed->hash.hex());
+            }
+            json.field("chunked", work->blob->isChunked() || (committed != NULL && committed->isChunked()));
+            writeHunks(json, lines);
+        }
+        return ok;
+    }
+    if (op == "branch") {
+        bool ok = git.branch(arg1);
+        if (ok) json.field("branch", string_view(arg1));
+        return ok;
+    }
+    if (op == "checkout") {
+        bool ok = git.checkout(arg1);
+        if (ok) json.field("branch", string_view(arg1));
+        return ok;
+    }
+    if (op == "branches") {
+        Branch** list;
+        int n = git.branchList().sorted(list, arg1);
+        json.key("branches").beginArray();
+        for (int i = 0; i < n; i++) {
+            Branch* b = list[i];
+            json.beginObject().field("name", string_view(b->name)).field("active", b == git.activeBranch());
+            json.key("head");
+            if (b->head != NULL) json.value(b->head->commitId.hex());
+            else json.null();
+            json.endObject();
+        }
+        json.endArray();
+        delete[] list;
+        json.field("total", n);
+        return true;
+    }
+    if (op == "merge") {
+        bool ok = git.merge(arg1);
+        writeHead(json, "commitId", git);
+        if (git.activeBranch() != NULL && git.activeBranch()->head != NULL)
+            json.field("fileCount", git.activeBranch()->head->tree->fileCount);
+        return ok;
+    }
+    if (op == "undo" || op == "redo") {
+        bool ok = (op == "undo") ? git.undo() : git.redo();
+        if (ok) writeHead(json, "commitId", git);
+        return ok;
+    }
+    if (op == "revert") {
+        bool ok = git.revert(arg1);
+        if (ok) {
+            writeHead(json, "newCommitId", git);
+            json.field("fileCount", git.working().fileCount);
+        }
+        return ok;
+    }
+    if (op == "gc") {
+        bool ok = git.gc(arg1 == "incremental");
+        const GarbageCollector& gc = git.gcState();
+        if (ok) {
+            json.field("running", gc.running());
+            json.field("prunedCommits", gc.prunedCommits);
+            json.field("liveCommits", gc.liveCommits);
+            json.field("freedBlobs", gc.freedBlobs);
+            json.field("packBytes", (long long)gc.bytesAfter);
+        }
+        return ok;
+    }
+    console() << "  Unknown operation: " << op << endl;
+    return false;
+}
+
+bool runHostOp(mg_host* host, const string& op, const string& arg1, JsonWriter& json) {
+    if (op == "repo.create") {
+        bool ok = createRepository(host->repos, host->storageRoot, arg1);
+        if (ok) json.field("repo", string_view(arg1));
+        return ok;
+    }
+    if (op == "repo.delete") return deleteRepository(host->repos, arg1);
+    if (op == "repo.exists") {
+        RepoLease<MiniGit> repo = host->repos.read(arg1);
+        if (!repo.isValid()) {
+            console() << "  Repository '" << arg1 << "' not found." << endl;
+            return false;
+        }
+        json.field("repo", string_view(arg1)).key("branch");
+        if (repo->activeBranch() != NULL) json.value(string_view(repo->activeBranch()->name));
+        else json.null();
+        return true;
+    }
+    if (op == "repos") {
+        string* names;
+        int count = host->repos.names(names);
+        json.key("repos").beginArray();
+        for (int i = 0; i < count; i++) {
+            RepoLease<MiniGit> repo = host->repos.read(names[i]);
+            if (!repo.isValid()) continue;
+            json.beginObject().field("name", string_view(names[i])).field("initialized", repo->isInitialized());
+            json.key("branch");
+            if (repo->activeBranch() != NULL) json.value(string_view(repo->activeBranch()->name));
+            else json.null();
+            json.endObject();
+        }
+        json.endArray();
+        json.field("total", count);
+        delete[] names;
+        return true;
+    }
+    if (op == "reset") {
+        string* names;
+        int count = host->repos.names(names);
+        for (int i = 0; i < count; i++) deleteRepository(host->repos, names[i]);
+        delete[] names;
+        console() << "  All repositories reset." << endl;
+        return true;
+    }
+    if (op == "stats") {
+        if (arg1 == "prometheus") json.field("text", string_view(statsPrometheus()));
+        else writeStatsJson(json);
+        return true;
+    }
+    console() << "  Unknown operation: " << op << endl;
+    return false;
+}
+
+char* finish(JsonWriter& json) {
+    char* result = (char*)malloc(json.out.length() + 1);
+    if (result != NULL) memcpy(result, json.out.c_str(), json.out.length() + 1);
+    return result;
+}
+
+extern "C" {
+
+int mg_abi_version(void) { return MG_ABI_VERSION; }
+
+mg_host* mg_host_open(const char* storage_root) {
+    mg_host* host = new mg_host();
+    host->storageRoot = (storage_root != NULL && storage_root[0] != '\0') ? storage_root : ".minigit";
+    openRepositories(host->repos, host->storageRoot);
+    return host;
+}
+
+void mg_host_close(mg_host* host) { delete host; }
+
+char* mg_execute(mg_host* host, const char* repo, const char* op, const char* arg1, const char* arg2) {
+    JsonWriter json;
+    json.beginObject();
+    if (host == NULL || op == NULL) {
+        json.field("success", false).field("message", "Invalid call.").endObject();
+        return finish(json);
+    }
+    string name = (repo != NULL) ? repo : "";
+    string operation = op;
+    string a1 = (arg1 != NULL) ? arg1 : "";
+    string a2 = (arg2 != NULL) ? arg2 : "";
+
+    ostringstream text;
+    bool ok;
+    {
+        ConsoleCapture capture(text);
+        if (operation.compare(0, 5, "repo.") == 0 || operation == "repos" || operation == "reset"
+            || operation == "stats") {
+            ok = runHostOp(host, operation, a1, json);
+        } else if (name.empty()) {
+            console() << "  No repository selected. Run 'repo create <name>' first." << endl;
+            ok = false;
+        } else {
+            RepoLease<MiniGit> lease = host->repos.open(name, !isReadOp(operation));
+            if (!lease.isValid()) {
+                console() << "  Repository '" << name << "' not found." << endl;
+                ok = false;
+            } else {
+                ok = runRepoOp(*lease.get(), name, operation, a1, a2, json);
+                if (!isReadOp(operation) && operation != "gc" && lease.get()->gcPending()) lease.get()->gcSlice();
+            }
+        }
+    }
+    json.field("success", ok);
+    json.field("message", string_view(consoleMessage(text.str())));
+    json.endObject();
+    return finish(json);
+}
+
+void mg_free(char* result) { free(result); }
+
+}
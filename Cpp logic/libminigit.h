@@ -0,0 +1,26 @@
+#ifndef LIBMINIGIT_H
+#define LIBMINIGIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MG_ABI_VERSION 1
+
+typedef struct mg_host mg_host;
+
+int mg_abi_version(void);
+
+mg_host* mg_host_open(const char* storage_root);
+
+void mg_host_close(mg_host* host);
+
+char* mg_execute(mg_host* host, const char* repo, const char* op, const char* arg1, const char* arg2);
+
+void mg_free(char* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef MERGE_H
+#define MERGE_H
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include "minigit.h"
+#include "diff.h"
+#include "tree.h"
+using namespace std;
+
+Commit* mergeBase(Commit* a, Commit* b) {
+    if (a == NULL || b == NULL || a->graph != b->graph) return NULL;
+    if (a == b) return a;
+
+    const unsigned char FROM_A = 1, FROM_B = 2, QUEUED = 4;
+    CommitGraph* g = a->graph;
+    unsigned char* flags = new unsigned char[g->nodeCount]();
+    GenerationQueue queue(g);
+    flags[a->node] = FROM_A | QUEUED;
+    flags[b->node] = FROM_B | QUEUED;
+    queue.push(a->node);
+    queue.push(b->node);
+
+    Commit* base = NULL;
+    while (!queue.isEmpty()) {
+        int node = queue.pop();
+        unsigned char side = flags[node] & (FROM_A | FROM_B);
+        if (side == (FROM_A | FROM_B)) {
+            base = g->commits[node];
+            break;
+        }
+        for (int i = 0; i < g->parentCounts[node]; i++) {
+            int p = g->parent(node, i);
+            flags[p] |= side;
+            if (!(flags[p] & QUEUED)) {
+                flags[p] |= QUEUED;
+                queue.push(p);
+            }
+        }
+    }
+    delete[] flags;
+    return base;
+}
+
+class MergeHunk {
+public:
+    int baseStart;
+    int baseEnd;
+    int sideStart;
+    int sideEnd;
+};
+
+class HunkList {
+public:
+    MergeHunk* hunks;
+    int count;
+    int capacity;
+
+    HunkList() : hunks(new MergeHunk[16]), count(0), capacity(16) {}
+
+    ~HunkList() { delete[] hunks; }
+
+    void collect(const EditScript& script) {
+        int i = 0;
+        int basePos = 0, sidePos = 0;
+        while (i < script.count) {
+            if (script.ops[i].kind == DIFF_EQUAL) {
+                basePos = script.ops[i].oldLine + 1;
+                sidePos = script.ops[i].newLine + 1;
+                i++;
+                continue;
+            }
+            MergeHunk h;
+            h.baseStart = basePos;
+            h.sideStart = sidePos;
+            while (i < script.count && script.ops[i].kind != DIFF_EQUAL) {
+                if (script.ops[i].kind == DIFF_DELETE) basePos = script.ops[i].oldLine + 1;
+                else sidePos = script.ops[i].newLine + 1;
+                i++;
+            }
+            h.baseEnd = basePos;
+            h.sideEnd = sidePos;
+            push(h);
+        }
+    }
+
+    void push(const MergeHunk& h) {
+        if (count == capacity) {
+            capacity *= 2;
+            MergeHunk* grown = new MergeHunk[capacity];
+            for (int i = 0; i < count; i++) grown[i] = hunks[i];
+            delete[] hunks;
+            hunks = grown;
+        }
+        hunks[count++] = h;
+    }
+
+private:
+    HunkList(const HunkList&);
+    HunkList& operator=(const HunkList&);
+};
+
+void appendLines(string& out, const LineTokens& lines, int from, int to) {
+    for (int i = from; i < to; i++) {
+        out.append(lines.lines[i].data(), lines.lines[i].length());
+        out += '\n';
+    }
+}
+
+bool sameLines(const LineTokens& a, int aFrom, int aTo, const LineTokens& b, int bFrom, int bTo) {
+    if (aTo - aFrom != bTo - bFrom) return false;
+    for (int i = 0; i < aTo - aFrom; i++) {
+        if (a.lines[aFrom + i] != b.lines[bFrom + i]) return false;
+    }
+    return true;
+}
+
+bool mergeText(string_view base, string_view ours, string_view theirs,
+               const string& oursLabel, const string& theirsLabel, string& out) {
+    LineDiff left, right;
+    left.compute(base, ours);
+    right.compute(base, theirs);
+    HunkList a, b;
+    a.collect(left.script);
+    b.collect(right.script);
+
+    const LineTokens& baseLines = left.oldLines;
+    out.clear();
+    bool conflict = false;
+    int basePos = 0;
+    int ia = 0, ib = 0;
+    int deltaA = 0, deltaB = 0;
+    while (ia < a.count || ib < b.count) {
+        int lo;
+        if (ib >= b.count || (ia < a.count && a.hunks[ia].baseStart <= b.hunks[ib].baseStart))
+            lo = a.hunks[ia].baseStart;
+        else
+            lo = b.hunks[ib].baseStart;
+        int hi = lo;
+        int endA = ia, endB = ib;
+        bool grew = true;
+        while (grew) {
+            grew = false;
+            if (endA < a.count && a.hunks[endA].baseStart <= hi) {
+                if (a.hunks[endA].baseEnd > hi) hi = a.hunks[endA].baseEnd;
+                endA++;
+                grew = true;
+            }
+            if (endB < b.count && b.hunks[endB].baseStart <= hi) {
+                if (b.hunks[endB].baseEnd > hi) hi = b.hunks[endB].baseEnd;
+                endB++;
+                grew = true;
+            }
+        }
+
+        appendLines(out, baseLines, basePos, lo);
+
+        int groupDeltaA = 0, groupDeltaB = 0;
+        for (int i = ia; i < endA; i++)
+            groupDeltaA += (a.hunks[i].sideEnd - a.hunks[i].sideStart) - (a.hunks[i].baseEnd - a.hunks[i].baseStart);
+        for (int i = ib; i < endB; i++)
+            groupDeltaB += (b.hunks[i].sideEnd - b.hunks[i].sideStart) - (b.hunks[i].baseEnd - b.hunks[i].baseStart);
+        int aFrom = lo + deltaA, aTo = hi + deltaA + groupDeltaA;
+        int bFrom = lo + deltaB, bTo = hi + deltaB + groupDeltaB;
+
+        if (endB == ib) {
+            appendLines(out, left.newLines, aFrom, aTo);
+        } else if (endA == ia) {
+            appendLines(out, right.newLines, bFrom, bTo);
+        } else if (sameLines(left.newLines, aFrom, aTo, right.newLines, bFrom, bTo)) {
+            appendLines(out, left.newLines, aFrom, aTo);
+        } else {
+            conflict = true;
+            out += "<<<<<<< " + oursLabel + "\n";
+            appendLines(out, left.newLines, aFrom, aTo);
+            out += "=======\n";
+            appendLines(out, right.newLines, bFrom, bTo);
+            out += ">>>>>>> " + theirsLabel + "\n";
+        }
+
+        deltaA += groupDeltaA;
+        deltaB += groupDeltaB;
+        basePos = hi;
+        ia = endA;
+        ib = endB;
+    }
+    appendLines(out, baseLines, basePos, baseLines.count);
+
+    bool trailingNewline = (!ours.empty() && ours.back() == '\n') || (!theirs.empty() && theirs.back() == '\n');
+    if (!trailingNewline && !out.empty() && out.back() == '\n') out.erase(out.length() - 1);
+    return !conflict;
+}
+
+class TreeMerge {
+private:
+    TreeStore* trees;
+    bool ownsTrees;
+    string oursLabel;
+    string theirsLabel;
+
+    class ChangeApplier : public TreeVisitor {
+    public:
+        TreeMerge& merge;
+
+        ChangeApplier(TreeMerge& m) : merge(m) {}
+
+        void changed(const string& path, Blob* before, Blob* after) {
+            (void)before;
+            merge.apply(path, after);
+        }
+    };
+
+    void apply(string_view name, Blob* merged) {
+        if (merged != NULL) result.putBlob(name, merged);
+        else result.removeFile(name);
+        changes.push(result.store->internName(name, fastHash(name)), merged);
+    }
+
+    static TreeEntry* entryAt(Tree* t, int i) { return (t != NULL && i < t->count) ? &t->entries[i] : NULL; }
+
+    void walk(string& path, Tree* base, Tree* ours, Tree* theirs) {
+        if (theirs == base || theirs == ours) return;
+        if (ours == base) {
+            ChangeApplier applier(*this);
+            diffTrees(ours, theirs, path, applier);
+            return;
+        }
+        subtreesVisited++;
+        int ib = 0, io = 0, it = 0;
+        while (true) {
+            TreeEntry* b = entryAt(base, ib);
+            TreeEntry* o = entryAt(ours, io);
+            TreeEntry* t = entryAt(theirs, it);
+            if (b == NULL && o == NULL && t == NULL) break;
+            string_view name;
+            if (b != NULL) name = b->name;
+            if (o != NULL && (name.empty() || o->name < name)) name = o->name;
+            if (t != NULL && (name.empty() || t->name < name)) name = t->name;
+            if (b != NULL && b->name == name) ib++; else b = NULL;
+            if (o != NULL && o->name == name) io++; else o = NULL;
+            if (t != NULL && t->name == name) it++; else t = NULL;
+
+            size_t mark = path.length();
+            path.append(name.data(), name.length());
+            bool dirs = (b == NULL || b->tree != NULL) && (o == NULL || o->tree != NULL) && (t == NULL || t->tree != NULL);
+            bool files = (b == NULL || b->tree == NULL) && (o == NULL || o->tree == NULL) && (t == NULL || t->tree == NULL);
+            if (dirs) {
+                path += '/';
+                walk(path, b != NULL ? b->tree : NULL, o != NULL ? o->tree : NULL, t != NULL ? t->tree : NULL);
+            } else if (files) {
+                resolve(path, b != NULL ? b->blob : NULL, o != NULL ? o->blob : NULL, t != NULL ? t->blob : NULL);
+            } else {
+                conflicts++;
+                report << "  CONFLICT (file/directory): " << path << '\n';
+            }
+            path.resize(mark);
+        }
+    }
+
+public:
+    FileState result;
+    ChangeList changes;
+    Tree* resultTree;
+    int conflicts;
+    int autoMerged;
+    int subtreesVisited;
+    ostringstream report;
+
+    TreeMerge(BlobStore* store, TreeStore* t = NULL)
+        : trees(t), ownsTrees(t == NULL), result(store), resultTree(NULL),
+          conflicts(0), autoMerged(0), subtreesVisited(0) {
+        if (ownsTrees) trees = new TreeStore(store);
+    }
+
+    ~TreeMerge() {
+        if (ownsTrees) delete trees;
+    }
+
+    void resolve(string_view name, Blob* base, Blob* ours, Blob* theirs) {
+        Blob* merged;
+        if (ours == theirs || base == theirs) {
+            return;
+        } else if (base == ours) {
+            merged = theirs;
+        } else if (ours == NULL || theirs == NULL) {
+            merged = (ours != NULL) ? ours : theirs;
+            conflicts++;
+            report << "  CONFLICT (modify/delete): " << name << '\n';
+        } else {
+            string text;
+            bool clean = mergeText(base != NULL ? base->content() : string_view(),
+                                   ours->content(), theirs->content(), oursLabel, theirsLabel, text);
+            merged = result.store->intern(text);
+            if (clean) {
+                autoMerged++;
+                report << "  Auto-merged: " << name << '\n';
+            } else {
+                conflicts++;
+                report << "  CONFLICT (content): " << name << '\n';
+            }
+        }
+        if (merged != ours) apply(name, merged);
+    }
+
+    void run(Tree* base, Tree* ours, Tree* theirs, FileState& oursFiles,
+             const string& oursName, const string& theirsName) {
+        oursLabel = oursName;
+        theirsLabel = theirsName;
+        result = oursFiles.copy();
+        string path;
+        walk(path, base, ours, theirs);
+        resultTree = trees->update(ours, changes);
+    }
+
+    void run(FileState* base, FileState& ours, FileState& theirs,
+             const string& oursName, const string& theirsName) {
+        run(base != NULL ? trees->build(*base) : NULL, trees->build(ours), trees->build(theirs), ours,
+            oursName, theirsName);
+    }
+
+private:
+    TreeMerge(const TreeMerge&);
+    TreeMerge& operator=(const TreeMerge&);
+};
+
+#endif
@@ -3,62 +3,574 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "digest.h"
+#include "delta.h"
+#include "arena.h"
 using namespace std;
 
+mutex& deltaLock() {
+    static mutex lock;
+    return lock;
+}
+
+class Blob {
+public:
+    BlobId hash;
+    u64 fast;
+    mutable string owned;
+    const char* mapped;
+    size_t size;
+    Blob* base;
+    mutable atomic<const char*> delta;
+    size_t deltaSize;
+    Blob** chunks;
+    int chunkCount;
+    mutable atomic<bool> joined;
+    Blob* next;
+    Blob* idNext;
+
+    Blob(const BlobId& h, u64 f, const char* data, size_t len)
+        : hash(h), fast(f), mapped(data), size(len), base(NULL), delta(NULL), deltaSize(0),
+          chunks(NULL), chunkCount(0), joined(false), next(NULL), idNext(NULL) {}
+
+    Blob(const BlobId& h, u64 f, Blob* b, const char* d, size_t dlen, size_t len)
+        : hash(h), fast(f), mapped(NULL), size(len), base(b), delta(d), deltaSize(dlen),
+          chunks(NULL), chunkCount(0), joined(false), next(NULL), idNext(NULL) {}
+
+    Blob(const BlobId& h, u64 f, Blob** parts, int n, size_t len)
+        : hash(h), fast(f), mapped(NULL), size(len), base(NULL), delta(NULL), deltaSize(0),
+          chunks(parts), chunkCount(n), joined(false), next(NULL), idNext(NULL) {}
+
+    string_view content() const {
+        if (mapped != NULL) return string_view(mapped, size);
+        if (chunks != NULL && !joined.load(memory_order_acquire)) {
+            string whole;
+            whole.reserve(size);
+            for (int i = 0; i < chunkCount; i++) whole.append(chunks[i]->content());
+            lock_guard<mutex> guard(deltaLock());
+            if (!joined.load(memory_order_relaxed)) {
+                owned.swap(whole);
+                joined.store(true, memory_order_release);
+            }
+        }
+        if (delta.load(memory_order_acquire) != NULL) {
+            string_view source = base->content();
+            lock_guard<mutex> guard(deltaLock());
+            const char* d = delta.load(memory_order_relaxed);
+            if (d != NULL) {
+                applyDelta(source, string_view(d, deltaSize), owned);
+                delta.store(NULL, memory_order_release);
+            }
+        }
+        return string_view(owned);
+    }
+
+    bool isDelta() const { return delta != NULL; }
+
+    bool isChunked() const { return chunks != NULL; }
+
+    int pieces() const { return chunks != NULL ? chunkCount : 1; }
+
+    string_view piece(int i) const { return chunks != NULL ? chunks[i]->content() : content(); }
+
+    bool isMapped() const { return mapped != NULL || delta.load(memory_order_acquire) != NULL; }
+
+    const char* mappedData() const { return mapped != NULL ? mapped : delta.load(memory_order_acquire); }
+
+    void materialize() {
+        if (!isMapped()) return;
+        string copy(content());
+        owned.swap(copy);
+        mapped = NULL;
+        delta.store(NULL, memory_order_release);
+    }
+
+    void remap(const char* data) {
+        if (mapped != NULL) mapped = data;
+        else if (delta.load(memory_order_acquire) != NULL) delta.store(data, memory_order_release);
+    }
+};
+
+class BlobStore {
+private:
+    Arena arena;
+    Blob** buckets;
+    Blob** idBuckets;
+    int bucketCount;
+    string_view* names;
+    u64* nameHashes;
+    int nameSlots;
+    int nameCount;
+    Blob* spare;
+
+    BlobStore(const BlobStore&);
+    BlobStore& operator=(const BlobStore&);
+
+    void grow() {
+        Blob** old = buckets;
+        int oldCount = bucketCount;
+        bucketCount *= 2;
+        delete[] idBuckets;
+        buckets = new Blob*[bucketCount]();
+        idBuckets = new Blob*[bucketCount]();
+        for (int i = 0; i < oldCount; i++) {
+            Blob* curr = old[i];
+            while (curr != NULL) {
+                Blob* next = curr->next;
+                link(curr);
+                curr = next;
+            }
+        }
+        delete[] old;
+    }
+
+    void growNames() {
+        string_view* oldNames = names;
+        u64* oldHashes = nameHashes;
+        int oldSlots = nameSlots;
+        nameSlots *= 2;
+        names = new string_view[nameSlots];
+        nameHashes = new u64[nameSlots];
+        int mask = nameSlots - 1;
+        for (int i = 0; i < oldSlots; i++) {
+            if (oldNames[i].data() == NULL) continue;
+            int j = (int)(oldHashes[i] & mask);
+            while (names[j].data() != NULL) j = (j + 1) & mask;
+            names[j] = oldNames[i];
+            nameHashes[j] = oldHashes[i];
+        }
+        delete[] oldNames;
+        delete[] oldHashes;
+    }
+
+    void link(Blob* blob) {
+        int b = (int)(blob->fast % bucketCount);
+        blob->next = buckets[b];
+        buckets[b] = blob;
+        int ib = (int)(blob->hash.prefix() % bucketCount);
+        blob->idNext = idBuckets[ib];
+        idBuckets[ib] = blob;
+    }
+
+    Blob* lookup(string_view content, u64 fast) {
+        int probes = 1;
+        Blob* curr = buckets[fast % bucketCount];
+        while (curr != NULL && !(curr->fast == fast && curr->content() == content)) {
+            curr = curr->next;
+            probes++;
+        }
+        TRACE_COUNT(CTR_BLOB_LOOKUPS, 1);
+        TRACE_COUNT(CTR_BLOB_PROBES, probes);
+        return curr;
+    }
+
+    void unlink(Blob* blob) {
+        Blob** link = &buckets[blob->fast % bucketCount];
+        while (*link != blob) link = &(*link)->next;
+        *link = blob->next;
+        link = &idBuckets[blob->hash.prefix() % bucketCount];
+        while (*link != blob) link = &(*link)->idNext;
+        *link = blob->idNext;
+    }
+
+    template <typename... Args>
+    Blob* make(Args&&... args) {
+        if (spare == NULL) return arena.create<Blob>(std::forward<Args>(args)...);
+        Blob* blob = spare;
+        spare = blob->next;
+        spareCount--;
+        blob->~Blob();
+        return new (blob) Blob(std::forward<Args>(args)...);
+    }
+
+    Blob* copyIn(string_view content, const BlobId& hash, u64 fast) {
+        char* bytes = (char*)arena.allocate(content.length() > 0 ? content.length() : 1, 1);
+        memcpy(bytes, content.data(), content.length());
+        Blob* blob = make(hash, fast, (const char*)bytes, content.length());
+        add(blob);
+        return blob;
+    }
+
+public:
+    int blobCount;
+    long long totalBytes;
+    int spareCount;
+
+    BlobStore() : bucketCount(64), nameSlots(64), nameCount(0), spare(NULL), blobCount(0), totalBytes(0), spareCount(0) {
+        buckets = new Blob*[bucketCount]();
+        idBuckets = new Blob*[bucketCount]();
+        names = new string_view[nameSlots];
+        nameHashes = new u64[nameSlots];
+    }
+
+    ~BlobStore() {
+        delete[] buckets;
+        delete[] idBuckets;
+        delete[] names;
+        delete[] nameHashes;
+    }
+
+    string_view internName(string_view name, u64 h) {
+        int mask = nameSlots - 1;
+        int i = (int)(h & mask);
+        for (; names[i].data() != NULL; i = (i + 1) & mask) {
+            if (nameHashes[i] == h && names[i] == name) return names[i];
+        }
+        char* bytes = (char*)arena.allocate(name.length() + 1, 1);
+        memcpy(bytes, name.data(), name.length());
+        names[i] = string_view(bytes, name.length());
+        nameHashes[i] = h;
+        string_view interned = names[i];
+        if (++nameCount * 2 > nameSlots) growNames();
+        return interned;
+    }
+
+    Blob* intern(string_view content) {
+        u64 fast = fastHash(content);
+        Blob* existing = lookup(content, fast);
+        return (existing != NULL) ? existing : copyIn(content, BlobId(generateHash(content)), fast);
+    }
+
+    Blob* intern(string_view content, const BlobId& hash, u64 fast) {
+        Blob* existing = lookup(content, fast);
+        return (existing != NULL) ? existing : copyIn(content, hash, fast);
+    }
+
+    Blob* adopt(const BlobId& hash, u64 fast, const char* data, size_t size) {
+        Blob* existing = find(hash);
+        if (existing != NULL) return existing;
+        Blob* blob = make(hash, fast, data, size);
+        add(blob);
+        return blob;
+    }
+
+    Blob* adoptChunks(const BlobId& hash, u64 fast, Blob** parts, int n, size_t size) {
+        Blob* existing = find(hash);
+        if (existing != NULL) return existing;
+        Blob** copy = (Blob**)arena.allocate(sizeof(Blob*) * (n > 0 ? n : 1), alignof(Blob*));
+        for (int i = 0; i < n; i++) copy[i] = parts[i];
+        Blob* blob = make(hash, fast, copy, n, size);
+        add(blob);
+        return blob;
+    }
+
+    Blob* adoptDelta(const BlobId& hash, u64 fast, Blob* base, const char* delta, size_t deltaSize, size_t size) {
+        Blob* existing = find(hash);
+        if (existing != NULL) return existing;
+        Blob* blob = make(hash, fast, base, delta, deltaSize, size);
+        add(blob);
+        return blob;
+    }
+
+    int collect(Blob**& out) {
+        out = new Blob*[blobCount > 0 ? blobCount : 1];
+        int n = 0;
+        for (int i = 0; i < bucketCount; i++) {
+            for (Blob* b = buckets[i]; b != NULL; b = b->next) out[n++] = b;
+        }
+        return n;
+    }
+
+    Blob* match(string_view content, u64 fast) { return lookup(content, fast); }
+
+    void release(Blob* blob) {
+        unlink(blob);
+        blobCount--;
+        if (!blob->isChunked()) totalBytes -= blob->size;
+        string().swap(blob->owned);
+        blob->idNext = NULL;
+        blob->next = spare;
+        spare = blob;
+        spareCount++;
+    }
+
+    void add(Blob* blob) {
+        link(blob);
+        blobCount++;
+        if (!blob->isChunked()) totalBytes += blob->size;
+        if (blobCount > bucketCount) grow();
+    }
+
+    Blob* find(const ObjectId& hash) {
+        int probes = 1;
+        Blob* curr = idBuckets[hash.prefix() % bucketCount];
+        while (curr != NULL && curr->hash != hash) {
+            curr = curr->idNext;
+            probes++;
+        }
+        TRACE_COUNT(CTR_BLOB_LOOKUPS, 1);
+        TRACE_COUNT(CTR_BLOB_PROBES, probes);
+        return curr;
+    }
+};
+
+BlobStore& sharedBlobStore() {
+    static BlobStore store;
+    return store;
+}
+
 class File {
 public:
-    string name;
-    string content;
+    string_view name;
+    Blob* blob;
+    u64 nameHash;
+
+    File() : blob(NULL), nameHash(0) {}
+
+    string_view content() const { return blob->content(); }
 };
 
 class FileState {
-public:
-    File files[100];
-    int fileCount;
+private:
+    int* index;
+    int indexSize;
+    int indexUsed;
+    int capacity;
 
-    FileState() : fileCount(0) {}
+    static const int EMPTY = 0;
+    static const int REMOVED = -1;
 
-    void addFile(string name, string content) {
-        for (int i = 0; i < fileCount; i++) {
-            if (files[i].name == name) {
-                files[i].content = content;
-                return;
+    int findSlot(string_view name, u64 h) {
+        if (indexSize == 0) return -1;
+        int mask = indexSize - 1;
+        int probes = 1;
+        for (int i = (int)(h & mask); ; i = (i + 1) & mask, probes++) {
+            int e = index[i];
+            if (e == EMPTY || (e != REMOVED && files[e - 1].nameHash == h && files[e - 1].name == name)) {
+                TRACE_COUNT(CTR_FILE_LOOKUPS, 1);
+                TRACE_COUNT(CTR_FILE_PROBES, probes);
+                return e == EMPTY ? -1 : i;
             }
         }
-        files[fileCount].name = name;
-        files[fileCount].content = content;
-        fileCount++;
     }
 
-    void removeFile(string name) {
-        for (int i = 0; i < fileCount; i++) {
-            if (files[i].name == name) {
-                for (int j = i; j < fileCount - 1; j++) {
-                    files[j] = files[j + 1];
-                }
-                fileCount--;
-                return;
+    void insertIndex(int entry) {
+        int mask = indexSize - 1;
+        int i = (int)(files[entry].nameHash & mask);
+        while (index[i] != EMPTY && index[i] != REMOVED) i = (i + 1) & mask;
+        if (index[i] == EMPTY) indexUsed++;
+        index[i] = entry + 1;
+    }
+
+    static int* newIndex(int size) {
+        int* block = new int[size + 1]();
+        block[0] = 1;
+        return block + 1;
+    }
+
+    static void freeIndex(int* p) {
+        if (p != NULL) delete[] (p - 1);
+    }
+
+    int& refs() { return index[-1]; }
+
+    void release() {
+        if (index != NULL && --refs() == 0) {
+            delete[] files;
+            freeIndex(index);
+        }
+        init(store);
+    }
+
+    void share(const FileState& other) {
+        store = other.store;
+        files = other.files;
+        used = other.used;
+        fileCount = other.fileCount;
+        index = other.index;
+        indexSize = other.indexSize;
+        indexUsed = other.indexUsed;
+        capacity = other.capacity;
+        if (index != NULL) refs()++;
+    }
+
+    void detach() {
+        if (index == NULL || refs() == 1) return;
+        refs()--;
+        TRACE_COUNT(CTR_SNAPSHOT_COPIES, 1);
+        TRACE_COUNT(CTR_SNAPSHOT_BYTES, capacity * sizeof(File) + indexSize * sizeof(int));
+        File* ownFiles = new File[capacity];
+        for (int i = 0; i < used; i++) ownFiles[i] = files[i];
+        int* ownIndex = newIndex(indexSize);
+        for (int i = 0; i < indexSize; i++) ownIndex[i] = index[i];
+        files = ownFiles;
+        index = ownIndex;
+    }
+
+    void rebuildIndex(int size) {
+        int refCount = (index != NULL) ? refs() : 1;
+        freeIndex(index);
+        indexSize = size;
+        indexUsed = 0;
+        index = newIndex(indexSize);
+        refs() = refCount;
+        for (int i = 0; i < used; i++) {
+            if (files[i].blob != NULL) insertIndex(i);
+        }
+    }
+
+    void compact() {
+        int w = 0;
+        for (int i = 0; i < used; i++) {
+            if (files[i].blob == NULL) continue;
+            if (w != i) {
+                files[w] = files[i];
+                files[i].blob = NULL;
             }
+            w++;
+        }
+        used = w;
+        rebuildIndex(indexSize);
+    }
+
+    void reserveEntry() {
+        if (used < capacity) return;
+        if (fileCount < used) {
+            compact();
+            if (used < capacity) return;
+        }
+        int newCapacity = (capacity > 0) ? capacity * 2 : 8;
+        File* grown = new File[newCapacity];
+        for (int i = 0; i < used; i++) grown[i] = files[i];
+        delete[] files;
+        files = grown;
+        capacity = newCapacity;
+    }
+
+    void init(BlobStore* s) {
+        store = s;
+        capacity = 0;
+        files = NULL;
+        used = 0;
+        fileCount = 0;
+        indexSize = 0;
+        indexUsed = 0;
+        index = NULL;
+    }
+
+public:
+    File* files;
+    int used;
+    int fileCount;
+    BlobStore* store;
+
+    FileState() { init(&sharedBlobStore()); }
+
+    FileState(BlobStore* s) { init(s); }
+
+    FileState(const FileState& other) { share(other); }
+
+    FileState(FileState&& other) : index(NULL), indexSize(0), indexUsed(0), capacity(0),
+                                   files(NULL), used(0), fileCount(0), store(other.store) {
+        swap(other);
+    }
+
+    FileState& operator=(const FileState& other) {
+        if (this != &other) {
+            release();
+            share(other);
+        }
+        return *this;
+    }
+
+    FileState& operator=(FileState&& other) {
+        swap(other);
+        return *this;
+    }
+
+    void swap(FileState& other) {
+        std::swap(files, other.files);
+        std::swap(used, other.used);
+        std::swap(fileCount, other.fileCount);
+        std::swap(store, other.store);
+        std::swap(index, other.index);
+        std::swap(indexSize, other.indexSize);
+        std::swap(indexUsed, other.indexUsed);
+        std::swap(capacity, other.capacity);
+    }
+
+    ~FileState() { release(); }
+
+    bool sharesWith(const FileState& other) const { return index != NULL && index == other.index; }
+
+    void addFile(string_view name, string_view content) {
+        putBlob(name, store->intern(content));
+    }
+
+    void putBlob(string_view name, Blob* blob) {
+        u64 h = fastHash(name);
+        int slot = findSlot(name, h);
+        if (slot >= 0) {
+            if (files[index[slot] - 1].blob == blob) return;
+            detach();
+            files[index[slot] - 1].blob = blob;
+            return;
+        }
+        detach();
+        reserveEntry();
+        files[used].name = store->internName(name, h);
+        files[used].blob = blob;
+        files[used].nameHash = h;
+        if ((indexUsed + 1) * 4 > indexSize * 3) {
+            int size = (indexSize > 0) ? indexSize : 16;
+            while ((fileCount + 1) * 2 > size) size *= 2;
+            rebuildIndex(size);
         }
+        insertIndex(used);
+        used++;
+        fileCount++;
+    }
+
+    void removeFile(string_view name) {
+        int slot = findSlot(name, fastHash(name));
+        if (slot < 0) return;
+        detach();
+        File* f = &files[index[slot] - 1];
+        f->blob = NULL;
+        f->name = string_view();
+        index[slot] = REMOVED;
+        fileCount--;
+        if (used > 16 && fileCount * 2 < used) compact();
     }
 
-    File* getFile(string name) {
-        for (int i = 0; i < fileCount; i++) {
-            if (files[i].name == name)
-                return &files[i];
+    File* getFile(string_view name) {
+        int slot = findSlot(name, fastHash(name));
+        if (slot < 0) return NULL;
+        return &files[index[slot] - 1];
+    }
+
+    File* first() { return (files != NULL) ? next(files - 1) : NULL; }
+
+    File* next(File* f) {
+        for (f++; f < files + used; f++) {
+            if (f->blob != NULL) return f;
         }
         return NULL;
     }
 
-    FileState copy() {
-        FileState fs;
-        fs.fileCount = fileCount;
-        for (int i = 0; i < fileCount; i++) {
-            fs.files[i].name = files[i].name;
-            fs.files[i].content = files[i].content;
+    FileState copy() { return FileState(*this); }
+
+    void clear() {
+        if (index != NULL && refs() > 1) {
+            release();
+            return;
+        }
+        for (int i = 0; i < used; i++) {
+            files[i].blob = NULL;
+            files[i].name = string_view();
         }
-        return fs;
+        used = 0;
+        fileCount = 0;
+        indexUsed = 0;
+        for (int i = 0; i < indexSize; i++) index[i] = EMPTY;
     }
 
     void printFiles() {
@@ -66,110 +578,632 @@ public:
             cout << "  (no files)" << endl;
             return;
         }
-        for (int i = 0; i < fileCount; i++) {
-            cout << "  [" << i << "] " << files[i].name << endl;
+        int i = 0;
+        for (File* f = first(); f != NULL; f = next(f)) {
+            cout << "  [" << i++ << "] " << f->name << endl;
         }
     }
 };
 
-string generateHash(string data) {
-    long long hash = 0;
-    for (int i = 0; i < (int)data.length(); i++) {
-        hash = hash * 31 + data[i];
+const int TIMESTAMP_SIZE = 32;
+
+void formatTimestamp(time_t t, char* out) {
+    const char* ts = ctime(&t);
+    size_t n = (ts != NULL) ? strcspn(ts, "\n") : 0;
+    if (n >= (size_t)TIMESTAMP_SIZE) n = TIMESTAMP_SIZE - 1;
+    if (n > 0) memcpy(out, ts, n);
+    out[n] = '\0';
+}
+
+string formatTimestamp(time_t t) {
+    char ts[TIMESTAMP_SIZE];
+    formatTimestamp(t, ts);
+    return ts;
+}
+
+string getTimestamp() {
+    return formatTimestamp(time(0));
+}
+
+bool parseDate(const string& text, time_t& out) {
+    if (text.empty()) return false;
+    bool digits = true;
+    for (int i = 0; i < (int)text.length(); i++) {
+        if (text[i] < '0' || text[i] > '9') digits = false;
+    }
+    if (digits) {
+        out = (time_t)stoll(text);
+        return true;
     }
-    if (hash < 0) hash = -hash;
+    int y, m, d;
+    if (sscanf(text.c_str(), "%d-%d-%d", &y, &m, &d) != 3) return false;
+    struct tm t = {};
+    t.tm_year = y - 1900;
+    t.tm_mon = m - 1;
+    t.tm_mday = d;
+    t.tm_isdst = -1;
+    out = mktime(&t);
+    return out != (time_t)-1;
+}
+
+template <typename T>
+T* resizeArray(T* old, int used, int capacity) {
+    T* fresh = new T[capacity];
+    for (int i = 0; i < used; i++) fresh[i] = old[i];
+    delete[] old;
+    return fresh;
+}
 
-    string result = "";
-    long long temp = hash;
-    char hexChars[] = "0123456789abcdef";
-    for (int i = 0; i < 8; i++) {
-        result = hexChars[temp % 16] + result;
-        temp /= 16;
+template <typename T>
+T* growArray(T* old, int used, int& capacity) {
+    capacity = (capacity > 0) ? capacity * 2 : 16;
+    return resizeArray(old, used, capacity);
+}
+
+class Commit;
+class Tree;
+
+const int BLOOM_UNKNOWN = -1;
+const int BLOOM_SATURATED = -2;
+const int BLOOM_HASHES = 7;
+const int BLOOM_BITS_PER_PATH = 10;
+const int BLOOM_MAX_PATHS = 512;
+
+int bloomWordsFor(int paths) { return (paths * BLOOM_BITS_PER_PATH + 63) / 64; }
+
+void bloomAdd(u64* words, int n, u64 key) {
+    u64 bits = (u64)n * 64;
+    u32 h1 = (u32)key, h2 = (u32)(key >> 32) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        u64 bit = (h1 + (u64)i * h2) % bits;
+        words[bit / 64] |= 1ULL << (bit % 64);
     }
-    return result;
 }
 
-string getTimestamp() {
-    time_t now = time(0);
-    string ts = ctime(&now);
-    if (!ts.empty() && ts[ts.length() - 1] == '\n')
-        ts = ts.substr(0, ts.length() - 1);
-    return ts;
+bool bloomTest(const u64* words, int n, u64 key) {
+    if (n == 0) return false;
+    u64 bits = (u64)n * 64;
+    u32 h1 = (u32)key, h2 = (u32)(key >> 32) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        u64 bit = (h1 + (u64)i * h2) % bits;
+        if (!(words[bit / 64] & (1ULL << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+class CommitGraph {
+public:
+    Commit** commits;
+    int* generations;
+    int* parentStart;
+    int* parentCounts;
+    int* childHead;
+    int* childCounts;
+    int nodeCount;
+    int nodeCapacity;
+
+    int* parentArena;
+    int parentUsed;
+    int parentCapacity;
+
+    int* childArena;
+    int* childNext;
+    int childUsed;
+    int childCapacity;
+
+    int* bloomStart;
+    int* bloomWords;
+    u64* bloomArena;
+    int bloomUsed;
+    int bloomCapacity;
+
+    int* freeNodes;
+    int freeCount;
+    int freeCapacity;
+
+    CommitGraph() : commits(NULL), generations(NULL), parentStart(NULL), parentCounts(NULL),
+                    childHead(NULL), childCounts(NULL), nodeCount(0), nodeCapacity(0),
+                    parentArena(NULL), parentUsed(0), parentCapacity(0),
+                    childArena(NULL), childNext(NULL), childUsed(0), childCapacity(0),
+                    bloomStart(NULL), bloomWords(NULL), bloomArena(NULL), bloomUsed(0), bloomCapacity(0),
+                    freeNodes(NULL), freeCount(0), freeCapacity(0) {}
+
+    ~CommitGraph() {
+        delete[] commits;
+        delete[] generations;
+        delete[] parentStart;
+        delete[] parentCounts;
+        delete[] childHead;
+        delete[] childCounts;
+        delete[] parentArena;
+        delete[] childArena;
+        delete[] childNext;
+        delete[] bloomStart;
+        delete[] bloomWords;
+        delete[] bloomArena;
+        delete[] freeNodes;
+    }
+
+    int addNode(Commit* c) {
+        if (freeCount == 0 && nodeCount == nodeCapacity) {
+            nodeCapacity = (nodeCapacity > 0) ? nodeCapacity * 2 : 16;
+            commits = resizeArray(commits, nodeCount, nodeCapacity);
+            generations = resizeArray(generations, nodeCount, nodeCapacity);
+            parentStart = resizeArray(parentStart, nodeCount, nodeCapacity);
+            parentCounts = resizeArray(parentCounts, nodeCount, nodeCapacity);
+            childHead = resizeArray(childHead, nodeCount, nodeCapacity);
+            childCounts = resizeArray(childCounts, nodeCount, nodeCapacity);
+            bloomStart = resizeArray(bloomStart, nodeCount, nodeCapacity);
+            bloomWords = resizeArray(bloomWords, nodeCount, nodeCapacity);
+        }
+        int node = (freeCount > 0) ? freeNodes[--freeCount] : nodeCount++;
+        commits[node] = c;
+        generations[node] = 1;
+        parentStart[node] = parentUsed;
+        parentCounts[node] = 0;
+        childHead[node] = -1;
+        childCounts[node] = 0;
+        bloomStart[node] = 0;
+        bloomWords[node] = BLOOM_UNKNOWN;
+        return node;
+    }
+
+    void addParent(int node, int parent) {
+        if (parentStart[node] + parentCounts[node] != parentUsed) {
+            while (parentUsed + parentCounts[node] >= parentCapacity)
+                parentArena = growArray(parentArena, parentUsed, parentCapacity);
+            int moved = parentUsed;
+            for (int i = 0; i < parentCounts[node]; i++)
+                parentArena[parentUsed++] = parentArena[parentStart[node] + i];
+            parentStart[node] = moved;
+        }
+        if (parentUsed == parentCapacity) parentArena = growArray(parentArena, parentUsed, parentCapacity);
+        parentArena[parentUsed++] = parent;
+        parentCounts[node]++;
+        if (generations[parent] > 0 && generations[parent] + 1 > generations[node])
+            generations[node] = generations[parent] + 1;
+
+        if (childUsed == childCapacity) {
+            childArena = growArray(childArena, childUsed, childCapacity);
+            childNext = resizeArray(childNext, childUsed, childCapacity);
+        }
+        childArena[childUsed] = node;
+        childNext[childUsed] = childHead[parent];
+        childHead[parent] = childUsed++;
+        childCounts[parent]++;
+    }
+
+    int parent(int node, int i) const { return parentArena[parentStart[node] + i]; }
+
+    void unlinkChild(int parent, int child) {
+        int* link = &childHead[parent];
+        while (*link >= 0 && childArena[*link] != child) link = &childNext[*link];
+        if (*link < 0) return;
+        *link = childNext[*link];
+        childCounts[parent]--;
+    }
+
+    void releaseNode(int node) {
+        for (int i = 0; i < parentCounts[node]; i++) unlinkChild(parent(node, i), node);
+        for (int e = childHead[node]; e >= 0; e = childNext[e]) {
+            int child = childArena[e];
+            int kept = 0;
+            for (int i = 0; i < parentCounts[child]; i++) {
+                int p = parent(child, i);
+                if (p != node) parentArena[parentStart[child] + kept++] = p;
+            }
+            parentCounts[child] = kept;
+        }
+        commits[node] = NULL;
+        generations[node] = 1;
+        parentCounts[node] = 0;
+        childHead[node] = -1;
+        childCounts[node] = 0;
+        bloomWords[node] = BLOOM_UNKNOWN;
+        if (freeCount == freeCapacity) freeNodes = growArray(freeNodes, freeCount, freeCapacity);
+        freeNodes[freeCount++] = node;
+    }
+
+    void compact() {
+        parentCapacity = parentUsed > 0 ? parentUsed : 1;
+        childCapacity = childUsed > 0 ? childUsed : 1;
+        bloomCapacity = bloomUsed > 0 ? bloomUsed : 1;
+        int* parents = new int[parentCapacity];
+        int* children = new int[childCapacity];
+        int* links = new int[childCapacity];
+        u64* blooms = new u64[bloomCapacity];
+        int p = 0, c = 0, b = 0;
+        for (int node = 0; node < nodeCount; node++) {
+            for (int i = 0; i < parentCounts[node]; i++) parents[p + i] = parent(node, i);
+            parentStart[node] = p;
+            p += parentCounts[node];
+
+            int* tail = &childHead[node];
+            for (int e = childHead[node]; e >= 0; e = childNext[e]) {
+                children[c] = childArena[e];
+                *tail = c;
+                tail = &links[c++];
+            }
+            *tail = -1;
+
+            if (bloomWords[node] > 0) {
+                for (int i = 0; i < bloomWords[node]; i++) blooms[b + i] = bloomArena[bloomStart[node] + i];
+                bloomStart[node] = b;
+                b += bloomWords[node];
+            }
+        }
+        delete[] parentArena;
+        delete[] childArena;
+        delete[] childNext;
+        delete[] bloomArena;
+        parentArena = parents;
+        childArena = children;
+        childNext = links;
+        bloomArena = blooms;
+        parentUsed = p;
+        childUsed = c;
+        bloomUsed = b;
+    }
+
+    void setBloom(int node, const u64* words, int n) {
+        bloomWords[node] = n;
+        if (n <= 0) return;
+        while (bloomUsed + n > bloomCapacity) bloomArena = growArray(bloomArena, bloomUsed, bloomCapacity);
+        bloomStart[node] = bloomUsed;
+        for (int i = 0; i < n; i++) bloomArena[bloomUsed++] = words[i];
+    }
+
+    bool hasBloom(int node) const { return bloomWords[node] != BLOOM_UNKNOWN; }
+
+    bool mayChange(int node, u64 key) const {
+        if (bloomWords[node] < 0) return true;
+        return bloomTest(bloomArena + bloomStart[node], bloomWords[node], key);
+    }
+
+    void settleGeneration(int node) {
+        if (generations[node] > 0) return;
+        int capacity = 16;
+        int* pending = new int[capacity];
+        int top = 0;
+        pending[top++] = node;
+        while (top > 0) {
+            int n = pending[top - 1];
+            if (generations[n] > 0) {
+                top--;
+                continue;
+            }
+            bool ready = true;
+            int generation = 1;
+            for (int i = 0; i < parentCounts[n]; i++) {
+                int p = parent(n, i);
+                if (generations[p] == 0) {
+                    if (top == capacity) pending = growArray(pending, top, capacity);
+                    pending[top++] = p;
+                    ready = false;
+                } else if (generations[p] + 1 > generation) {
+                    generation = generations[p] + 1;
+                }
+            }
+            if (ready) {
+                generations[n] = generation;
+                top--;
+            }
+        }
+        delete[] pending;
+    }
+
+private:
+    CommitGraph(const CommitGraph&);
+    CommitGraph& operator=(const CommitGraph&);
+};
+
+CommitGraph* sharedCommitGraph() {
+    static CommitGraph graph;
+    return &graph;
 }
 
 class Commit {
 public:
-    string commitId;
+    CommitId commitId;
     string message;
-    string timestamp;
-    Commit* parent;
-    Commit* children[10];
-    int childCount;
-    FileState snapshot;
+    char timestamp[TIMESTAMP_SIZE];
+    time_t time;
+    CommitGraph* graph;
+    int node;
+    Tree* tree;
+
+    Commit(const CommitId& id, string msg, CommitGraph* g = sharedCommitGraph())
+        : commitId(id), message(move(msg)), tree(NULL) {
+        time = ::time(0);
+        formatTimestamp(time, timestamp);
+        graph = g;
+        node = graph->addNode(this);
+    }
+
+    ~Commit() {
+        if (node >= 0) graph->commits[node] = NULL;
+    }
 
-    Commit(string id, string msg) {
+    void retire() {
+        graph->releaseNode(node);
+        node = -1;
+        string().swap(message);
+        timestamp[0] = '\0';
+        tree = NULL;
+    }
+
+    void reuse(const CommitId& id, string msg, CommitGraph* g) {
         commitId = id;
-        message = msg;
-        timestamp = getTimestamp();
-        parent = NULL;
-        childCount = 0;
+        message = move(msg);
+        time = ::time(0);
+        formatTimestamp(time, timestamp);
+        tree = NULL;
+        graph = g;
+        node = graph->addNode(this);
+    }
+
+    void addParent(Commit* p) {
+        if (p != NULL) graph->addParent(node, p->node);
+    }
+
+    int parentCount() const { return graph->parentCounts[node]; }
+
+    Commit* parent(int i = 0) const {
+        if (i >= graph->parentCounts[node]) return NULL;
+        return graph->commits[graph->parent(node, i)];
     }
+
+    int childCount() const { return graph->childCounts[node]; }
+
+    int generation() const { return graph->generations[node]; }
 };
 
-class CommitStack {
+class CommitPool {
 private:
-    Commit* data[100];
-    int top;
+    Arena& arena;
+    Commit** spare;
+    int spareCount;
+    int spareCapacity;
+
+    CommitPool(const CommitPool&);
+    CommitPool& operator=(const CommitPool&);
 
 public:
-    CommitStack() : top(-1) {}
+    int recycled;
+
+    CommitPool(Arena& a) : arena(a), spare(NULL), spareCount(0), spareCapacity(0), recycled(0) {}
+
+    ~CommitPool() { delete[] spare; }
+
+    Commit* create(const CommitId& id, string msg, CommitGraph* g) {
+        if (spareCount == 0) return arena.create<Commit>(id, move(msg), g);
+        Commit* c = spare[--spareCount];
+        c->reuse(id, move(msg), g);
+        recycled++;
+        return c;
+    }
+
+    void release(Commit* c) {
+        c->retire();
+        if (spareCount == spareCapacity) spare = growArray(spare, spareCount, spareCapacity);
+        spare[spareCount++] = c;
+    }
+
+    int spares() const { return spareCount; }
+};
+
+class CommitIndex {
+private:
+    Commit** table;
+    int tableSize;
+    Commit** sorted;
+    int capacity;
+
+    CommitIndex(const CommitIndex&);
+    CommitIndex& operator=(const CommitIndex&);
 
-    void push(Commit* c) {
-        if (top < 99) {
-            data[++top] = c;
+    void insertTable(Commit* c) {
+        int mask = tableSize - 1;
+        int i = (int)(c->commitId.prefix() & mask);
+        while (table[i] != NULL) i = (i + 1) & mask;
+        table[i] = c;
+    }
+
+    int lowerBound(const ObjectId& key) {
+        int lo = 0, hi = count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (sorted[mid]->commitId < key) lo = mid + 1;
+            else hi = mid;
         }
+        return lo;
     }
 
-    Commit* pop() {
-        if (top >= 0) {
-            return data[top--];
+    int lowerBound(string_view hexPrefix) {
+        int lo = 0, hi = count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (sorted[mid]->commitId.compareHex(hexPrefix) < 0) lo = mid + 1;
+            else hi = mid;
         }
-        return NULL;
+        return lo;
     }
 
-    Commit* peek() {
-        if (top >= 0) return data[top];
-        return NULL;
+public:
+    int count;
+
+    CommitIndex() : tableSize(64), capacity(32), count(0) {
+        table = new Commit*[tableSize]();
+        sorted = new Commit*[capacity];
+    }
+
+    ~CommitIndex() {
+        delete[] table;
+        delete[] sorted;
+    }
+
+    bool add(Commit* c) {
+        Commit* existing = find(c->commitId);
+        if (existing != NULL) return existing == c;
+        if ((count + 1) * 2 > tableSize) {
+            Commit** old = table;
+            int oldSize = tableSize;
+            tableSize *= 2;
+            table = new Commit*[tableSize]();
+            for (int i = 0; i < oldSize; i++) {
+                if (old[i] != NULL) insertTable(old[i]);
+            }
+            delete[] old;
+        }
+        insertTable(c);
+
+        if (count == capacity) {
+            capacity *= 2;
+            Commit** grown = new Commit*[capacity];
+            for (int i = 0; i < count; i++) grown[i] = sorted[i];
+            delete[] sorted;
+            sorted = grown;
+        }
+        int pos = lowerBound(c->commitId);
+        for (int i = count; i > pos; i--) sorted[i] = sorted[i - 1];
+        sorted[pos] = c;
+        count++;
+        return true;
+    }
+
+    Commit* at(int i) const { return sorted[i]; }
+
+    int retain(const unsigned char* live) {
+        int kept = 0;
+        for (int i = 0; i < count; i++) {
+            if (live[sorted[i]->node]) sorted[kept++] = sorted[i];
+        }
+        int removed = count - kept;
+        count = kept;
+        for (int i = 0; i < tableSize; i++) table[i] = NULL;
+        for (int i = 0; i < count; i++) insertTable(sorted[i]);
+        return removed;
     }
 
-    bool isEmpty() { return top == -1; }
+    Commit* find(string_view hexId) {
+        ObjectId id;
+        return ObjectId::parse(hexId, id) ? find(id) : NULL;
+    }
 
-    int size() { return top + 1; }
+    Commit* find(const ObjectId& id) {
+        int mask = tableSize - 1;
+        int probes = 1;
+        int i = (int)(id.prefix() & mask);
+        while (table[i] != NULL && table[i]->commitId != id) {
+            i = (i + 1) & mask;
+            probes++;
+        }
+        TRACE_COUNT(CTR_COMMIT_LOOKUPS, 1);
+        TRACE_COUNT(CTR_COMMIT_PROBES, probes);
+        return table[i];
+    }
 
-    void clear() { top = -1; }
+    Commit* resolve(string_view prefix, bool& ambiguous) {
+        ambiguous = false;
+        if (prefix.length() >= 40) return find(prefix);
+        if (prefix.length() < 4) return NULL;
+        int pos = lowerBound(prefix);
+        if (pos >= count || sorted[pos]->commitId.compareHex(prefix) != 0)
+            return NULL;
+        if (pos + 1 < count && sorted[pos + 1]->commitId.compareHex(prefix) == 0) {
+            ambiguous = true;
+            return NULL;
+        }
+        return sorted[pos];
+    }
+
+    string abbreviate(const ObjectId& id) {
+        int len = 7;
+        int pos = lowerBound(id);
+        if (pos > 0 && sorted[pos - 1]->commitId != id) {
+            int n = sorted[pos - 1]->commitId.commonNibbles(id) + 1;
+            if (n > len) len = n;
+        }
+        if (pos < count && sorted[pos]->commitId == id) pos++;
+        if (pos < count) {
+            int n = sorted[pos]->commitId.commonNibbles(id) + 1;
+            if (n > len) len = n;
+        }
+        return id.abbrev(len > ID_HEX_LENGTH ? ID_HEX_LENGTH : len);
+    }
 };
 
 class Branch {
 public:
     string name;
+    u64 nameHash;
     Commit* head;
     Branch* next;
+    Branch* prev;
+    Branch* bucketNext;
 
-    Branch(string n, Commit* h) {
-        name = n;
-        head = h;
-        next = NULL;
-    }
+    Branch(string n, Commit* h)
+        : name(move(n)), nameHash(fastHash(name)), head(h), next(NULL), prev(NULL), bucketNext(NULL) {}
 };
 
+bool branchBefore(const Branch* a, const Branch* b) { return a->name < b->name; }
+
+bool validRefName(string_view name) {
+    if (name.empty() || name == "HEAD" || name[0] == '-' || name[0] == '/' || name.back() == '/') return false;
+    if (name.length() >= 5 && name.substr(name.length() - 5) == ".lock") return false;
+    for (size_t i = 0; i < name.length(); i++) {
+        unsigned char c = (unsigned char)name[i];
+        if (c <= ' ' || c == 0x7f || c == '~' || c == '^' || c == ':' || c == '?' || c == '*' || c == '['
+            || c == '\\')
+            return false;
+        if (i > 0 && ((c == '/' && name[i - 1] == '/') || (c == '.' && name[i - 1] == '.'))) return false;
+        if (c == '.' && (i == 0 || name[i - 1] == '/')) return false;
+    }
+    return true;
+}
+
+bool inNamespace(string_view name, string_view prefix) {
+    if (prefix.empty()) return true;
+    if (name.compare(0, prefix.length(), prefix) != 0) return false;
+    return name.length() == prefix.length() || prefix.back() == '/' || name[prefix.length()] == '/';
+}
+
 class BranchList {
+private:
+    Branch** buckets;
+    int bucketCount;
+    int branchCount;
+
+    BranchList(const BranchList&);
+    BranchList& operator=(const BranchList&);
+
+    void link(Branch* b) {
+        Branch** bucket = &buckets[b->nameHash & (bucketCount - 1)];
+        b->bucketNext = *bucket;
+        *bucket = b;
+    }
+
+    void grow() {
+        Branch** old = buckets;
+        bucketCount *= 2;
+        buckets = new Branch*[bucketCount]();
+        for (Branch* b = first; b != NULL; b = b->next) link(b);
+        delete[] old;
+    }
+
 public:
     Branch* first;
+    Branch* last;
     Branch* active;
+    Arena* arena;
 
-    BranchList() : first(NULL), active(NULL) {}
+    BranchList(Arena* a = NULL) : bucketCount(16), branchCount(0), first(NULL), last(NULL), active(NULL), arena(a) {
+        buckets = new Branch*[bucketCount]();
+    }
 
     ~BranchList() {
+        delete[] buckets;
+        if (arena != NULL) return;
         Branch* curr = first;
         while (curr) {
             Branch* temp = curr;
@@ -178,30 +1212,27 @@ public:
         }
     }
 
-    void addBranch(string name, Commit* head) {
-        Branch* newBranch = new Branch(name, head);
-        if (first == NULL) {
-            first = newBranch;
-        } else {
-            Branch* curr = first;
-            while (curr->next != NULL) {
-                curr = curr->next;
-            }
-            curr->next = newBranch;
-        }
+    Branch* addBranch(const string& name, Commit* head) {
+        Branch* newBranch = (arena != NULL) ? arena->create<Branch>(name, head) : new Branch(name, head);
+        newBranch->prev = last;
+        if (last != NULL) last->next = newBranch;
+        else first = newBranch;
+        last = newBranch;
+        if (++branchCount > bucketCount) grow();
+        else link(newBranch);
         if (active == NULL) active = newBranch;
+        return newBranch;
     }
 
-    Branch* findBranch(string name) {
-        Branch* curr = first;
-        while (curr != NULL) {
-            if (curr->name == name) return curr;
-            curr = curr->next;
+    Branch* findBranch(string_view name) {
+        u64 h = fastHash(name);
+        for (Branch* b = buckets[h & (bucketCount - 1)]; b != NULL; b = b->bucketNext) {
+            if (b->nameHash == h && b->name == name) return b;
         }
         return NULL;
     }
 
-    bool switchBranch(string name) {
+    bool switchBranch(string_view name) {
         Branch* b = findBranch(name);
         if (b != NULL) {
             active = b;
@@ -210,84 +1241,224 @@ public:
         return false;
     }
 
-    bool deleteBranch(string name) {
-        if (active != NULL && active->name == name) {
-            return false;
+    bool deleteBranch(string_view name) {
+        Branch* b = findBranch(name);
+        if (b == NULL || b == active) return false;
+
+        Branch** link = &buckets[b->nameHash & (bucketCount - 1)];
+        while (*link != b) link = &(*link)->bucketNext;
+        *link = b->bucketNext;
+        if (b->prev != NULL) b->prev->next = b->next;
+        else first = b->next;
+        if (b->next != NULL) b->next->prev = b->prev;
+        else last = b->prev;
+        branchCount--;
+        if (arena == NULL) delete b;
+        return true;
+    }
+
+    int sorted(Branch**& out, string_view prefix = "") {
+        out = new Branch*[branchCount > 0 ? branchCount : 1];
+        int n = 0;
+        for (Branch* b = first; b != NULL; b = b->next) {
+            if (inNamespace(b->name, prefix)) out[n++] = b;
         }
-        if (first == NULL) return false;
+        sort(out, out + n, branchBefore);
+        return n;
+    }
 
-        if (first->name == name) {
-            Branch* temp = first;
-            first = first->next;
-            delete temp;
-            return true;
+    int printBranches(ostream& out, string_view prefix = "") {
+        Branch** list;
+        int n = sorted(list, prefix);
+        for (int i = 0; i < n; i++) {
+            if (list[i] == active)
+                out << "  * " << list[i]->name << " (active)" << endl;
+            else
+                out << "    " << list[i]->name << endl;
         }
+        delete[] list;
+        return n;
+    }
 
-        Branch* curr = first;
-        while (curr->next != NULL) {
-            if (curr->next->name == name) {
-                Branch* temp = curr->next;
-                curr->next = curr->next->next;
-                delete temp;
-                return true;
+    int count() const { return branchCount; }
+};
+
+class GenerationQueue {
+public:
+    CommitGraph* graph;
+    int* heap;
+    int size;
+    int capacity;
+
+    GenerationQueue(CommitGraph* g) : graph(g), heap(NULL), size(0), capacity(0) {}
+
+    ~GenerationQueue() { delete[] heap; }
+
+    bool before(int a, int b) const {
+        int ga = graph->generations[a], gb = graph->generations[b];
+        return ga > gb || (ga == gb && a > b);
+    }
+
+    void push(int node) {
+        if (size == capacity) heap = growArray(heap, size, capacity);
+        int i = size++;
+        while (i > 0 && before(node, heap[(i - 1) / 2])) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = node;
+    }
+
+    int pop() {
+        int top = heap[0];
+        int last = heap[--size];
+        int i = 0;
+        while (true) {
+            int child = i * 2 + 1;
+            if (child >= size) break;
+            if (child + 1 < size && before(heap[child + 1], heap[child])) child++;
+            if (!before(heap[child], last)) break;
+            heap[i] = heap[child];
+            i = child;
+        }
+        if (size > 0) heap[i] = last;
+        return top;
+    }
+
+    bool isEmpty() const { return size == 0; }
+
+private:
+    GenerationQueue(const GenerationQueue&);
+    GenerationQueue& operator=(const GenerationQueue&);
+};
+
+class NodeSet {
+private:
+    int* slots;
+    int size;
+    int count;
+
+    NodeSet(const NodeSet&);
+    NodeSet& operator=(const NodeSet&);
+
+    void place(int node) {
+        int mask = size - 1;
+        int i = (int)(((unsigned)node * 2654435761u) & mask);
+        while (slots[i] >= 0) i = (i + 1) & mask;
+        slots[i] = node;
+    }
+
+public:
+    NodeSet() : slots(NULL), size(0), count(0) {}
+
+    ~NodeSet() { delete[] slots; }
+
+    bool insert(int node) {
+        if ((count + 1) * 2 > size) {
+            int* old = slots;
+            int oldSize = size;
+            size = (size > 0) ? size * 2 : 16;
+            slots = new int[size];
+            for (int i = 0; i < size; i++) slots[i] = -1;
+            for (int i = 0; i < oldSize; i++) {
+                if (old[i] >= 0) place(old[i]);
             }
-            curr = curr->next;
+            delete[] old;
         }
-        return false;
+        int mask = size - 1;
+        int i = (int)(((unsigned)node * 2654435761u) & mask);
+        while (slots[i] >= 0) {
+            if (slots[i] == node) return false;
+            i = (i + 1) & mask;
+        }
+        slots[i] = node;
+        count++;
+        return true;
     }
+};
 
-    void printBranches() {
-        Branch* curr = first;
-        while (curr != NULL) {
-            if (curr == active)
-                cout << "  * " << curr->name << " (active)" << endl;
-            else
-                cout << "    " << curr->name << endl;
-            curr = curr->next;
+class HistoryIterator {
+public:
+    GenerationQueue queue;
+    NodeSet seen;
+
+    HistoryIterator(Commit* start) : queue(start != NULL ? start->graph : sharedCommitGraph()) {
+        if (start != NULL) visit(start->node);
+    }
+
+    void visit(int node) {
+        if (seen.insert(node)) queue.push(node);
+    }
+
+    Commit* next() {
+        while (!queue.isEmpty()) {
+            int node = queue.pop();
+            CommitGraph* g = queue.graph;
+            for (int i = 0; i < g->parentCounts[node]; i++) visit(g->parent(node, i));
+            if (g->commits[node] != NULL) return g->commits[node];
         }
+        return NULL;
     }
 
-    int count() {
-        int c = 0;
-        Branch* curr = first;
-        while (curr != NULL) {
-            c++;
-            curr = curr->next;
+    bool allBefore(time_t cutoff) const {
+        for (int i = 0; i < queue.size; i++) {
+            Commit* c = queue.graph->commits[queue.heap[i]];
+            if (c != NULL && c->time >= cutoff) return false;
         }
-        return c;
+        return true;
     }
+
+private:
+    HistoryIterator(const HistoryIterator&);
+    HistoryIterator& operator=(const HistoryIterator&);
 };
 
-void printHistory(Commit* node) {
-    if (node == NULL) return;
-    cout << "  commit " << node->commitId << endl;
-    cout << "  Date:   " << node->timestamp << endl;
-    cout << "  Msg:    " << node->message << endl;
-    cout << "  Files:  " << node->snapshot.fileCount << endl;
-    cout << endl;
-    printHistory(node->parent);
-}
+class LogOptions {
+public:
+    int maxCount;
+    int skip;
+    time_t since;
+    string path;
 
-int countCommits(Commit* node) {
-    if (node == NULL) return 0;
-    return 1 + countCommits(node->parent);
-}
+    LogOptions() : maxCount(-1), skip(0), since(0) {}
+};
 
-Commit* findCommit(Commit* root, string id) {
-    if (root == NULL) return NULL;
-    if (root->commitId == id) return root;
+int countCommits(Commit* node) { return node != NULL ? node->generation() : 0; }
 
-    for (int i = 0; i < root->childCount; i++) {
-        Commit* result = findCommit(root->children[i], id);
-        if (result != NULL) return result;
+Commit* findCommit(Commit* root, const ObjectId& id) {
+    if (root == NULL) return NULL;
+    CommitGraph* g = root->graph;
+    unsigned char* seen = new unsigned char[g->nodeCount]();
+    int top = 0, capacity = 16;
+    int* stack = new int[capacity];
+    stack[top++] = root->node;
+    seen[root->node] = 1;
+    Commit* result = NULL;
+    while (top > 0 && result == NULL) {
+        int node = stack[--top];
+        if (g->commits[node]->commitId == id) {
+            result = g->commits[node];
+            break;
+        }
+        for (int e = g->childHead[node]; e != -1; e = g->childNext[e]) {
+            int child = g->childArena[e];
+            if (seen[child]) continue;
+            seen[child] = 1;
+            if (top == capacity) stack = growArray(stack, top, capacity);
+            stack[top++] = child;
+        }
     }
-    return NULL;
+    delete[] stack;
+    delete[] seen;
+    return result;
 }
 
-Commit* findInHistory(Commit* node, string id) {
-    if (node == NULL) return NULL;
-    if (node->commitId == id) return node;
-    return findInHistory(node->parent, id);
+Commit* findInHistory(Commit* node, const ObjectId& id) {
+    HistoryIterator it(node);
+    for (Commit* c = it.next(); c != NULL; c = it.next()) {
+        if (c->commitId == id) return c;
+    }
+    return NULL;
 }
 
 #endif
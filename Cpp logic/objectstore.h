@@ -0,0 +1,880 @@
+#ifndef OBJECTSTORE_H
+#define OBJECTSTORE_H
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "minigit.h"
+#include "delta.h"
+#include "tree.h"
+#include "pool.h"
+using namespace std;
+
+const int OBJ_BLOB = KIND_BLOB;
+const int OBJ_COMMIT = KIND_COMMIT;
+const int OBJ_DELTA = KIND_DELTA;
+const int OBJ_TREE = KIND_TREE;
+const int OBJ_CHUNKS = KIND_CHUNKS;
+
+const u32 COMMIT_TREE_MARKER = 0xffffffff;
+
+const int MAX_DELTA_DEPTH = 10;
+const size_t MIN_DELTA_SIZE = 64;
+
+const int PACK_HEADER_SIZE = 8;
+const int RECORD_HEADER_SIZE = 37;
+const int IDX_HEADER_SIZE = 16;
+const int IDX_ENTRY_SIZE = 28;
+const size_t MIN_MAPPING_SIZE = 1024 * 1024;
+
+void putU32(string& out, u32 v) {
+    for (int i = 0; i < 4; i++) out += (char)((v >> (i * 8)) & 0xff);
+}
+
+void putU64(string& out, u64 v) {
+    for (int i = 0; i < 8; i++) out += (char)((v >> (i * 8)) & 0xff);
+}
+
+void putBytes(string& out, string_view data) {
+    putU32(out, (u32)data.length());
+    out.append(data.data(), data.length());
+}
+
+void putId(string& out, const ObjectId& id) { out.append((const char*)id.bytes, ID_BYTES); }
+
+constexpr void storeU64(unsigned char* p, u64 v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)((v >> (i * 8)) & 0xff);
+}
+
+constexpr void encodeRecordHeader(unsigned char* out, int type, const ObjectId& id, u64 fast, u64 size) {
+    out[0] = (unsigned char)type;
+    for (int i = 0; i < ID_BYTES; i++) out[1 + i] = id.bytes[i];
+    storeU64(out + 1 + ID_BYTES, fast);
+    storeU64(out + 9 + ID_BYTES, size);
+}
+
+u64 readU64(const unsigned char* p) {
+    u64 v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+u32 readU32(const unsigned char* p) {
+    u32 v = 0;
+    for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+class RecordReader {
+public:
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok;
+
+    RecordReader(const char* data, u64 size)
+        : p((const unsigned char*)data), end((const unsigned char*)data + size), ok(true) {}
+
+    bool need(u64 n) {
+        if (!ok || (u64)(end - p) < n) ok = false;
+        return ok;
+    }
+
+    u32 u32v() {
+        if (!need(4)) return 0;
+        u32 v = readU32(p);
+        p += 4;
+        return v;
+    }
+
+    u64 u64v() {
+        if (!need(8)) return 0;
+        u64 v = readU64(p);
+        p += 8;
+        return v;
+    }
+
+    ObjectId id() {
+        if (!need(ID_BYTES)) return ObjectId();
+        ObjectId v = ObjectId::fromRaw(p);
+        p += ID_BYTES;
+        return v;
+    }
+
+    string_view bytes() {
+        u32 len = u32v();
+        if (!need(len)) return string_view();
+        string_view v((const char*)p, len);
+        p += len;
+        return v;
+    }
+};
+
+class PackMapping {
+public:
+    char* base;
+    size_t size;
+    PackMapping* next;
+
+    PackMapping(char* b, size_t s, PackMapping* n) : base(b), size(s), next(n) {}
+};
+
+class PendingEntry {
+public:
+    unsigned char id[20];
+    u64 offset;
+    bool used;
+
+    PendingEntry() : offset(0), used(false) {}
+};
+
+class ObjectStore {
+private:
+    string dir;
+    int packFd;
+    u64 packSize;
+    PackMapping* mappings;
+
+    char* idxBase;
+    size_t idxSize;
+    u32 idxCount;
+
+    PendingEntry* pending;
+    int pendingSize;
+    int pendingCount;
+    mutex lock;
+
+    ObjectStore(const ObjectStore&);
+    ObjectStore& operator=(const ObjectStore&);
+
+    string path(const string& name) { return dir + "/" + name; }
+
+    static int compareEntries(const void* a, const void* b) {
+        return memcmp(a, b, 20);
+    }
+
+    static bool writeAll(int fd, const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = ::write(fd, data, len);
+            if (n <= 0) return false;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static bool readAll(int fd, char* data, size_t len, u64 offset) {
+        while (len > 0) {
+            ssize_t n = pread(fd, data, len, offset);
+            if (n <= 0) return false;
+            data += n;
+            len -= n;
+            offset += n;
+        }
+        return true;
+    }
+
+    void addPending(const unsigned char* id, u64 offset) {
+        if ((pendingCount + 1) * 2 > pendingSize) {
+            PendingEntry* old = pending;
+            int oldSize = pendingSize;
+            pendingSize = (pendingSize == 0) ? 64 : pendingSize * 2;
+            pending = new PendingEntry[pendingSize];
+            pendingCount = 0;
+            for (int i = 0; i < oldSize; i++) {
+                if (old[i].used) addPending(old[i].id, old[i].offset);
+            }
+            delete[] old;
+        }
+        int mask = pendingSize - 1;
+        int i = (int)(readU64(id) & mask);
+        while (pending[i].used) i = (i + 1) & mask;
+        memcpy(pending[i].id, id, 20);
+        pending[i].offset = offset;
+        pending[i].used = true;
+        pendingCount++;
+    }
+
+    bool findPending(const unsigned char* id, u64& offset) {
+        if (pendingSize == 0) return false;
+        int mask = pendingSize - 1;
+        for (int i = (int)(readU64(id) & mask); pending[i].used; i = (i + 1) & mask) {
+            if (memcmp(pending[i].id, id, 20) == 0) {
+                offset = pending[i].offset;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool findIndexed(const unsigned char* id, u64& offset) {
+        const unsigned char* entries = (const unsigned char*)idxBase + IDX_HEADER_SIZE;
+        u32 lo = 0, hi = idxCount;
+        while (lo < hi) {
+            u32 mid = (lo + hi) / 2;
+            int cmp = memcmp(entries + (size_t)mid * IDX_ENTRY_SIZE, id, 20);
+            if (cmp == 0) {
+                offset = readU64(entries + (size_t)mid * IDX_ENTRY_SIZE + 20);
+                return true;
+            }
+            if (cmp < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return false;
+    }
+
+    const char* mapRange(u64 offset, u64 len) {
+        if (offset + len > packSize) return NULL;
+        if (mappings == NULL || offset + len > mappings->size) {
+            size_t size = mappings != NULL ? mappings->size : MIN_MAPPING_SIZE;
+            while (size < packSize) size *= 2;
+            void* grown = mappings != NULL ? mremap(mappings->base, mappings->size, size, 0) : MAP_FAILED;
+            if (grown != MAP_FAILED) {
+                mappings->size = size;
+            } else {
+                void* base = mmap(NULL, size, PROT_READ, MAP_SHARED, packFd, 0);
+                if (base == MAP_FAILED) return NULL;
+                mappings = new PackMapping((char*)base, size, mappings);
+            }
+        }
+        return mappings->base + offset;
+    }
+
+    void unmapAll(PackMapping*& list) {
+        while (list != NULL) {
+            PackMapping* temp = list;
+            list = list->next;
+            munmap(temp->base, temp->size);
+            delete temp;
+        }
+    }
+
+    void openIndex() {
+        int fd = ::open(path("objects.idx").c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= IDX_HEADER_SIZE) {
+            void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (base != MAP_FAILED) {
+                const unsigned char* h = (const unsigned char*)base;
+                u32 count = readU32(h + 4);
+                if (memcmp(h, "MGIX", 4) == 0 &&
+                    (u64)st.st_size >= IDX_HEADER_SIZE + (u64)count * IDX_ENTRY_SIZE &&
+                    readU64(h + 8) <= packSize) {
+                    idxBase = (char*)base;
+                    idxSize = st.st_size;
+                    idxCount = count;
+                } else {
+                    munmap(base, st.st_size);
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    void recoverTail() {
+        u64 offset = (idxBase != NULL) ? readU64((const unsigned char*)idxBase + 8) : PACK_HEADER_SIZE;
+        unsigned char header[RECORD_HEADER_SIZE];
+        while (offset + RECORD_HEADER_SIZE <= packSize) {
+            if (!readAll(packFd, (char*)header, RECORD_HEADER_SIZE, offset)) break;
+            u64 size = readU64(header + 29);
+            if (offset + RECORD_HEADER_SIZE + size > packSize) break;
+            u64 known;
+            if (!findIndexed(header + 1, known)) addPending(header + 1, offset);
+            offset += RECORD_HEADER_SIZE + size;
+        }
+        if (offset < packSize) {
+            if (ftruncate(packFd, offset) == 0) packSize = offset;
+        }
+    }
+
+    bool locate(const ObjectId& id, u64& offset) {
+        if (findPending(id.bytes, offset)) return true;
+        return idxBase != NULL && findIndexed(id.bytes, offset);
+    }
+
+    bool readRecord(const ObjectId& id, int& type, u64& fast, const char*& data, u64& size) {
+        u64 offset;
+        if (!isOpen() || !locate(id, offset)) return false;
+        const char* header = mapRange(offset, RECORD_HEADER_SIZE);
+        if (header == NULL) return false;
+        const unsigned char* h = (const unsigned char*)header;
+        type = h[0];
+        fast = readU64(h + 21);
+        size = readU64(h + 29);
+        data = mapRange(offset + RECORD_HEADER_SIZE, size);
+        return data != NULL;
+    }
+
+    bool writeIndex() {
+        if (!isOpen() || pendingCount == 0) return true;
+        int total = (int)idxCount + pendingCount;
+        unsigned char* merged = new unsigned char[(size_t)total * IDX_ENTRY_SIZE];
+        int n = 0;
+        const unsigned char* entries = (const unsigned char*)idxBase + IDX_HEADER_SIZE;
+        for (u32 i = 0; i < idxCount; i++) {
+            memcpy(merged + (size_t)n++ * IDX_ENTRY_SIZE, entries + (size_t)i * IDX_ENTRY_SIZE, IDX_ENTRY_SIZE);
+        }
+        int sortedEnd = n;
+        for (int i = 0; i < pendingSize; i++) {
+            if (!pending[i].used) continue;
+            unsigned char* entry = merged + (size_t)n++ * IDX_ENTRY_SIZE;
+            memcpy(entry, pending[i].id, 20);
+            for (int b = 0; b < 8; b++) entry[20 + b] = (unsigned char)((pending[i].offset >> (b * 8)) & 0xff);
+        }
+        qsort(merged + (size_t)sortedEnd * IDX_ENTRY_SIZE, n - sortedEnd, IDX_ENTRY_SIZE, compareEntries);
+
+        string out = "MGIX";
+        putU32(out, (u32)total);
+        putU64(out, packSize);
+        out.reserve(IDX_HEADER_SIZE + (size_t)total * IDX_ENTRY_SIZE);
+        int a = 0, b = sortedEnd;
+        while (a < sortedEnd || b < n) {
+            const unsigned char* pick;
+            if (b >= n || (a < sortedEnd && memcmp(merged + (size_t)a * IDX_ENTRY_SIZE, merged + (size_t)b * IDX_ENTRY_SIZE, 20) < 0))
+                pick = merged + (size_t)a++ * IDX_ENTRY_SIZE;
+            else
+                pick = merged + (size_t)b++ * IDX_ENTRY_SIZE;
+            out.append((const char*)pick, IDX_ENTRY_SIZE);
+        }
+        delete[] merged;
+
+        if (!writeFile("objects.idx", out)) return false;
+        if (idxBase != NULL) munmap(idxBase, idxSize);
+        idxBase = NULL;
+        idxCount = 0;
+        delete[] pending;
+        pending = NULL;
+        pendingSize = 0;
+        pendingCount = 0;
+        openIndex();
+        return true;
+    }
+
+
+public:
+    ObjectStore()
+        : packFd(-1), packSize(0), mappings(NULL), idxBase(NULL), idxSize(0), idxCount(0),
+          pending(NULL), pendingSize(0), pendingCount(0) {}
+
+    ~ObjectStore() { close(); }
+
+    bool isOpen() { return packFd >= 0; }
+
+    int objectCount() {
+        lock_guard<mutex> guard(lock);
+        return (int)idxCount + pendingCount;
+    }
+
+    u64 packBytes() {
+        lock_guard<mutex> guard(lock);
+        return packSize;
+    }
+
+    bool maps(const char* data) {
+        lock_guard<mutex> guard(lock);
+        for (PackMapping* m = mappings; m != NULL; m = m->next) {
+            if (data >= m->base && data < m->base + m->size) return true;
+        }
+        return false;
+    }
+
+    int mappingCount() {
+        lock_guard<mutex> guard(lock);
+        int n = 0;
+        for (PackMapping* m = mappings; m != NULL; m = m->next) n++;
+        return n;
+    }
+
+    void retireMappings(BlobStore& blobs) {
+        lock_guard<mutex> guard(lock);
+        if (mappings == NULL || mappings->next == NULL) return;
+        Blob** all;
+        int n = blobs.collect(all);
+        for (int i = 0; i < n; i++) {
+            const char* data = all[i]->mappedData();
+            if (data == NULL) continue;
+            for (PackMapping* m = mappings->next; m != NULL; m = m->next) {
+                if (data >= m->base && data < m->base + m->size) {
+                    all[i]->remap(mappings->base + (data - m->base));
+                    break;
+                }
+            }
+        }
+        delete[] all;
+        unmapAll(mappings->next);
+    }
+
+    bool sync() { return isOpen() && fdatasync(packFd) == 0; }
+
+    bool open(const string& directory) {
+        close();
+        lock_guard<mutex> guard(lock);
+        dir = directory;
+        mkdir(dir.c_str(), 0755);
+        packFd = ::open(path("objects.pack").c_str(), O_RDWR | O_CREAT, 0644);
+        if (packFd < 0) return false;
+
+        struct stat st;
+        fstat(packFd, &st);
+        packSize = st.st_size;
+        if (packSize < PACK_HEADER_SIZE) {
+            string header = "MGPK";
+            putU32(header, 1);
+            if (ftruncate(packFd, 0) != 0 || !writeAll(packFd, header.data(), header.length())) {
+                ::close(packFd);
+                packFd = -1;
+                return false;
+            }
+            packSize = PACK_HEADER_SIZE;
+        }
+
+        openIndex();
+        recoverTail();
+        lseek(packFd, packSize, SEEK_SET);
+        return true;
+    }
+
+    const string& directory() const { return dir; }
+
+    bool nextRecord(u64& offset, ObjectId& id) {
+        lock_guard<mutex> guard(lock);
+        if (offset + RECORD_HEADER_SIZE > packSize) return false;
+        const char* header = mapRange(offset, RECORD_HEADER_SIZE);
+        if (header == NULL) return false;
+        id = ObjectId::fromRaw((const unsigned char*)header + 1);
+        offset += RECORD_HEADER_SIZE + readU64((const unsigned char*)header + 29);
+        return true;
+    }
+
+    bool replacePack(const string& fromDir) {
+        if (!isOpen()) return false;
+        string from = fromDir + "/";
+        close();
+        bool ok = rename((from + "objects.pack").c_str(), path("objects.pack").c_str()) == 0;
+        if (ok && rename((from + "objects.idx").c_str(), path("objects.idx").c_str()) != 0)
+            unlink(path("objects.idx").c_str());
+        rmdir(fromDir.c_str());
+        return open(dir) && ok;
+    }
+
+    bool has(const ObjectId& id) {
+        lock_guard<mutex> guard(lock);
+        u64 offset;
+        return isOpen() && locate(id, offset);
+    }
+
+    bool read(const ObjectId& id, int& type, u64& fast, const char*& data, u64& size) {
+        lock_guard<mutex> guard(lock);
+        return readRecord(id, type, fast, data, size);
+    }
+
+    int deltaDepth(const ObjectId& id) {
+        lock_guard<mutex> guard(lock);
+        int type;
+        u64 fast, size;
+        const char* data;
+        if (!readRecord(id, type, fast, data, size) || type != OBJ_DELTA || size == 0) return 0;
+        return (unsigned char)data[0];
+    }
+
+    bool write(int type, const ObjectId& id, u64 fast, string_view data) {
+        lock_guard<mutex> guard(lock);
+        u64 offset;
+        if (!isOpen() || locate(id, offset)) return false;
+        unsigned char header[RECORD_HEADER_SIZE];
+        encodeRecordHeader(header, type, id, fast, data.length());
+        offset = packSize;
+        if (!writeAll(packFd, (const char*)header, RECORD_HEADER_SIZE) ||
+            !writeAll(packFd, data.data(), data.length())) {
+            if (ftruncate(packFd, offset) == 0) lseek(packFd, offset, SEEK_SET);
+            return false;
+        }
+        packSize += RECORD_HEADER_SIZE + data.length();
+        addPending(header + 1, offset);
+        return true;
+    }
+
+    bool flushIndex() {
+        lock_guard<mutex> guard(lock);
+        return writeIndex();
+    }
+
+    bool syncDirectory() {
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) return false;
+        bool ok = fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+
+    bool writeFile(const string& name, const string& text) {
+        string tmp = path(name + ".tmp");
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        bool ok = writeAll(fd, text.data(), text.length()) && fsync(fd) == 0;
+        ::close(fd);
+        return ok && rename(tmp.c_str(), path(name).c_str()) == 0 && syncDirectory();
+    }
+
+    bool appendFile(const string& name, const string& text) {
+        bool created = false;
+        int fd = ::open(path(name).c_str(), O_WRONLY | O_APPEND);
+        if (fd < 0) {
+            fd = ::open(path(name).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            created = true;
+        }
+        if (fd < 0) return false;
+        bool ok = writeAll(fd, text.data(), text.length()) && fdatasync(fd) == 0;
+        ::close(fd);
+        return ok && (!created || syncDirectory());
+    }
+
+    bool readFile(const string& name, string& text) {
+        int fd = ::open(path(name).c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        fstat(fd, &st);
+        text.assign(st.st_size, '\0');
+        bool ok = readAll(fd, &text[0], st.st_size, 0);
+        ::close(fd);
+        return ok;
+    }
+
+    void close() {
+        lock_guard<mutex> guard(lock);
+        if (packFd < 0) return;
+        writeIndex();
+        unmapAll(mappings);
+        if (idxBase != NULL) munmap(idxBase, idxSize);
+        idxBase = NULL;
+        idxCount = 0;
+        delete[] pending;
+        pending = NULL;
+        pendingSize = 0;
+        pendingCount = 0;
+        ::close(packFd);
+        packFd = -1;
+    }
+
+    void destroy() {
+        if (packFd < 0) return;
+        close();
+        unlink(path("objects.pack").c_str());
+        unlink(path("objects.idx").c_str());
+        unlink(path("refs").c_str());
+        unlink(path("packed-refs").c_str());
+        unlink(path("HEAD").c_str());
+        unlink(path("commit-graph").c_str());
+        unlink(path("sparse-checkout").c_str());
+        rmdir(dir.c_str());
+    }
+};
+
+string encodeChunkList(Blob** chunks, int n, u64 size) {
+    string out;
+    putU64(out, size);
+    putU32(out, (u32)n);
+    for (int i = 0; i < n; i++) putId(out, chunks[i]->hash);
+    return out;
+}
+
+bool storeChunks(ObjectStore& store, Blob* blob) {
+    for (int i = 0; i < blob->chunkCount; i++) {
+        Blob* c = blob->chunks[i];
+        if (!store.has(c->hash) && !store.write(OBJ_BLOB, c->hash, c->fast, c->content())) return false;
+    }
+    return store.write(OBJ_CHUNKS, blob->hash, blob->fast, encodeChunkList(blob->chunks, blob->chunkCount, blob->size));
+}
+
+bool storeBlob(ObjectStore& store, Blob* blob, Blob* base) {
+    if (store.has(blob->hash)) return true;
+    if (blob->isChunked()) return storeChunks(store, blob);
+    if (base != NULL && base->isChunked()) base = NULL;
+    if (base != NULL && base != blob && blob->size >= MIN_DELTA_SIZE && store.has(base->hash)) {
+        int depth = store.deltaDepth(base->hash);
+        if (depth < MAX_DELTA_DEPTH) {
+            string delta = createDelta(base->content(), blob->content());
+            if (delta.length() + 21 < blob->size / 2) {
+                string payload(1, (char)(depth + 1));
+                putId(payload, base->hash);
+                payload += delta;
+                return store.write(OBJ_DELTA, blob->hash, blob->fast, payload);
+            }
+        }
+    }
+    return store.write(OBJ_BLOB, blob->hash, blob->fast, blob->content());
+}
+
+Blob* loadBlob(const ObjectId& id, ObjectStore& store, BlobStore& blobs);
+
+Blob* loadChunks(const ObjectId& id, u64 fast, const char* data, u64 size, ObjectStore& store, BlobStore& blobs) {
+    RecordReader in(data, size);
+    u64 total = in.u64v();
+    u32 n = in.u32v();
+    if (!in.need((u64)n * 20)) return NULL;
+    Blob** parts = new Blob*[n > 0 ? n : 1];
+    u64 joined = 0;
+    bool ok = true;
+    for (u32 i = 0; i < n && ok; i++) {
+        parts[i] = loadBlob(in.id(), store, blobs);
+        ok = parts[i] != NULL && !parts[i]->isChunked();
+        if (ok) joined += parts[i]->size;
+    }
+    Blob* blob = (ok && joined == total) ? blobs.adoptChunks(BlobId(id), fast, parts, (int)n, total) : NULL;
+    delete[] parts;
+    return blob;
+}
+
+Blob* loadBlob(const ObjectId& id, ObjectStore& store, BlobStore& blobs) {
+    Blob* blob = blobs.find(id);
+    if (blob != NULL) return blob;
+
+    int type;
+    u64 fast, size;
+    const char* data;
+    if (!store.read(id, type, fast, data, size)) return NULL;
+    if (type == OBJ_BLOB) return blobs.adopt(BlobId(id), fast, data, size);
+    if (type == OBJ_CHUNKS) return loadChunks(id, fast, data, size, store, blobs);
+    if (type != OBJ_DELTA || size < 21) return NULL;
+
+    Blob* base = loadBlob(ObjectId::fromRaw((const unsigned char*)data + 1), store, blobs);
+    u64 targetSize;
+    string_view delta(data + 21, size - 21);
+    if (base == NULL || !deltaTargetSize(delta, targetSize)) return NULL;
+    return blobs.adoptDelta(BlobId(id), fast, base, delta.data(), delta.length(), targetSize);
+}
+
+class BlobWrite {
+public:
+    Blob* blob;
+    Blob* base;
+    int depth;
+    string delta;
+
+    BlobWrite() : blob(NULL), base(NULL), depth(-1) {}
+};
+
+class BlobWriter : public TreeVisitor, public ParallelTask {
+public:
+    ObjectStore& store;
+    BlobWrite* writes;
+    int count;
+    int capacity;
+
+    BlobWriter(ObjectStore& s) : store(s), writes(NULL), count(0), capacity(0) {}
+
+    ~BlobWriter() { delete[] writes; }
+
+    void changed(const string& path, Blob* before, Blob* after) {
+        (void)path;
+        if (after == NULL || store.has(after->hash)) return;
+        if (count == capacity) writes = growArray(writes, count, capacity);
+        writes[count].blob = after;
+        writes[count].base = (after->isChunked() || (before != NULL && before->isChunked())) ? NULL : before;
+        writes[count].depth = -1;
+        count++;
+    }
+
+    void run(int i) {
+        BlobWrite& w = writes[i];
+        if (w.depth >= 0) w.delta = createDelta(w.base->content(), w.blob->content());
+    }
+
+    bool flush(WorkStealingPool& pool) {
+        for (int i = 0; i < count; i++) {
+            BlobWrite& w = writes[i];
+            if (w.blob->isChunked()) continue;
+            w.blob->content();
+            if (w.base == NULL || w.base == w.blob || w.blob->size < MIN_DELTA_SIZE || !store.has(w.base->hash)) continue;
+            int depth = store.deltaDepth(w.base->hash);
+            if (depth >= MAX_DELTA_DEPTH) continue;
+            w.base->content();
+            w.depth = depth;
+        }
+        pool.run(*this, count);
+        bool ok = true;
+        for (int i = 0; i < count; i++) {
+            BlobWrite& w = writes[i];
+            if (store.has(w.blob->hash)) continue;
+            if (w.blob->isChunked()) {
+                if (!storeChunks(store, w.blob)) ok = false;
+            } else if (w.depth >= 0 && w.delta.length() + 21 < w.blob->size / 2) {
+                string payload(1, (char)(w.depth + 1));
+                putId(payload, w.base->hash);
+                payload += w.delta;
+                if (!store.write(OBJ_DELTA, w.blob->hash, w.blob->fast, payload)) ok = false;
+            } else if (!store.write(OBJ_BLOB, w.blob->hash, w.blob->fast, w.blob->content())) {
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+private:
+    BlobWriter(const BlobWriter&);
+    BlobWriter& operator=(const BlobWriter&);
+};
+
+string encodeTree(Tree* t) {
+    string out;
+    putU32(out, (u32)t->count);
+    for (int i = 0; i < t->count; i++) {
+        TreeEntry& e = t->entries[i];
+        out += (char)(e.tree != NULL ? TREE_ENTRY_TREE : TREE_ENTRY_BLOB);
+        putBytes(out, e.name);
+        if (e.tree != NULL) putId(out, e.tree->hash);
+        else putId(out, e.blob->hash);
+    }
+    return out;
+}
+
+bool storeTree(ObjectStore& store, Tree* t) {
+    if (store.has(t->hash)) return true;
+    for (int i = 0; i < t->count; i++) {
+        TreeEntry& e = t->entries[i];
+        if (e.tree != NULL && !storeTree(store, e.tree)) return false;
+        if (e.tree == NULL && !store.has(e.blob->hash) && !storeBlob(store, e.blob, NULL)) return false;
+    }
+    return store.write(OBJ_TREE, t->hash, fastHash(string_view((const char*)t->hash.bytes, ID_BYTES)), encodeTree(t));
+}
+
+Tree* loadTree(const ObjectId& id, ObjectStore& store, BlobStore& blobs, TreeStore& trees) {
+    Tree* existing = trees.find(id);
+    if (existing != NULL) return existing;
+
+    int type;
+    u64 fast, size;
+    const char* data;
+    if (!store.read(id, type, fast, data, size) || type != OBJ_TREE) return NULL;
+    RecordReader in(data, size);
+    u32 count = in.u32v();
+    if (!in.ok || count > size) return NULL;
+
+    TreeEntry* entries = new TreeEntry[count > 0 ? count : 1];
+    for (u32 i = 0; i < count && in.ok; i++) {
+        int kind = in.need(1) ? *in.p++ : 0;
+        string_view name = in.bytes();
+        ObjectId childId = in.id();
+        if (!in.ok) break;
+        entries[i].name = blobs.internName(name, fastHash(name));
+        if (kind == TREE_ENTRY_TREE) entries[i].tree = loadTree(childId, store, blobs, trees);
+        else entries[i].blob = loadBlob(childId, store, blobs);
+        if (entries[i].tree == NULL && entries[i].blob == NULL) in.ok = false;
+    }
+    Tree* t = in.ok ? trees.intern(entries, (int)count) : NULL;
+    delete[] entries;
+    return t;
+}
+
+void encodeCommit(Commit* c, string& out) {
+    out.clear();
+    out.reserve(40 + c->parentCount() * ID_BYTES + c->message.length());
+    putU64(out, (u64)c->time);
+    putU32(out, (u32)c->parentCount());
+    for (int i = 0; i < c->parentCount(); i++) putId(out, c->parent(i)->commitId);
+    putBytes(out, c->message);
+    if (c->tree != NULL) {
+        putU32(out, COMMIT_TREE_MARKER);
+        putId(out, c->tree->hash);
+    } else {
+        putU32(out, 0);
+    }
+}
+
+string encodeCommit(Commit* c) {
+    string out;
+    encodeCommit(c, out);
+    return out;
+}
+
+CommitId commitRecordId(string_view record) {
+    ObjectHasher hasher;
+    hasher.update("commit\0", 7);
+    hasher.update(record);
+    return CommitId(hasher.id());
+}
+
+bool verifyTreeRecord(const ObjectId& id, string_view record) {
+    RecordReader in(record.data(), record.length());
+    u32 count = in.u32v();
+    Sha1Hasher hasher;
+    hasher.update("tree\0", 5);
+    for (u32 i = 0; i < count && in.ok; i++) {
+        char kind = in.need(1) ? (char)*in.p++ : 0;
+        string_view name = in.bytes();
+        ObjectId child = in.id();
+        if (kind != TREE_ENTRY_BLOB && kind != TREE_ENTRY_TREE) in.ok = false;
+        hasher.update(&kind, 1);
+        hasher.update(name);
+        hasher.update("\0", 1);
+        hasher.updateHex(child);
+    }
+    return in.ok && in.p == in.end && hasher.id() == id;
+}
+
+bool verifyChunkRecord(const ObjectId& id, string_view record, ObjectStore& store, BlobStore& blobs) {
+    RecordReader in(record.data(), record.length());
+    u64 total = in.u64v();
+    u32 n = in.u32v();
+    if (!in.ok || !in.need((u64)n * ID_BYTES) || in.p + (u64)n * ID_BYTES != in.end) return false;
+    if (generateHash(record) != id) return false;
+    u64 joined = 0;
+    for (u32 i = 0; i < n; i++) {
+        Blob* part = loadBlob(in.id(), store, blobs);
+        if (part == NULL || part->isChunked()) return false;
+        joined += part->size;
+    }
+    return joined == total;
+}
+
+bool verifyRecord(int type, const ObjectId& id, string_view record, ObjectStore& store, BlobStore& blobs) {
+    if (type == OBJ_BLOB) return generateHash(record) == id;
+    if (type == OBJ_TREE) return verifyTreeRecord(id, record);
+    if (type == OBJ_CHUNKS) return verifyChunkRecord(id, record, store, blobs);
+    if (type == OBJ_COMMIT) return commitRecordId(record) == id;
+    return false;
+}
+
+Commit* decodeCommit(const CommitId& id, const char* data, u64 size, ObjectStore& store,
+                     BlobStore& blobs, string& parentIds, CommitGraph* graph = sharedCommitGraph(),
+                     CommitPool* pool = NULL, TreeStore* trees = NULL) {
+    RecordReader in(data, size);
+    time_t t = (time_t)in.u64v();
+    u32 parents = in.u32v();
+    parentIds = "";
+    for (u32 i = 0; i < parents && in.ok; i++) putId(parentIds, in.id());
+    string_view message = in.bytes();
+    u32 count = in.u32v();
+    if (!in.ok) return NULL;
+
+    if (trees == NULL) return NULL;
+    Tree* root = NULL;
+    if (count == COMMIT_TREE_MARKER) {
+        ObjectId treeId = in.id();
+        if (in.ok) root = loadTree(treeId, store, blobs, *trees);
+    } else {
+        ChangeList files;
+        for (u32 i = 0; i < count && in.ok; i++) {
+            string_view name = in.bytes();
+            ObjectId blobId = in.id();
+            Blob* blob = in.ok ? loadBlob(blobId, store, blobs) : NULL;
+            if (blob == NULL) in.ok = false;
+            else files.push(name, blob);
+        }
+        if (in.ok) root = trees->update(NULL, files);
+    }
+    if (root == NULL) return NULL;
+
+    Commit* c = (pool != NULL) ? pool->create(id, string(message), graph) : new Commit(id, string(message), graph);
+    c->time = t;
+    formatTimestamp(t, c->timestamp);
+    c->tree = root;
+    return c;
+}
+
+#endif
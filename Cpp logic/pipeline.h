@@ -0,0 +1,188 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "minigit.h"
+#include "tree.h"
+#include "objectstore.h"
+#include "pool.h"
+using namespace std;
+
+class CommitJob {
+public:
+    CommitId id;
+    Tree* base;
+    Tree* tree;
+    string record;
+    string ref;
+    bool written;
+    CommitJob* next;
+
+    CommitJob(const CommitId& i, Tree* b, Tree* t, const string& r, const string& line)
+        : id(i), base(b), tree(t), record(r), ref(line), written(false), next(NULL) {}
+};
+
+class JobQueue {
+public:
+    CommitJob* head;
+    CommitJob* tail;
+    int count;
+
+    JobQueue() : head(NULL), tail(NULL), count(0) {}
+
+    void push(CommitJob* job) {
+        if (tail != NULL) tail->next = job;
+        else head = job;
+        tail = job;
+        count++;
+    }
+
+    CommitJob* takeAll(int& n) {
+        CommitJob* all = head;
+        n = count;
+        head = tail = NULL;
+        count = 0;
+        return all;
+    }
+};
+
+class CommitPipeline {
+private:
+    ObjectStore& store;
+    WorkStealingPool& pool;
+    mutex lock;
+    condition_variable writeReady;
+    condition_variable syncReady;
+    condition_variable settled;
+    JobQueue queued;
+    JobQueue written;
+    thread writer;
+    thread syncer;
+    bool started;
+    bool stopping;
+    bool writerDone;
+    long long submittedCount;
+    long long durableCount;
+    long long groupCount;
+    bool broken;
+
+    CommitPipeline(const CommitPipeline&);
+    CommitPipeline& operator=(const CommitPipeline&);
+
+    bool writeObjects(CommitJob* job) {
+        BlobWriter blobs(store);
+        diffTrees(job->base, job->tree, blobs);
+        if (!blobs.flush(pool) || !storeTree(store, job->tree)) return false;
+        return store.has(job->id) || store.write(OBJ_COMMIT, job->id, 0, job->record);
+    }
+
+    void writeLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            while (queued.head == NULL && !stopping) writeReady.wait(guard);
+            if (queued.head == NULL) break;
+            int n;
+            CommitJob* batch = queued.takeAll(n);
+            guard.unlock();
+            for (CommitJob* job = batch; job != NULL; job = job->next) job->written = writeObjects(job);
+            guard.lock();
+            for (CommitJob* job = batch; job != NULL;) {
+                CommitJob* next = job->next;
+                job->next = NULL;
+                written.push(job);
+                job = next;
+            }
+            syncReady.notify_one();
+        }
+        writerDone = true;
+        syncReady.notify_one();
+    }
+
+    void syncLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            while (written.head == NULL && !writerDone) syncReady.wait(guard);
+            if (written.head == NULL) break;
+            int n;
+            CommitJob* batch = written.takeAll(n);
+            bool ok = !broken;
+            guard.unlock();
+            string refs;
+            for (CommitJob* job = batch; job != NULL && ok; job = job->next) {
+                ok = job->written;
+                if (ok) refs += job->ref;
+            }
+            if (!store.sync()) ok = false;
+            if (!refs.empty() && (!ok || !store.appendFile("refs", refs))) ok = false;
+            while (batch != NULL) {
+                CommitJob* next = batch->next;
+                delete batch;
+                batch = next;
+            }
+            guard.lock();
+            if (!ok) broken = true;
+            durableCount += n;
+            groupCount++;
+            settled.notify_all();
+        }
+    }
+
+public:
+    CommitPipeline(ObjectStore& s, WorkStealingPool& p)
+        : store(s), pool(p), started(false), stopping(false), writerDone(false), submittedCount(0), durableCount(0),
+          groupCount(0), broken(false) {}
+
+    ~CommitPipeline() {
+        if (!started) return;
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        writeReady.notify_one();
+        writer.join();
+        syncer.join();
+    }
+
+    void submit(const CommitId& id, Tree* base, Tree* tree, const string& record, const string& ref) {
+        lock_guard<mutex> guard(lock);
+        if (!started) {
+            started = true;
+            writer = thread(&CommitPipeline::writeLoop, this);
+            syncer = thread(&CommitPipeline::syncLoop, this);
+        }
+        queued.push(new CommitJob(id, base, tree, record, ref));
+        submittedCount++;
+        writeReady.notify_one();
+    }
+
+    bool drain() {
+        unique_lock<mutex> guard(lock);
+        while (durableCount != submittedCount) settled.wait(guard);
+        return !broken;
+    }
+
+    long long submitted() {
+        lock_guard<mutex> guard(lock);
+        return submittedCount;
+    }
+
+    long long durable() {
+        lock_guard<mutex> guard(lock);
+        return durableCount;
+    }
+
+    long long groups() {
+        lock_guard<mutex> guard(lock);
+        return groupCount;
+    }
+
+    bool failed() {
+        lock_guard<mutex> guard(lock);
+        return broken;
+    }
+};
+
+#endif
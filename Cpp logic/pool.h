@@ -0,0 +1,101 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+using namespace std;
+
+class ParallelTask {
+public:
+    virtual ~ParallelTask() {}
+    virtual void run(int index) = 0;
+};
+
+class WorkRange {
+public:
+    mutex lock;
+    int begin;
+    int end;
+
+    WorkRange() : begin(0), end(0) {}
+
+    bool takeFront(int& index) {
+        lock_guard<mutex> guard(lock);
+        if (begin >= end) return false;
+        index = begin++;
+        return true;
+    }
+
+    bool stealHalf(int& from, int& to) {
+        lock_guard<mutex> guard(lock);
+        int left = end - begin;
+        if (left <= 0) return false;
+        int take = (left + 1) / 2;
+        from = end - take;
+        to = end;
+        end = from;
+        return true;
+    }
+
+    void refill(int from, int to) {
+        lock_guard<mutex> guard(lock);
+        begin = from;
+        end = to;
+    }
+};
+
+class WorkStealingPool {
+private:
+    void work(ParallelTask& task, WorkRange* ranges, int rangeCount, int self) {
+        int index;
+        while (true) {
+            while (ranges[self].takeFront(index)) task.run(index);
+            bool stole = false;
+            for (int k = 1; k < rangeCount && !stole; k++) {
+                int from, to;
+                if (ranges[(self + k) % rangeCount].stealHalf(from, to)) {
+                    ranges[self].refill(from, to);
+                    steals++;
+                    stole = true;
+                }
+            }
+            if (!stole) return;
+        }
+    }
+
+public:
+    int workers;
+    atomic<long long> steals;
+
+    WorkStealingPool(int threads = 0) : steals(0) {
+        workers = (threads > 0) ? threads : (int)thread::hardware_concurrency();
+        if (workers < 1) workers = 1;
+    }
+
+    int run(ParallelTask& task, int count) {
+        int active = (count < workers) ? count : workers;
+        if (active <= 1) {
+            for (int i = 0; i < count; i++) task.run(i);
+            return 1;
+        }
+        WorkRange* ranges = new WorkRange[active];
+        for (int w = 0; w < active; w++) {
+            ranges[w].begin = (int)((long long)count * w / active);
+            ranges[w].end = (int)((long long)count * (w + 1) / active);
+        }
+        thread* threads = new thread[active - 1];
+        for (int w = 1; w < active; w++) threads[w - 1] = thread(&WorkStealingPool::work, this, ref(task), ranges, active, w);
+        work(task, ranges, active, 0);
+        for (int w = 1; w < active; w++) threads[w - 1].join();
+        delete[] threads;
+        delete[] ranges;
+        return active;
+    }
+
+private:
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+};
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef REPOMANAGER_H
+#define REPOMANAGER_H
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <shared_mutex>
+#include "digest.h"
+using namespace std;
+
+template <typename Repo>
+class RepoSlot {
+public:
+    string name;
+    u64 nameHash;
+    Repo* repo;
+    shared_mutex lock;
+    atomic<int> refs;
+    RepoSlot* next;
+    RepoSlot* before;
+    RepoSlot* after;
+
+    RepoSlot(string_view n, u64 h, Repo* r)
+        : name(n), nameHash(h), repo(r), refs(1), next(NULL), before(NULL), after(NULL) {}
+
+    ~RepoSlot() { delete repo; }
+
+    void release() {
+        if (--refs == 0) delete this;
+    }
+};
+
+template <typename Repo>
+class RepoLease {
+private:
+    RepoSlot<Repo>* slot;
+    bool exclusive;
+
+    RepoLease(const RepoLease&);
+    RepoLease& operator=(const RepoLease&);
+
+public:
+    RepoLease(RepoSlot<Repo>* s, bool write, bool wait = true) : slot(s), exclusive(write) {
+        if (slot == NULL) return;
+        if (wait) {
+            if (exclusive) slot->lock.lock();
+            else slot->lock.lock_shared();
+        } else if (!(exclusive ? slot->lock.try_lock() : slot->lock.try_lock_shared())) {
+            slot->release();
+            slot = NULL;
+        }
+    }
+
+    ~RepoLease() {
+        if (slot == NULL) return;
+        if (exclusive) slot->lock.unlock();
+        else slot->lock.unlock_shared();
+        slot->release();
+    }
+
+    bool isValid() const { return slot != NULL; }
+    Repo* get() const { return slot != NULL ? slot->repo : NULL; }
+    Repo* operator->() const { return slot->repo; }
+    const string& name() const { return slot->name; }
+};
+
+template <typename Repo>
+class RepoManager {
+private:
+    RepoSlot<Repo>** buckets;
+    int bucketCount;
+    RepoSlot<Repo>* first;
+    RepoSlot<Repo>* last;
+    mutable shared_mutex tableLock;
+    int slotCount;
+
+    RepoSlot<Repo>* find(string_view name, u64 h) const {
+        for (RepoSlot<Repo>* s = buckets[h % bucketCount]; s != NULL; s = s->next) {
+            if (s->nameHash == h && s->name == name) return s;
+        }
+        return NULL;
+    }
+
+    void grow() {
+        RepoSlot<Repo>** old = buckets;
+        int oldCount = bucketCount;
+        bucketCount *= 2;
+        buckets = new RepoSlot<Repo>*[bucketCount]();
+        for (int i = 0; i < oldCount; i++) {
+            RepoSlot<Repo>* s = old[i];
+            while (s != NULL) {
+                RepoSlot<Repo>* next = s->next;
+                s->next = buckets[s->nameHash % bucketCount];
+                buckets[s->nameHash % bucketCount] = s;
+                s = next;
+            }
+        }
+        delete[] old;
+    }
+
+    RepoSlot<Repo>* acquire(string_view name) {
+        shared_lock<shared_mutex> guard(tableLock);
+        RepoSlot<Repo>* s = find(name, fastHash(name));
+        if (s != NULL) s->refs++;
+        return s;
+    }
+
+public:
+    RepoManager() : bucketCount(64), first(NULL), last(NULL), slotCount(0) {
+        buckets = new RepoSlot<Repo>*[bucketCount]();
+    }
+
+    ~RepoManager() {
+        RepoSlot<Repo>* s = first;
+        while (s != NULL) {
+            RepoSlot<Repo>* after = s->after;
+            s->release();
+            s = after;
+        }
+        delete[] buckets;
+    }
+
+    bool insert(string_view name, Repo* repo) {
+        unique_lock<shared_mutex> guard(tableLock);
+        u64 h = fastHash(name);
+        if (find(name, h) != NULL) return false;
+        RepoSlot<Repo>* s = new RepoSlot<Repo>(name, h, repo);
+        s->next = buckets[h % bucketCount];
+        buckets[h % bucketCount] = s;
+        s->before = last;
+        if (last != NULL) last->after = s;
+        else first = s;
+        last = s;
+        if (++slotCount > bucketCount) grow();
+        return true;
+    }
+
+    RepoLease<Repo> open(string_view name, bool exclusive) { return RepoLease<Repo>(acquire(name), exclusive); }
+
+    RepoLease<Repo> read(string_view name) { return open(name, false); }
+
+    RepoLease<Repo> write(string_view name) { return open(name, true); }
+
+    RepoLease<Repo> tryRead(string_view name) { return RepoLease<Repo>(acquire(name), false, false); }
+
+    RepoLease<Repo> detach(string_view name) {
+        RepoSlot<Repo>* s;
+        {
+            unique_lock<shared_mutex> guard(tableLock);
+            u64 h = fastHash(name);
+            s = find(name, h);
+            if (s != NULL) {
+                RepoSlot<Repo>** link = &buckets[h % bucketCount];
+                while (*link != s) link = &(*link)->next;
+                *link = s->next;
+                if (s->before != NULL) s->before->after = s->after;
+                else first = s->after;
+                if (s->after != NULL) s->after->before = s->before;
+                else last = s->before;
+                slotCount--;
+            }
+        }
+        return RepoLease<Repo>(s, true);
+    }
+
+    bool contains(string_view name) const {
+        shared_lock<shared_mutex> guard(tableLock);
+        return find(name, fastHash(name)) != NULL;
+    }
+
+    int count() const {
+        shared_lock<shared_mutex> guard(tableLock);
+        return slotCount;
+    }
+
+    int names(string*& out) const {
+        shared_lock<shared_mutex> guard(tableLock);
+        out = new string[slotCount > 0 ? slotCount : 1];
+        int n = 0;
+        for (RepoSlot<Repo>* s = first; s != NULL; s = s->after) out[n++] = s->name;
+        return n;
+    }
+
+private:
+    RepoManager(const RepoManager&);
+    RepoManager& operator=(const RepoManager&);
+};
+
+#endif
@@ -0,0 +1,1263 @@
+#ifndef REPOSITORY_H
+#define REPOSITORY_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <dirent.h>
+#include "minigit.h"
+#include "objectstore.h"
+#include "diff.h"
+#include "merge.h"
+#include "status.h"
+#include "ingest.h"
+#include "chunker.h"
+#include "sparse.h"
+#include "repomanager.h"
+#include "journal.h"
+#include "gc.h"
+#include "commitgraph.h"
+#include "pipeline.h"
+#include "transfer.h"
+using namespace std;
+
+thread_local ostream* consoleStream = NULL;
+
+ostream& console() { return consoleStream != NULL ? *consoleStream : cout; }
+
+class ConsoleCapture {
+private:
+    ostream* saved;
+
+public:
+    ConsoleCapture(ostream& out) : saved(consoleStream) { consoleStream = &out; }
+
+    ~ConsoleCapture() { consoleStream = saved; }
+};
+
+
+const int LOOSE_REF_LIMIT = 64;
+
+class MiniGit {
+private:
+    ObjectStore  objects;
+    BlobStore    blobs;
+    TreeStore    trees;
+    CommitGraph  graph;
+    Arena        arena;
+    CommitPool   commitPool;
+    FileState    workingFiles;
+    FileState    stagingArea;
+    FileState    headFiles;
+    SparseSet    sparse;
+    BranchList   branches;
+    Journal      journal;
+    CommitIndex  commitIndex;
+    StatusIndex  statusIndex;
+    GarbageCollector collector;
+    WorkStealingPool pool;
+    mutex        statusLock;
+    Commit*      rootCommit;
+    Commit*      mergeHead;
+    bool         initialized;
+    string       savedHead;
+    int          looseRefs;
+    CommitPipeline pipeline;
+    ChangeList   stagedChanges;
+    PathKeys     pathKeys;
+    string       commitRecord;
+
+    void persist(Commit* c, Branch* b) {
+        collector.addRoot(c);
+        if (!objects.isOpen() || !initialized) return;
+        saveRefs();
+        Commit* p = c->parent();
+        pipeline.submit(c->commitId, p != NULL ? p->tree : NULL, c->tree, encodeCommit(c),
+                        b->name + " " + c->commitId.hex() + "\n");
+        if (++looseRefs > LOOSE_REF_LIMIT + branches.count()) packRefs();
+    }
+
+    Commit* intern(Commit* c) {
+        encodeCommit(c, commitRecord);
+        c->commitId = commitRecordId(commitRecord);
+        Commit* existing = commitIndex.find(c->commitId);
+        if (existing != NULL) {
+            commitPool.release(c);
+            return existing;
+        }
+        buildPathFilter(c, pathKeys);
+        commitIndex.add(c);
+        return c;
+    }
+
+    bool settle() {
+        bool ok = pipeline.drain();
+        objects.retireMappings(blobs);
+        return ok;
+    }
+
+    static string refValue(Branch* b) { return b->head != NULL ? b->head->commitId.hex() : "-"; }
+
+    void packRefs() {
+        if (!settle()) return;
+        Branch** list;
+        int n = branches.sorted(list);
+        string text = "# pack-refs with: sorted\n";
+        for (int i = 0; i < n; i++) text += refValue(list[i]) + " refs/heads/" + list[i]->name + "\n";
+        delete[] list;
+        if (objects.writeFile("packed-refs", text) && objects.writeFile("refs", "")) looseRefs = 0;
+    }
+
+    void saveRefs(Branch* changed = NULL) {
+        if (!objects.isOpen() || !initialized) return;
+        if (savedHead != branches.active->name) {
+            objects.writeFile("HEAD", "ref: refs/heads/" + branches.active->name + "\n");
+            savedHead = branches.active->name;
+        }
+        if (changed == NULL) return;
+        settle();
+        objects.appendFile("refs", changed->name + " " + refValue(changed) + "\n");
+        if (++looseRefs > LOOSE_REF_LIMIT + branches.count()) packRefs();
+    }
+
+    void applyRef(const string& name, const string& value) {
+        ObjectId id;
+        Commit* head = ObjectId::parse(value, id) ? loadHistory(CommitId(id)) : NULL;
+        Branch* b = branches.findBranch(name);
+        if (b != NULL) b->head = head;
+        else branches.addBranch(name, head);
+    }
+
+    void loadRefs(const string& packed, const string& loose, string& activeName) {
+        istringstream packedIn(packed);
+        string line, value, ref;
+        while (getline(packedIn, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            istringstream fields(line);
+            if (fields >> value >> ref && ref.compare(0, 11, "refs/heads/") == 0) applyRef(ref.substr(11), value);
+        }
+        istringstream looseIn(loose);
+        while (looseIn >> ref >> value) {
+            looseRefs++;
+            if (ref == "HEAD") activeName = value;
+            else applyRef(ref, value);
+        }
+    }
+
+    void writeCommitGraph() {
+        if (objects.isOpen()) objects.writeFile("commit-graph", encodeCommitGraph(commitIndex));
+    }
+
+    int loadPathFilters() {
+        string data;
+        if (objects.readFile("commit-graph", data)) loadCommitGraph(data, commitIndex);
+        int built = 0;
+        for (int i = 0; i < commitIndex.count; i++) {
+            Commit* c = commitIndex.at(i);
+            if (graph.hasBloom(c->node)) continue;
+            buildPathFilter(c);
+            built++;
+        }
+        if (built > 0) writeCommitGraph();
+        return built;
+    }
+
+    void viewHead(Commit* c) {
+        if (c == NULL) {
+            headFiles.clear();
+        } else if (!sparse.active()) {
+            listFiles(c->tree, headFiles);
+        } else {
+            FileState view(&blobs);
+            sparse.select(c->tree, view);
+            headFiles = view;
+        }
+    }
+
+    FileState sparseOnly(FileState& all) {
+        if (!sparse.active()) return all;
+        FileState view(&blobs);
+        sparse.filter(all, view);
+        return view;
+    }
+
+    Commit* loadHistory(const CommitId& headId) {
+        int pendingCount = 0, pendingCapacity = 16;
+        Commit** pending = new Commit*[pendingCapacity];
+        string* pendingParents = new string[pendingCapacity];
+        int top = 0, stackCapacity = 16;
+        CommitId* stack = new CommitId[stackCapacity];
+        stack[top++] = headId;
+        while (top > 0) {
+            CommitId id = stack[--top];
+            if (commitIndex.find(id) != NULL) continue;
+            int type;
+            u64 fast, size;
+            const char* data;
+            if (!objects.read(id, type, fast, data, size) || type != OBJ_COMMIT) continue;
+            string parentIds;
+            Commit* c = decodeCommit(id, data, size, objects, blobs, parentIds, &graph, &commitPool, &trees);
+            if (c == NULL) continue;
+            commitIndex.add(c);
+            if (pendingCount == pendingCapacity) {
+                pending = growArray(pending, pendingCount, pendingCapacity);
+                pendingParents = resizeArray(pendingParents, pendingCount, pendingCapacity);
+            }
+            pending[pendingCount] = c;
+            pendingParents[pendingCount++] = parentIds;
+            for (size_t i = 0; i + ID_BYTES <= parentIds.length(); i += ID_BYTES) {
+                if (top == stackCapacity) stack = growArray(stack, top, stackCapacity);
+                stack[top++] = CommitId(ObjectId::fromRaw((const unsigned char*)parentIds.data() + i));
+            }
+        }
+
+        for (int i = 0; i < pendingCount; i++) {
+            const string& parentIds = pendingParents[i];
+            for (size_t j = 0; j + ID_BYTES <= parentIds.length(); j += ID_BYTES) {
+                pending[i]->addParent(commitIndex.find(ObjectId::fromRaw((const unsigned char*)parentIds.data() + j)));
+            }
+            if (pending[i]->parentCount() == 0 && rootCommit == NULL) rootCommit = pending[i];
+        }
+        for (int i = 0; i < pendingCount; i++) graph.generations[pending[i]->node] = 0;
+        for (int i = 0; i < pendingCount; i++) graph.settleGeneration(pending[i]->node);
+
+        if (initialized) {
+            for (int i = 0; i < pendingCount; i++) buildPathFilter(pending[i]);
+        }
+
+        delete[] pending;
+        delete[] pendingParents;
+        delete[] stack;
+        return commitIndex.find(headId);
+    }
+
+    int collectHaves(IdSet& sent, CommitId* haves, int count) {
+        for (Branch* b = branches.first; b != NULL && count < (int)TRANSFER_MAX_HAVES; b = b->next) {
+            Commit* c = b->head;
+            for (int step = 1; c != NULL && count < (int)TRANSFER_MAX_HAVES && sent.insert(c->commitId); step *= 2) {
+                haves[count++] = c->commitId;
+                for (int i = 0; i < step && c != NULL; i++) c = c->parent();
+            }
+        }
+        return count;
+    }
+
+    bool receivePack(FdStream& io, u32& received) {
+        io.beginHash();
+        u32 count;
+        if (!io.expect("MGPK") || !io.readU32(count)) return false;
+        settle();
+        string data;
+        unsigned char header[RECORD_HEADER_SIZE];
+        for (received = 0; received < count; received++) {
+            if (!io.read((char*)header, RECORD_HEADER_SIZE)) return false;
+            int type = header[0];
+            ObjectId id = ObjectId::fromRaw(header + 1);
+            u64 fast = readU64(header + 21), size = readU64(header + 29);
+            if (size > TRANSFER_MAX_OBJECT || (type != OBJ_BLOB && type != OBJ_CHUNKS && type != OBJ_TREE && type != OBJ_COMMIT))
+                return false;
+            data.resize(size);
+            if (size > 0 && !io.read(&data[0], size)) return false;
+            if (!verifyRecord(type, id, data, objects, blobs)) return false;
+            if (!objects.has(id) && !objects.write(type, id, fast, data)) return false;
+        }
+        ObjectId expected = io.endHash(), trailer;
+        return io.readId(trailer) && trailer == expected && objects.sync();
+    }
+
+public:
+    MiniGit()
+        : trees(&blobs), commitPool(arena), workingFiles(&blobs), stagingArea(&blobs), headFiles(&blobs), branches(&arena), journal(&branches, &commitIndex),
+          collector(objects, blobs, trees, commitIndex, graph, commitPool), rootCommit(NULL), mergeHead(NULL), initialized(false), looseRefs(0),
+          pipeline(objects, pool) {
+        statusIndex.skipOutside(&sparse);
+    }
+
+    bool isInitialized() const { return initialized; }
+    Branch* activeBranch() const { return branches.active; }
+    BranchList& branchList() { return branches; }
+    FileState& working() { return workingFiles; }
+    FileState& staged() { return stagingArea; }
+    Journal& history() { return journal; }
+    CommitIndex& commits() { return commitIndex; }
+    const GarbageCollector& gcState() const { return collector; }
+
+    bool open(const string& dir) {
+        if (!objects.open(dir)) return false;
+        string packed, loose, head, activeName;
+        bool hasPacked = objects.readFile("packed-refs", packed);
+        if (!objects.readFile("refs", loose) && !hasPacked) return true;
+
+        loadRefs(packed, loose, activeName);
+        if (objects.readFile("HEAD", head) && head.compare(0, 16, "ref: refs/heads/") == 0) {
+            size_t end = head.find('\n');
+            activeName = head.substr(16, end == string::npos ? string::npos : end - 16);
+        }
+        if (branches.first == NULL) return true;
+        branches.switchBranch(activeName);
+        savedHead = branches.active->name;
+        initialized = true;
+        if (looseRefs > LOOSE_REF_LIMIT) packRefs();
+        loadPathFilters();
+        string patterns;
+        if (objects.readFile("sparse-checkout", patterns)) sparse.decode(patterns);
+        viewHead(branches.active->head);
+        workingFiles = headFiles;
+        statusIndex.invalidate();
+        return true;
+    }
+
+    void destroyStorage() {
+        pipeline.drain();
+        collector.abort();
+        objects.destroy();
+    }
+
+    bool init() {
+        if (initialized) {
+            console() << "  Repository already initialized." << endl;
+            return false;
+        }
+        branches.addBranch("main", NULL);
+        initialized = true;
+        saveRefs(branches.active);
+        console() << "  Initialized empty MiniGit repository." << endl;
+        console() << "  Branch: main (active)" << endl;
+        return true;
+    }
+
+    void touch(const string& filename) {
+        File* f = workingFiles.getFile(filename);
+        if (f == NULL) f = stagingArea.getFile(filename);
+        if (f != NULL) statusIndex.touch(f->name, f->nameHash);
+    }
+
+    Blob* internContent(string_view content) {
+        if (content.length() < CHUNK_THRESHOLD) return blobs.intern(content);
+        settle();
+        Chunker chunker(objects, blobs);
+        return chunker.fromMemory(content);
+    }
+
+    bool add(const string& filename, string_view content) {
+        if (!initialized) { console() << "  Error: repo not initialized. Run 'init' first." << endl; return false; }
+
+        Blob* blob = internContent(content);
+        stagingArea.putBlob(filename, blob);
+        workingFiles.putBlob(filename, blob);
+        touch(filename);
+
+        console() << "  Staged: " << filename << "  [hash: " << blob->hash << "]" << endl;
+        return true;
+    }
+
+    bool addPaths(const string* paths, int count) {
+        if (!initialized) { console() << "  Error: repo not initialized. Run 'init' first." << endl; return false; }
+
+        IngestBatch batch;
+        for (int i = 0; i < count; i++) {
+            if (!batch.collect(paths[i])) console() << "  Skipped: " << paths[i] << " (not a file or directory)" << endl;
+        }
+        int threads = batch.hashAll(pool);
+
+        Commit* head = branches.active->head;
+        Chunker chunker(objects, blobs);
+        int staged = 0, fresh = 0, unchanged = 0, large = 0;
+        for (int i = 0; i < batch.count; i++) {
+            IngestItem& item = batch.items[i];
+            int before = blobs.blobCount, chunksBefore = chunker.freshChunks;
+            Blob* blob = NULL;
+            if (item.large && !item.name.empty()) {
+                settle();
+                blob = chunker.fromFile(item.path);
+            }
+            else if (item.loaded && !item.name.empty()) blob = blobs.intern(item.content, item.hash, item.fast);
+            if (blob == NULL) {
+                console() << "  Skipped: " << item.path << " (unreadable)" << endl;
+                continue;
+            }
+            if (item.large) large++;
+            if (blobs.blobCount - (chunker.freshChunks - chunksBefore) > before) fresh++;
+            workingFiles.putBlob(item.name, blob);
+            touch(item.name);
+            Blob* tracked = (head != NULL) ? lookupPath(head->tree, item.name) : NULL;
+            if (tracked == blob && stagingArea.getFile(item.name) == NULL) {
+                unchanged++;
+                continue;
+            }
+            stagingArea.putBlob(item.name, blob);
+            staged++;
+        }
+        console() << "  Staged " << staged << " file(s), " << fresh << " new blob(s), " << unchanged << " unchanged; "
+                  << batch.bytes + chunker.hashedBytes << " byte(s) hashed on " << threads << " thread(s)." << endl;
+        if (large > 0)
+            console() << "  Chunked " << large << " large file(s): " << chunker.freshChunks << " new chunk(s), "
+                      << chunker.hashedBytes << " byte(s) stored." << endl;
+        return true;
+    }
+
+    bool stage(const string& filename) {
+        if (!initialized) { console() << "  Error: repo not initialized. Run 'init' first." << endl; return true; }
+        File* f = workingFiles.getFile(filename);
+        if (f == NULL) return false;
+        stagingArea.putBlob(filename, f->blob);
+        touch(filename);
+        console() << "  Staged: " << filename << "  [hash: " << f->blob->hash << "]" << endl;
+        return true;
+    }
+
+    bool write(const string& filename, string_view content) {
+        if (!initialized) { console() << "  Error: repo not initialized. Run 'init' first." << endl; return false; }
+
+        Blob* blob = internContent(content);
+        workingFiles.putBlob(filename, blob);
+        touch(filename);
+
+        console() << "  Wrote: " << filename << "  [hash: " << blob->hash << "]" << endl;
+        return true;
+    }
+
+    bool commit(const string& message) {
+        TRACE_SPAN(SPAN_COMMIT);
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        if (stagingArea.fileCount == 0) {
+            console() << "  Nothing to commit. Use 'add' first." << endl;
+            return false;
+        }
+
+        Branch* current = branches.active;
+
+        stagedChanges.clear();
+        for (File* f = stagingArea.first(); f != NULL; f = stagingArea.next(f)) stagedChanges.push(f->name, f->blob);
+        Tree* tree = trees.update(current->head != NULL ? current->head->tree : NULL, stagedChanges);
+        if (tree == NULL) {
+            console() << "  Error: '" << trees.conflict << "' would be both a file and a directory." << endl;
+            return false;
+        }
+
+        Commit* newCommit = commitPool.create(CommitId(), message, &graph);
+        newCommit->tree = tree;
+
+        newCommit->addParent(current->head);
+        if (mergeHead != NULL) {
+            newCommit->addParent(mergeHead);
+            mergeHead = NULL;
+        }
+        newCommit = intern(newCommit);
+
+        if (rootCommit == NULL) {
+            rootCommit = newCommit;
+        }
+
+        current->head = newCommit;
+
+        journal.record(OP_COMMIT, current, current, newCommit->parent(), newCommit);
+        persist(newCommit, current);
+
+        statusIndex.refresh(workingFiles, stagingArea, newCommit->parent() != NULL ? &headFiles : NULL);
+        bool clean = statusIndex.count(STATUS_MODIFIED | STATUS_DELETED | STATUS_UNTRACKED) == 0;
+        if (clean && !sparse.active()) headFiles = workingFiles;
+        else {
+            for (File* f = stagingArea.first(); f != NULL; f = stagingArea.next(f)) {
+                if (!sparse.active() || sparse.matches(f->name) || workingFiles.getFile(f->name) != NULL)
+                    headFiles.putBlob(f->name, f->blob);
+            }
+        }
+        if (clean) workingFiles = headFiles;
+        stagingArea.clear();
+        statusIndex.invalidate();
+
+        console() << "  [" << current->name << " " << commitIndex.abbreviate(newCommit->commitId) << "] " << message << endl;
+        console() << "  " << tree->fileCount << " file(s) committed." << endl;
+        return true;
+    }
+
+    bool log(const LogOptions& opts) {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        Branch* current = branches.active;
+        if (current->head == NULL) {
+            console() << "  No commits yet." << endl;
+            return false;
+        }
+        ostringstream out;
+        out << "  === Commit History (" << current->name;
+        if (!opts.path.empty()) out << " -- " << opts.path;
+        out << ") ===\n\n";
+        int shown = printHistory(current->head, out, opts);
+        out << "  Showing " << shown << " commit(s)";
+        if (!opts.path.empty()) out << " touching " << opts.path;
+        out << ", history depth " << current->head->generation() << "\n";
+        console() << out.str() << flush;
+        return true;
+    }
+
+    void printStatusGroup(const char* title, const int* order, int n, int mask) {
+        bool printed = false;
+        for (int i = 0; i < n; i++) {
+            StatusEntry& e = statusIndex.entries[order[i]];
+            if (!(e.flags & mask)) continue;
+            if (!printed) console() << "\n  " << title << endl;
+            printed = true;
+            const char* label = "";
+            int flags = e.flags & mask;
+            if (flags & STATUS_ADDED) label = "new file:  ";
+            else if (flags & STATUS_STAGED) label = "modified:  ";
+            else if (flags & STATUS_MODIFIED) label = "modified:  ";
+            else if (flags & STATUS_DELETED) label = "deleted:   ";
+            console() << "    " << label << e.name << endl;
+        }
+    }
+
+    bool status() {
+        TRACE_SPAN(SPAN_STATUS);
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        lock_guard<mutex> guard(statusLock);
+        console() << "  On branch: " << branches.active->name << endl;
+
+        Commit* head = branches.active->head;
+        statusIndex.refresh(workingFiles, stagingArea, head != NULL ? &headFiles : NULL);
+        int changed = 0;
+        for (int e = statusIndex.firstChanged; e >= 0; e = statusIndex.entries[e].next) changed++;
+        int* order = new int[changed > 0 ? changed : 1];
+        int n = 0;
+        for (int e = statusIndex.firstChanged; e >= 0; e = statusIndex.entries[e].next) {
+            int pos = n++;
+            while (pos > 0 && statusIndex.entries[order[pos - 1]].name > statusIndex.entries[e].name) {
+                order[pos] = order[pos - 1];
+                pos--;
+            }
+            order[pos] = e;
+        }
+
+        printStatusGroup("Changes to be committed:", order, n, STATUS_ADDED | STATUS_STAGED);
+        printStatusGroup("Changes not staged for commit:", order, n, STATUS_MODIFIED | STATUS_DELETED);
+        printStatusGroup("Untracked files:", order, n, STATUS_UNTRACKED);
+        delete[] order;
+
+        int tracked = workingFiles.fileCount - statusIndex.count(STATUS_UNTRACKED);
+        if (n == 0) console() << "\n  Nothing to commit, working tree clean (" << tracked << " file(s))." << endl;
+        console() << "\n  Status cache: " << statusIndex.reclassified << " re-check(s), " << tracked
+                  << " tracked file(s)" << endl;
+        if (sparse.active())
+            console() << "  Sparse:     " << sparse.count << " pattern(s), " << headFiles.fileCount << " of "
+                      << (head != NULL ? head->tree->fileCount : 0) << " committed file(s) checked out" << endl;
+        console() << "\n  Undo stack: " << journal.undoCount() << " operation(s)";
+        if (journal.spilled() > 0) console() << ", " << journal.spilled() << " spilled to disk";
+        console() << endl;
+        console() << "  Redo stack: " << journal.redoCount() << " operation(s)" << endl;
+        console() << "  Arena:      " << arena.objectCount << " object(s), " << arena.allocatedBytes << " of "
+                  << arena.reservedBytes << " byte(s) in " << arena.chunkCount << " chunk(s)" << endl;
+        console() << "  Blob store: " << blobs.blobCount << " unique blob(s), " << blobs.totalBytes << " byte(s)" << endl;
+        console() << "  Trees:      " << trees.treeCount << " unique tree(s)" << endl;
+        if (objects.isOpen() && pipeline.submitted() > 0)
+            console() << "  Durable:    " << pipeline.durable() << " of " << pipeline.submitted() << " commit(s) in "
+                      << pipeline.groups() << " fsync group(s)" << (pipeline.failed() ? ", write FAILED" : "") << endl;
+        if (objects.isOpen())
+            console() << "  Pack:       " << objects.objectCount() << " object(s), " << objects.packBytes() << " byte(s) on disk" << endl;
+        if (collector.running())
+            console() << "  GC:         running, " << collector.pending() << " object(s) left after " << collector.slices
+                      << " slice(s)" << endl;
+        return true;
+    }
+
+    bool branch(const string& name) {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        if (!validRefName(name)) {
+            console() << "  Invalid branch name: " << name << endl;
+            return false;
+        }
+        if (branches.findBranch(name) != NULL) {
+            console() << "  Branch '" << name << "' already exists." << endl;
+            return false;
+        }
+
+        Commit* head = branches.active->head;
+        Branch* created = branches.addBranch(name, head);
+        saveRefs(created);
+        console() << "  Created branch: " << name << endl;
+        return true;
+    }
+
+    bool checkout(const string& name) {
+        TRACE_SPAN(SPAN_CHECKOUT);
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        Branch* previous = branches.active;
+        if (branches.switchBranch(name)) {
+            console() << "  Switched to branch: " << name << endl;
+
+            Branch* b = branches.active;
+            if (b != previous) journal.record(OP_CHECKOUT, previous, b, previous->head, b->head);
+            viewHead(b->head);
+            workingFiles = headFiles;
+            if (b->head == NULL) console() << "  Branch has no commits yet." << endl;
+            else if (sparse.active())
+                console() << "  Restored " << workingFiles.fileCount << " of " << b->head->tree->fileCount
+                          << " file(s) (sparse checkout)." << endl;
+            else console() << "  Restored " << workingFiles.fileCount << " file(s)." << endl;
+            stagingArea.clear();
+            mergeHead = NULL;
+            statusIndex.invalidate();
+            saveRefs();
+            return true;
+        }
+        console() << "  Branch '" << name << "' not found." << endl;
+        return false;
+    }
+
+    bool setSparse(const string* patterns, int count, bool replace) {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        Commit* head = branches.active->head;
+        statusIndex.refresh(workingFiles, stagingArea, head != NULL ? &headFiles : NULL);
+        if (statusIndex.count(STATUS_MODIFIED | STATUS_DELETED | STATUS_UNTRACKED) > 0) {
+            console() << "  Error: working tree has unstaged changes. 'add' or 'commit' them first." << endl;
+            return false;
+        }
+        if (replace) sparse.clear();
+        for (int i = 0; i < count; i++) sparse.add(patterns[i]);
+        objects.writeFile("sparse-checkout", sparse.encode());
+
+        viewHead(head);
+        workingFiles = headFiles;
+        for (File* f = stagingArea.first(); f != NULL; f = stagingArea.next(f)) {
+            if (sparse.matches(f->name)) workingFiles.putBlob(f->name, f->blob);
+        }
+        statusIndex.invalidate();
+        int total = head != NULL ? head->tree->fileCount : 0;
+        if (sparse.active())
+            console() << "  Sparse checkout: " << sparse.count << " pattern(s); " << headFiles.fileCount << " of " << total
+                      << " file(s) checked out." << endl;
+        else
+            console() << "  Sparse checkout disabled; " << headFiles.fileCount << " file(s) checked out." << endl;
+        return true;
+    }
+
+    bool listSparse() {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        if (!sparse.active()) {
+            console() << "  Sparse checkout is off; every file is checked out." << endl;
+            return true;
+        }
+        console() << "  === Sparse Checkout ===" << endl;
+        for (int i = 0; i < sparse.count; i++) console() << "  " << sparse.at(i) << endl;
+        console() << "  Total: " << sparse.count << " pattern(s)" << endl;
+        return true;
+    }
+
+    bool listBranches(string_view prefix = "") {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        console() << "  === Branches ===" << endl;
+        int shown = branches.printBranches(console(), prefix);
+        if (prefix.empty()) console() << "  Total: " << shown << " branch(es)" << endl;
+        else console() << "  Total: " << shown << " of " << branches.count() << " branch(es) under " << prefix << endl;
+        return true;
+    }
+
+    bool merge(const string& branchName) {
+        TRACE_SPAN(SPAN_MERGE);
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        Branch* src = branches.findBranch(branchName);
+        if (src == NULL) { console() << "  Branch '" << branchName << "' not found." << endl; return false; }
+        if (src == branches.active) { console() << "  Cannot merge branch into itself." << endl; return false; }
+        if (src->head == NULL) { console() << "  Source branch has no commits." << endl; return false; }
+
+        Commit* ours = branches.active->head;
+        if (isAncestor(src->head, ours)) { console() << "  Already up to date." << endl; return true; }
+        Commit* base = mergeBase(ours, src->head);
+
+        TreeMerge tree(&blobs, &trees);
+        FileState oursFiles(&blobs);
+        listFiles(ours != NULL ? ours->tree : NULL, oursFiles);
+        tree.run(base != NULL ? base->tree : NULL, ours != NULL ? ours->tree : NULL, src->head->tree,
+                 oursFiles, branches.active->name, branchName);
+        if (base != NULL) console() << "  Merge base: " << commitIndex.abbreviate(base->commitId) << endl;
+        console() << tree.report.str();
+
+        if (tree.conflicts > 0) {
+            workingFiles = sparseOnly(tree.result);
+            stagingArea = tree.result;
+            statusIndex.invalidate();
+            mergeHead = src->head;
+            console() << "  Automatic merge failed: " << tree.conflicts << " conflict(s)." << endl;
+            console() << "  Fix the marked files, then 'add' and 'commit' the result." << endl;
+            return false;
+        }
+
+        string msg = "Merge branch '" + branchName + "' into " + branches.active->name;
+
+        Commit* mergeCommit = commitPool.create(CommitId(), msg, &graph);
+        mergeCommit->tree = tree.resultTree;
+
+        mergeCommit->addParent(ours);
+        mergeCommit->addParent(src->head);
+        mergeCommit = intern(mergeCommit);
+
+        if (rootCommit == NULL) rootCommit = mergeCommit;
+
+        branches.active->head = mergeCommit;
+        viewHead(mergeCommit);
+        workingFiles = headFiles;
+        stagingArea.clear();
+        statusIndex.invalidate();
+
+        journal.record(OP_MERGE, branches.active, branches.active, ours, mergeCommit);
+        persist(mergeCommit, branches.active);
+
+        console() << "  " << msg << endl;
+        console() << "  [" << commitIndex.abbreviate(mergeCommit->commitId) << "] " << mergeCommit->tree->fileCount << " file(s)" << endl;
+        return true;
+    }
+
+    void restoreWorking(Commit* c) {
+        viewHead(c);
+        workingFiles = headFiles;
+        mergeHead = NULL;
+        statusIndex.invalidate();
+    }
+
+    bool undo() {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        JournalEntry* e = journal.undo();
+        if (e == NULL) {
+            console() << "  Nothing to undo." << endl;
+            return false;
+        }
+
+        if (e->op == OP_CHECKOUT) {
+            branches.active = e->from;
+            restoreWorking(e->from->head);
+            stagingArea.clear();
+            console() << "  Undo: switched back to branch " << e->from->name << endl;
+        } else {
+            branches.active = e->to;
+            e->to->head = e->before;
+            restoreWorking(e->before);
+            if (e->before != NULL)
+                console() << "  Undo: reverted to commit " << e->before->commitId << endl;
+            else
+                console() << "  Undo: reverted to initial state (no commits)." << endl;
+        }
+        saveRefs(e->op == OP_CHECKOUT ? NULL : e->to);
+        return true;
+    }
+
+    bool redo() {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        JournalEntry* e = journal.redo();
+        if (e == NULL) {
+            console() << "  Nothing to redo." << endl;
+            return false;
+        }
+
+        branches.active = e->to;
+        if (e->op == OP_CHECKOUT) {
+            restoreWorking(e->to->head);
+            stagingArea.clear();
+            console() << "  Redo: switched to branch " << e->to->name << endl;
+        } else {
+            e->to->head = e->after;
+            restoreWorking(e->after);
+            console() << "  Redo: restored commit " << e->after->commitId << " — " << e->after->message << endl;
+        }
+        saveRefs(e->op == OP_CHECKOUT ? NULL : e->to);
+        return true;
+    }
+
+    bool revert(const string& commitId) {
+        TRACE_SPAN(SPAN_REVERT);
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        Branch* current = branches.active;
+        if (current->head == NULL) {
+            console() << "  No commits to revert." << endl;
+            return false;
+        }
+
+        bool ambiguous = false;
+        Commit* target = commitIndex.resolve(commitId, ambiguous);
+        if (ambiguous) {
+            console() << "  Commit ID '" << commitId << "' is ambiguous. Use more characters." << endl;
+            return false;
+        }
+        if (target == NULL) {
+            console() << "  Commit '" << commitId << "' not found." << endl;
+            return false;
+        }
+
+        viewHead(target);
+        workingFiles = headFiles;
+        listFiles(target->tree, stagingArea);
+        statusIndex.invalidate();
+
+        string msg = "Revert to " + commitIndex.abbreviate(target->commitId);
+
+        Commit* revertCommit = commitPool.create(CommitId(), msg, &graph);
+        revertCommit->tree = target->tree;
+        revertCommit->addParent(current->head);
+        revertCommit = intern(revertCommit);
+        journal.record(OP_REVERT, current, current, current->head, revertCommit);
+        current->head = revertCommit;
+
+        persist(revertCommit, current);
+
+        console() << "  Reverted to commit " << commitIndex.abbreviate(target->commitId) << endl;
+        console() << "  Created revert commit [" << commitIndex.abbreviate(revertCommit->commitId) << "]" << endl;
+        console() << "  " << workingFiles.fileCount << " file(s) restored." << endl;
+        return true;
+    }
+
+    bool diff(const string& filename, LineDiff* hunks = NULL) {
+        TRACE_SPAN(SPAN_DIFF);
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        Branch* current = branches.active;
+
+        File* workFile = workingFiles.getFile(filename);
+        if (workFile == NULL) {
+            console() << "  File '" << filename << "' not in working directory." << endl;
+            return false;
+        }
+
+        const BlobId& workHash = workFile->blob->hash;
+
+        if (current->head == NULL) {
+            console() << "  No commits to compare against." << endl;
+            console() << "  + " << filename << " [" << workHash << "] (new file)" << endl;
+            return true;
+        }
+
+        Blob* commitBlob = lookupPath(current->head->tree, filename);
+        if (commitBlob == NULL) {
+            console() << "  + " << filename << " (new — not in last commit)" << endl;
+            return true;
+        }
+
+        const BlobId& commitHash = commitBlob->hash;
+
+        if (workFile->blob == commitBlob) {
+            console() << "  " << filename << " — no changes." << endl;
+        } else if (workFile->blob->isChunked() || commitBlob->isChunked()) {
+            Blob* work = workFile->blob;
+            console() << "  " << filename << " — MODIFIED (" << work->size << " byte(s), "
+                      << work->pieces() - sharedChunks(commitBlob, work) << " of " << work->pieces()
+                      << " chunk(s) changed)" << endl;
+            console() << "  Last commit: [" << commitHash << "]" << endl;
+            console() << "  Working:     [" << workHash << "]" << endl;
+        } else {
+            LineDiff local;
+            LineDiff& lines = (hunks != NULL) ? *hunks : local;
+            lines.compute(commitBlob->content(), workFile->content());
+            ostringstream out;
+            out << "  " << filename << " — MODIFIED (+" << lines.added << " -" << lines.removed << ")\n";
+            out << "  Last commit: [" << commitHash << "]\n";
+            out << "  Working:     [" << workHash << "]\n";
+            if (hunks == NULL) {
+                out << '\n';
+                lines.writeUnified(out, "a/" + filename, "b/" + filename);
+            }
+            console() << out.str() << flush;
+        }
+        return true;
+    }
+
+    bool exportFile(const string& filename, const string& path) {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        File* f = workingFiles.getFile(filename);
+        if (f == NULL) {
+            console() << "  File '" << filename << "' not in working directory." << endl;
+            return false;
+        }
+        if (!writeBlob(f->blob, path)) {
+            console() << "  Error: cannot write " << path << endl;
+            return false;
+        }
+        console() << "  Exported " << filename << " -> " << path << " (" << f->blob->size << " byte(s) in "
+                  << f->blob->pieces() << " piece(s))" << endl;
+        return true;
+    }
+
+    void reportGc() {
+        console() << "  Pruned " << collector.prunedCommits << " unreachable commit(s); " << collector.liveCommits
+                  << " reachable; freed " << collector.freedBlobs << " blob(s) and " << collector.freedTrees << " tree(s)."
+                  << endl;
+        if (objects.isOpen())
+            console() << "  Pack: " << collector.objectsBefore << " -> " << collector.objectsAfter << " object(s), "
+                      << collector.bytesBefore << " -> " << collector.bytesAfter << " byte(s) in " << collector.slices
+                      << " slice(s)" << endl;
+    }
+
+    bool gcStep(long long micros) {
+        bool done = collector.step(micros);
+        if (collector.takePruned()) {
+            if (collector.prunedCommits > 0) journal.refresh();
+            if (rootCommit != NULL && commitIndex.find(rootCommit->commitId) != rootCommit) rootCommit = NULL;
+        }
+        return done;
+    }
+
+    bool gc(bool incremental = false, long long sliceMicros = GC_SLICE_MICROS) {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        settle();
+        if (!collector.running()) {
+            Commit** journaled;
+            int n = journal.collectCommits(journaled);
+            Commit** roots = new Commit*[n + branches.count() + 1];
+            for (int i = 0; i < n; i++) roots[i] = journaled[i];
+            delete[] journaled;
+            for (Branch* b = branches.first; b != NULL; b = b->next) roots[n++] = b->head;
+            roots[n++] = mergeHead;
+            FileState* files[3] = {&workingFiles, &stagingArea, &headFiles};
+            collector.start(roots, n, files, 3);
+            delete[] roots;
+        }
+        if (!incremental) {
+            while (!gcStep(sliceMicros)) {}
+        } else if (!gcStep(sliceMicros)) {
+            console() << "  GC: " << collector.liveCommits << " reachable commit(s), " << collector.pending()
+                      << " object(s) left; continuing between commands." << endl;
+            return true;
+        }
+        writeCommitGraph();
+        reportGc();
+        return true;
+    }
+
+    bool gcPending() const { return collector.running(); }
+
+    void gcSlice(long long micros = GC_SLICE_MICROS) {
+        if (!collector.running()) return;
+        settle();
+        if (gcStep(micros)) writeCommitGraph();
+    }
+
+    bool sync() {
+        if (!initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+        if (!pipeline.drain()) {
+            console() << "  Error: a background object write failed; later commits were not published." << endl;
+            return false;
+        }
+        console() << "  " << pipeline.durable() << " commit(s) durable in " << pipeline.groups() << " fsync group(s)." << endl;
+        return true;
+    }
+
+    bool upload(int fd) {
+        FdStream io(fd);
+        io.begin("MGUP");
+        u32 refs = 0;
+        for (Branch* b = branches.first; b != NULL; b = b->next) {
+            if (b->head != NULL) refs++;
+        }
+        io.writeU32(refs);
+        for (Branch* b = branches.first; b != NULL; b = b->next) {
+            if (b->head == NULL) continue;
+            io.writeBytes(b->name);
+            io.writeId(b->head->commitId);
+        }
+        io.writeBytes(initialized ? string_view(branches.active->name) : string_view());
+        u32 wantCount = 0, haveCount = 0;
+        if (!io.flush() || !io.expect("MGWH") || !io.readU32(wantCount) || wantCount > refs) return false;
+
+        Commit** wants = new Commit*[wantCount > 0 ? wantCount : 1];
+        Commit** haves = NULL;
+        int known = 0;
+        bool ok = true;
+        for (u32 i = 0; i < wantCount && ok; i++) {
+            ObjectId id;
+            ok = io.readId(id) && (wants[i] = commitIndex.find(id)) != NULL;
+        }
+        if (ok) ok = io.readU32(haveCount) && haveCount <= TRANSFER_MAX_HAVES;
+        if (ok) haves = new Commit*[haveCount > 0 ? haveCount : 1];
+        for (u32 i = 0; i < haveCount && ok; i++) {
+            ObjectId id;
+            ok = io.readId(id);
+            Commit* c = ok ? commitIndex.find(id) : NULL;
+            if (c != NULL) haves[known++] = c;
+        }
+        if (ok) {
+            Commit** missing;
+            int n = missingCommits(&graph, wants, (int)wantCount, haves, known, missing);
+            PackBuilder pack;
+            for (int i = 0; i < n; i++) pack.addCommit(missing[i]);
+            delete[] missing;
+            ok = pack.send(io);
+        }
+        delete[] wants;
+        delete[] haves;
+        return ok;
+    }
+
+    bool fetch(int fd, const string& remote, bool clone) {
+        if (!objects.isOpen()) { console() << "  Error: fetch needs on-disk storage." << endl; return false; }
+        if (clone && initialized) { console() << "  Error: clone target is not empty." << endl; return false; }
+        if (!clone && !initialized) { console() << "  Error: repo not initialized." << endl; return false; }
+
+        FdStream io(fd);
+        u32 refCount = 0;
+        if (!io.expect("MGUP") || !io.readU32(refCount) || refCount > TRANSFER_MAX_REFS) {
+            console() << "  Error: " << remote << " did not answer with a ref advertisement." << endl;
+            return false;
+        }
+        string* names = new string[refCount > 0 ? refCount : 1];
+        CommitId* ids = new CommitId[refCount > 0 ? refCount : 1];
+        string headName;
+        for (u32 i = 0; i < refCount && io.ok; i++) {
+            if (io.readBytes(names[i], TRANSFER_MAX_NAME) && io.readId(ids[i]) && !validRefName(names[i])) io.ok = false;
+        }
+        io.readBytes(headName, TRANSFER_MAX_NAME);
+
+        IdSet wanted, sent;
+        CommitId* wants = new CommitId[refCount > 0 ? refCount : 1];
+        CommitId* haves = new CommitId[TRANSFER_MAX_HAVES];
+        int wantCount = 0, haveCount = 0;
+        for (u32 i = 0; i < refCount; i++) {
+            if (commitIndex.find(ids[i]) == NULL) {
+                if (wanted.insert(ids[i])) wants[wantCount++] = ids[i];
+            } else if (haveCount < (int)TRANSFER_MAX_HAVES && sent.insert(ids[i])) {
+                haves[haveCount++] = ids[i];
+            }
+        }
+        haveCount = collectHaves(sent, haves, haveCount);
+        io.begin("MGWH");
+        io.writeU32((u32)wantCount);
+        for (int i = 0; i < wantCount; i++) io.writeId(wants[i]);
+        io.writeU32((u32)haveCount);
+        for (int i = 0; i < haveCount; i++) io.writeId(haves[i]);
+        delete[] wants;
+        delete[] haves;
+
+        int before = commitIndex.count;
+        u32 received = 0;
+        bool ok = io.flush() && receivePack(io, received);
+        int updated = 0;
+        if (ok && clone) initialized = true;
+        for (u32 i = 0; i < refCount && ok; i++) {
+            Commit* head = loadHistory(ids[i]);
+            if (head == NULL) {
+                ok = false;
+                break;
+            }
+            collector.addRoot(head);
+            string name = clone ? names[i] : remote + "/" + names[i];
+            Branch* b = branches.findBranch(name);
+            if (b != NULL && b->head == head) continue;
+            if (b == NULL) b = branches.addBranch(name, head);
+            else b->head = head;
+            saveRefs(b);
+            updated++;
+        }
+        delete[] names;
+        delete[] ids;
+        if (!ok) {
+            console() << "  Error: transfer from " << remote << " failed after " << received
+                      << " object(s) (connection closed or corrupt pack)." << endl;
+            return false;
+        }
+
+        int fresh = commitIndex.count - before;
+        if (clone) {
+            if (branches.first == NULL) saveRefs(branches.addBranch(headName.empty() ? "main" : headName, NULL));
+            branches.switchBranch(headName);
+            saveRefs();
+            viewHead(branches.active->head);
+            workingFiles = headFiles;
+            statusIndex.invalidate();
+            console() << "  Cloned " << remote << ": " << branches.count() << " branch(es), " << fresh << " commit(s), "
+                      << received << " object(s) in " << io.bytesIn << " byte(s)." << endl;
+            console() << "  Checked out '" << branches.active->name << "' (" << workingFiles.fileCount << " file(s))." << endl;
+        } else if (wantCount == 0) {
+            console() << "  Already up to date with " << remote << "." << endl;
+        } else {
+            console() << "  Fetched " << fresh << " new commit(s) from " << remote << ": " << received << " object(s) in "
+                      << io.bytesIn << " byte(s), " << updated << " ref(s) updated under " << remote << "/." << endl;
+        }
+        return true;
+    }
+
+    static void help() {
+        console() << endl;
+        console() << "  === MiniGit Commands ===" << endl;
+        console() << "  repo create <name>      Create a new repository" << endl;
+        console() << "  init                    Initialize repository" << endl;
+        console() << "  add <file> <content>    Write and stage a file" << endl;
+        console() << "  add <file>              Stage the working copy of a file" << endl;
+        console() << "  add -A [path...]        Read, hash and stage files from disk in parallel" << endl;
+        console() << "                          (files of 1 MiB or more are streamed in content-defined chunks)" << endl;
+        console() << "  write <file> <content>  Change a file in the working tree only" << endl;
+        console() << "  commit <message>        Commit staged files" << endl;
+        console() << "  log [-n N] [--skip N] [--since DATE] [file]" << endl;
+        console() << "                          Show commit history, optionally only commits touching a file" << endl;
+        console() << "  repo switch <name>      Switch to a repository" << endl;
+        console() << "  repos                   List all repositories" << endl;
+        console() << "  status                  Show working tree status" << endl;
+        console() << "  diff <file>             Compare file with last commit" << endl;
+        console() << "  sparse set|add <pattern...>" << endl;
+        console() << "                          Check out only matching paths (dir/, *.txt, src/*.h)" << endl;
+        console() << "  sparse list|disable     Show the sparse patterns or check out every file again" << endl;
+        console() << "  export <file> <path>    Write the working copy of a file to disk" << endl;
+        console() << "  branch <name>           Create a new branch" << endl;
+        console() << "  checkout <name>         Switch to a branch" << endl;
+        console() << "  branches [prefix]       List branches, optionally under a prefix such as feature/" << endl;
+        console() << "  merge <branch>          Merge branch into current" << endl;
+        console() << "  undo                    Undo last commit" << endl;
+        console() << "  redo                    Redo undone commit" << endl;
+        console() << "  revert <commit-id>      Revert to a commit (full or abbreviated ID)" << endl;
+        console() << "  gc [--incremental]      Prune unreachable commits and repack live objects" << endl;
+        console() << "  sync                    Wait until queued commits are on disk" << endl;
+        console() << "  clone <src> <name>      Copy a repo (local name or host:port) into a new repo" << endl;
+        console() << "  fetch <src>             Fetch missing commits into <src>/<branch> refs" << endl;
+        console() << "  serve <port> [n]        Serve this repo to n clone/fetch sessions over TCP" << endl;
+        console() << "  stats [--json|--prometheus|--reset]" << endl;
+        console() << "                          Show timing spans and engine counters" << endl;
+        console() << "  repo delete <name>      Delete a repository" << endl;
+        console() << "  help                    Show this help" << endl;
+        console() << "  exit                    Quit MiniGit" << endl;
+        console() << endl;
+    }
+};
+
+int openRepositories(RepoManager<MiniGit>& repos, const string& storageRoot) {
+    mkdir(storageRoot.c_str(), 0755);
+    int found = 0, foundCapacity = 0;
+    string* foundNames = NULL;
+    DIR* root = opendir(storageRoot.c_str());
+    if (root != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(root)) != NULL) {
+            string name = entry->d_name;
+            if (name == "." || name == "..") continue;
+            struct stat st;
+            if (stat((storageRoot + "/" + name + "/objects.pack").c_str(), &st) != 0) continue;
+            if (found == foundCapacity) foundNames = growArray(foundNames, found, foundCapacity);
+            foundNames[found++] = name;
+        }
+        closedir(root);
+    }
+    sort(foundNames, foundNames + found);
+    for (int i = 0; i < found; i++) {
+        MiniGit* repo = new MiniGit();
+        repo->open(storageRoot + "/" + foundNames[i]);
+        repos.insert(foundNames[i], repo);
+    }
+    delete[] foundNames;
+    return found;
+}
+
+bool createRepository(RepoManager<MiniGit>& repos, const string& storageRoot, const string& name) {
+    if (name.empty()) {
+        console() << "  Usage: repo create <name>" << endl;
+        return false;
+    }
+    if (repos.contains(name)) {
+        console() << "  Repository '" << name << "' already exists." << endl;
+        return false;
+    }
+    if (name[0] == '.' || name.find('/') != string::npos) {
+        console() << "  Invalid repository name: " << name << endl;
+        return false;
+    }
+    MiniGit* repo = new MiniGit();
+    if (!repo->open(storageRoot + "/" + name))
+        console() << "  Warning: could not open storage; repository is in-memory only." << endl;
+    if (!repos.insert(name, repo)) {
+        delete repo;
+        console() << "  Repository '" << name << "' already exists." << endl;
+        return false;
+    }
+    console() << "  Created and switched to repository: " << name << endl;
+    return true;
+}
+
+bool deleteRepository(RepoManager<MiniGit>& repos, const string& name) {
+    RepoLease<MiniGit> doomed = repos.detach(name);
+    if (!doomed.isValid()) {
+        console() << "  Repository '" << name << "' not found." << endl;
+        return false;
+    }
+    doomed->destroyStorage();
+    console() << "  Deleted repository: " << name << endl;
+    return true;
+}
+
+void serveSession(MiniGit* repo, int fd) {
+    repo->upload(fd);
+    ::shutdown(fd, SHUT_WR);
+}
+
+bool fetchRepository(RepoManager<MiniGit>& repos, const string& source, MiniGit& target, bool clone,
+                     const string& self = "") {
+    if (isRemoteSpec(source)) {
+        int fd = connectTo(source);
+        if (fd < 0) {
+            console() << "  Error: cannot connect to " << source << endl;
+            return false;
+        }
+        bool ok = target.fetch(fd, "origin", clone);
+        ::close(fd);
+        return ok;
+    }
+    if (source == self) {
+        console() << "  Error: a repository cannot fetch from itself." << endl;
+        return false;
+    }
+    RepoLease<MiniGit> origin = repos.tryRead(source);
+    if (!origin.isValid()) {
+        if (repos.contains(source)) console() << "  Repository '" << source << "' is busy; try again." << endl;
+        else console() << "  Repository '" << source << "' not found." << endl;
+        return false;
+    }
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return false;
+    thread server(serveSession, origin.get(), fds[1]);
+    bool ok = target.fetch(fds[0], source, clone);
+    ::shutdown(fds[0], SHUT_RDWR);
+    server.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return ok;
+}
+
+bool cloneRepository(RepoManager<MiniGit>& repos, const string& storageRoot, const string& source, const string& name) {
+    if (!isRemoteSpec(source) && !repos.contains(source)) {
+        console() << "  Repository '" << source << "' not found." << endl;
+        return false;
+    }
+    if (!createRepository(repos, storageRoot, name)) return false;
+    bool ok;
+    {
+        RepoLease<MiniGit> target = repos.write(name);
+        ok = target.isValid() && fetchRepository(repos, source, *target.get(), true);
+    }
+    if (!ok) deleteRepository(repos, name);
+    return ok;
+}
+
+int serveOn(RepoManager<MiniGit>& repos, const string& name, int listener, int sessions) {
+    int served = 0;
+    while (served < sessions) {
+        int fd = ::accept(listener, NULL, NULL);
+        if (fd < 0) break;
+        {
+            RepoLease<MiniGit> repo = repos.read(name);
+            if (repo.isValid()) repo->upload(fd);
+        }
+        ::close(fd);
+        served++;
+    }
+    return served;
+}
+
+int serveRepository(RepoManager<MiniGit>& repos, const string& name, int port, int sessions) {
+    int bound;
+    int listener = listenOn(port, bound);
+    if (listener < 0) {
+        console() << "  Error: cannot listen on port " << port << endl;
+        return 0;
+    }
+    console() << "  Serving " << name << " on 127.0.0.1:" << bound << " for " << sessions << " session(s)." << endl;
+    int served = serveOn(repos, name, listener, sessions);
+    ::close(listener);
+    console() << "  Served " << served << " session(s)." << endl;
+    return served;
+}
+
+#endif
@@ -0,0 +1,429 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <cstdlib>
+#include "repository.h"
+#include "repomanager.h"
+#include "json.h"
+#include "stats.h"
+using namespace std;
+
+class Tokenizer {
+private:
+    string_view text;
+    size_t pos;
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+public:
+    Tokenizer(string_view line) : text(line), pos(0) {}
+
+    string_view next() {
+        while (pos < text.length() && isSpace(text[pos])) pos++;
+        size_t start = pos;
+        while (pos < text.length() && !isSpace(text[pos])) pos++;
+        return text.substr(start, pos - start);
+    }
+
+    string_view rest() {
+        size_t start = pos;
+        if (start < text.length() && text[start] == ' ') start++;
+        pos = text.length();
+        size_t end = text.length();
+        while (end > start && text[end - 1] == '\r') end--;
+        return text.substr(start, end - start);
+    }
+};
+
+enum CommandId {
+    CMD_UNKNOWN, CMD_EXIT, CMD_REPO, CMD_REPOS, CMD_HELP, CMD_INIT, CMD_ADD, CMD_WRITE, CMD_COMMIT,
+    CMD_LOG, CMD_STATUS, CMD_DIFF, CMD_BRANCH, CMD_CHECKOUT, CMD_BRANCHES, CMD_MERGE, CMD_UNDO,
+    CMD_REDO, CMD_REVERT, CMD_GC, CMD_STATS, CMD_EXPORT, CMD_SPARSE, CMD_SYNC,
+    CMD_CLONE, CMD_FETCH, CMD_SERVE
+};
+
+class CommandSpec {
+public:
+    const char* name;
+    CommandId id;
+    bool reading;
+};
+
+const CommandSpec COMMANDS[] = {
+    {"exit", CMD_EXIT, false},        {"quit", CMD_EXIT, false},
+    {"repo", CMD_REPO, false},        {"repos", CMD_REPOS, false},
+    {"help", CMD_HELP, false},        {"init", CMD_INIT, false},
+    {"add", CMD_ADD, false},          {"write", CMD_WRITE, false},
+    {"commit", CMD_COMMIT, false},    {"log", CMD_LOG, true},
+    {"status", CMD_STATUS, true},     {"diff", CMD_DIFF, true},
+    {"branch", CMD_BRANCH, false},    {"checkout", CMD_CHECKOUT, false},
+    {"branches", CMD_BRANCHES, true}, {"merge", CMD_MERGE, false},
+    {"undo", CMD_UNDO, false},        {"redo", CMD_REDO, false},
+    {"revert", CMD_REVERT, false},    {"gc", CMD_GC, false},
+    {"stats", CMD_STATS, false},      {"export", CMD_EXPORT, true},
+    {"sparse", CMD_SPARSE, false},    {"sync", CMD_SYNC, true},
+    {"clone", CMD_CLONE, false},      {"fetch", CMD_FETCH, false},
+    {"serve", CMD_SERVE, true},
+};
+
+const int COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+const int COMMAND_SLOTS = 64;
+
+class CommandTable {
+private:
+    const CommandSpec* slots[COMMAND_SLOTS];
+    const CommandSpec unknown;
+
+public:
+    CommandTable() : unknown{"", CMD_UNKNOWN, false} {
+        for (int i = 0; i < COMMAND_SLOTS; i++) slots[i] = NULL;
+        for (int i = 0; i < COMMAND_COUNT; i++) {
+            u64 h = fastHash(COMMANDS[i].name) % COMMAND_SLOTS;
+            while (slots[h] != NULL) h = (h + 1) % COMMAND_SLOTS;
+            slots[h] = &COMMANDS[i];
+        }
+    }
+
+    const CommandSpec& find(string_view name) const {
+        for (u64 h = fastHash(name) % COMMAND_SLOTS; slots[h] != NULL; h = (h + 1) % COMMAND_SLOTS) {
+            if (name == slots[h]->name) return *slots[h];
+        }
+        return unknown;
+    }
+};
+
+const CommandTable& commandTable() {
+    static CommandTable table;
+    return table;
+}
+
+class Shell {
+private:
+    RepoManager<MiniGit>& repos;
+    string storageRoot;
+
+    Shell(const Shell&);
+    Shell& operator=(const Shell&);
+
+    void repoCommand(Tokenizer& tokens) {
+        string_view action = tokens.next();
+        string name(tokens.next());
+        if (action == "create") {
+            if (createRepository(repos, storageRoot, name)) activeName = name;
+        } else if (action == "switch") {
+            if (name.empty()) {
+                console() << "  Usage: repo switch <name>" << endl;
+            } else if (repos.contains(name)) {
+                activeName = name;
+                console() << "  Switched to repo: " << name << endl;
+            } else {
+                console() << "  Repository '" << name << "' not found." << endl;
+            }
+        } else if (action == "delete") {
+            if (name.empty()) {
+                console() << "  Usage: repo delete <name>" << endl;
+            } else if (activeName == name) {
+                console() << "  Cannot delete the active repo. Switch first." << endl;
+            } else {
+                deleteRepository(repos, name);
+            }
+        } else {
+            console() << "  Usage: repo create|switch|delete <name>" << endl;
+        }
+    }
+
+    void listRepos() {
+        console() << "  === Repositories ===" << endl;
+        string* names;
+        int count = repos.names(names);
+        if (count == 0) {
+            console() << "  (none — run 'repo create <name>')" << endl;
+        } else {
+            for (int i = 0; i < count; i++) {
+                if (names[i] == activeName)
+                    console() << "  * " << names[i] << " (active)" << endl;
+                else
+                    console() << "    " << names[i] << endl;
+            }
+        }
+        delete[] names;
+        console() << "  Total: " << count << " repo(s)" << endl;
+    }
+
+    void cloneCommand(Tokenizer& tokens) {
+        string source(tokens.next()), name(tokens.next());
+        if (source.empty() || name.empty()) console() << "  Usage: clone <repo|host:port> <name>" << endl;
+        else if (cloneRepository(repos, storageRoot, source, name)) activeName = name;
+    }
+
+    void serveCommand(Tokenizer& tokens) {
+        string_view port = tokens.next(), sessions = tokens.next();
+        if (activeName.empty()) {
+            console() << "  No repository selected. Run 'repo create <name>' first." << endl;
+        } else if (port.empty()) {
+            console() << "  Usage: serve <port> [sessions]" << endl;
+        } else {
+            serveRepository(repos, activeName, atoi(string(port).c_str()),
+                            sessions.empty() ? 1 : atoi(string(sessions).c_str()));
+        }
+    }
+
+    void statsCommand(Tokenizer& tokens) {
+        string_view format = tokens.next();
+        if (format.empty()) {
+            printStats(console());
+        } else if (format == "--json") {
+            JsonWriter json;
+            json.beginObject();
+            writeStatsJson(json);
+            json.endObject();
+            console() << "  " << json.out << endl;
+        } else if (format == "--prometheus") {
+            console() << statsPrometheus();
+        } else if (format == "--reset") {
+            traceStats().reset();
+            console() << "  Stats reset." << endl;
+        } else {
+            console() << "  Usage: stats [--json|--prometheus|--reset]" << endl;
+        }
+    }
+
+    void addCommand(MiniGit& repo, Tokenizer& tokens) {
+        string_view file = tokens.next();
+        if (file == "-A") {
+            int count = 0, capacity = 0;
+            string* paths = NULL;
+            for (string_view path = tokens.next(); !path.empty(); path = tokens.next()) {
+                if (count == capacity) paths = growArray(paths, count, capacity);
+                paths[count++] = string(path);
+            }
+            if (count == 0) {
+                paths = new string[1];
+                paths[count++] = ".";
+            }
+            repo.addPaths(paths, count);
+            delete[] paths;
+            return;
+        }
+        string_view content = tokens.rest();
+        if (file.empty()) {
+            console() << "  Usage: add <filename> <content>" << endl;
+        } else {
+            string name(file);
+            if (!content.empty() || !repo.stage(name))
+                repo.add(name, content.empty() ? string_view("(empty file)") : content);
+        }
+    }
+
+    void logCommand(MiniGit& repo, Tokenizer& tokens) {
+        LogOptions opts;
+        bool valid = true;
+        for (string_view opt = tokens.next(); valid && !opt.empty(); opt = tokens.next()) {
+            if (opt[0] != '-') {
+                valid = opts.path.empty();
+                opts.path = string(opt);
+                continue;
+            }
+            string value(tokens.next());
+            if (value.empty()) {
+                valid = false;
+            } else if (opt == "-n") {
+                opts.maxCount = atoi(value.c_str());
+                valid = opts.maxCount > 0 || value == "0";
+            } else if (opt == "--skip") {
+                opts.skip = atoi(value.c_str());
+                valid = opts.skip >= 0;
+            } else if (opt == "--since") {
+                valid = parseDate(value, opts.since);
+            } else {
+                valid = false;
+            }
+        }
+        if (valid) {
+            repo.log(opts);
+        } else {
+            console() << "  Usage: log [-n <count>] [--skip <count>] [--since <YYYY-MM-DD|epoch>] [file]" << endl;
+        }
+    }
+
+    void sparseCommand(MiniGit& repo, Tokenizer& tokens) {
+        string_view mode = tokens.next();
+        if (mode == "list") {
+            repo.listSparse();
+            return;
+        }
+        if (mode == "disable") {
+            repo.setSparse(NULL, 0, true);
+            return;
+        }
+        int count = 0, capacity = 0;
+        string* patterns = NULL;
+        for (string_view p = tokens.next(); !p.empty(); p = tokens.next()) {
+            if (count == capacity) patterns = growArray(patterns, count, capacity);
+            patterns[count++] = string(p);
+        }
+        if ((mode == "set" || mode == "add") && count > 0) repo.setSparse(patterns, count, mode == "set");
+        else console() << "  Usage: sparse set|add <pattern...> | sparse list | sparse disable" << endl;
+        delete[] patterns;
+    }
+
+    bool named(Tokenizer& tokens, string& out, const char* usage) {
+        out = string(tokens.next());
+        if (out.empty()) console() << "  Usage: " << usage << endl;
+        return !out.empty();
+    }
+
+    void runCommand(const CommandSpec& spec, MiniGit& repo, Tokenizer& tokens, string_view word) {
+        string arg;
+        switch (spec.id) {
+        case CMD_INIT:
+            repo.init();
+            break;
+        case CMD_ADD:
+            addCommand(repo, tokens);
+            break;
+        case CMD_WRITE: {
+            string file(tokens.next());
+            string_view content = tokens.rest();
+            if (file.empty()) console() << "  Usage: write <filename> <content>" << endl;
+            else repo.write(file, content);
+            break;
+        }
+        case CMD_COMMIT: {
+            string message(tokens.rest());
+            if (message.empty()) console() << "  Usage: commit <message>" << endl;
+            else repo.commit(message);
+            break;
+        }
+        case CMD_LOG:
+            logCommand(repo, tokens);
+            break;
+        case CMD_STATUS:
+            repo.status();
+            break;
+        case CMD_DIFF:
+            if (named(tokens, arg, "diff <filename>")) repo.diff(arg);
+            break;
+        case CMD_EXPORT: {
+            string file(tokens.next());
+            string path(tokens.rest());
+            if (file.empty() || path.empty()) console() << "  Usage: export <filename> <path>" << endl;
+            else repo.exportFile(file, path);
+            break;
+        }
+        case CMD_BRANCH:
+            if (named(tokens, arg, "branch <name>")) repo.branch(arg);
+            break;
+        case CMD_CHECKOUT:
+            if (named(tokens, arg, "checkout <branch-name>")) repo.checkout(arg);
+            break;
+        case CMD_BRANCHES:
+            repo.listBranches(tokens.next());
+            break;
+        case CMD_MERGE:
+            if (named(tokens, arg, "merge <branch-name>")) repo.merge(arg);
+            break;
+        case CMD_UNDO:
+            repo.undo();
+            break;
+        case CMD_REDO:
+            repo.redo();
+            break;
+        case CMD_REVERT:
+            if (named(tokens, arg, "revert <commit-id>")) repo.revert(arg);
+            break;
+        case CMD_SPARSE:
+            sparseCommand(repo, tokens);
+            break;
+        case CMD_SYNC:
+            repo.sync();
+            break;
+        case CMD_FETCH:
+            if (named(tokens, arg, "fetch <repo|host:port>")) fetchRepository(repos, arg, repo, false, activeName);
+            break;
+        case CMD_GC: {
+            string_view mode = tokens.next();
+            if (mode.empty() || mode == "--incremental") repo.gc(!mode.empty());
+            else console() << "  Usage: gc [--incremental]" << endl;
+            break;
+        }
+        default:
+            console() << "  Unknown command: " << word << ". Type 'help' for options." << endl;
+            break;
+        }
+    }
+
+public:
+    string activeName;
+
+    Shell(RepoManager<MiniGit>& r, const string& root) : repos(r), storageRoot(root) {}
+
+    bool execute(string_view line) {
+        Tokenizer tokens(line);
+        string_view word = tokens.next();
+        if (word.empty()) return true;
+        const CommandSpec& spec = commandTable().find(word);
+
+        switch (spec.id) {
+        case CMD_EXIT:
+            console() << "  Goodbye!" << endl;
+            return false;
+        case CMD_REPO:
+            repoCommand(tokens);
+            break;
+        case CMD_REPOS:
+            listRepos();
+            break;
+        case CMD_HELP:
+            MiniGit::help();
+            break;
+        case CMD_STATS:
+            statsCommand(tokens);
+            break;
+        case CMD_CLONE:
+            cloneCommand(tokens);
+            break;
+        case CMD_SERVE:
+            serveCommand(tokens);
+            break;
+        default:
+            if (activeName.empty()) {
+                console() << "  No repository selected. Run 'repo create <name>' first." << endl;
+                break;
+            }
+            {
+                RepoLease<MiniGit> repo = repos.open(activeName, !spec.reading);
+                if (repo.isValid()) {
+                    runCommand(spec, *repo.get(), tokens, word);
+                    if (!spec.reading && spec.id != CMD_GC && repo.get()->gcPending()) repo.get()->gcSlice();
+                } else {
+                    console() << "  Repository '" << activeName << "' no longer exists." << endl;
+                    activeName.clear();
+                }
+            }
+            break;
+        }
+        console() << endl;
+        return true;
+    }
+
+    int runBatch(string_view script) {
+        int lines = 0;
+        size_t pos = 0;
+        while (pos < script.length()) {
+            size_t end = script.find('\n', pos);
+            if (end == string_view::npos) end = script.length();
+            string_view line = script.substr(pos, end - pos);
+            pos = end + 1;
+            lines++;
+            if (line.empty() || line[0] == '#') continue;
+            if (!execute(line)) break;
+        }
+        return lines;
+    }
+};
+
+#endif
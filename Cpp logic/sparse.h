@@ -0,0 +1,139 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <string>
+#include <string_view>
+#include "minigit.h"
+#include "tree.h"
+using namespace std;
+
+bool globMatch(string_view pattern, string_view text) {
+    size_t p = 0, t = 0, star = string_view::npos, mark = 0;
+    while (t < text.length()) {
+        if (p < pattern.length() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            p++;
+            t++;
+        } else if (p < pattern.length() && pattern[p] == '*') {
+            star = p++;
+            mark = t;
+        } else if (star != string_view::npos) {
+            p = star + 1;
+            t = ++mark;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.length() && pattern[p] == '*') p++;
+    return p == pattern.length();
+}
+
+bool nextSegment(string_view& rest, string_view& segment) {
+    if (rest.empty()) return false;
+    size_t slash = rest.find('/');
+    segment = rest.substr(0, slash);
+    rest = (slash == string_view::npos) ? string_view() : rest.substr(slash + 1);
+    return true;
+}
+
+class SparseSet {
+private:
+    string* patterns;
+    int capacity;
+
+    SparseSet(const SparseSet&);
+    SparseSet& operator=(const SparseSet&);
+
+    static bool covers(string_view pattern, string_view path, bool directory) {
+        bool dirPattern = pattern.back() == '/';
+        if (dirPattern) pattern.remove_suffix(1);
+        string_view p, s;
+        while (true) {
+            bool hasP = nextSegment(pattern, p), hasS = nextSegment(path, s);
+            if (!hasP) return dirPattern ? (hasS || directory) : (!hasS && !directory);
+            if (!hasS) return directory;
+            if (!globMatch(p, s)) return false;
+        }
+    }
+
+    void select(Tree* t, const string& prefix, FileState& out) const {
+        for (int i = 0; i < t->count; i++) {
+            TreeEntry& e = t->entries[i];
+            string path = prefix.empty() ? string(e.name) : prefix + "/" + string(e.name);
+            if (e.tree != NULL) {
+                if (mayContain(path)) select(e.tree, path, out);
+            } else if (matches(path)) {
+                out.putBlob(path, e.blob);
+            }
+        }
+    }
+
+public:
+    int count;
+
+    SparseSet() : patterns(NULL), capacity(0), count(0) {}
+
+    ~SparseSet() { delete[] patterns; }
+
+    bool active() const { return count > 0; }
+
+    const string& at(int i) const { return patterns[i]; }
+
+    void clear() { count = 0; }
+
+    bool add(string_view pattern) {
+        while (pattern.compare(0, 2, "./") == 0) pattern.remove_prefix(2);
+        while (!pattern.empty() && pattern[0] == '/') pattern.remove_prefix(1);
+        if (pattern.empty()) return false;
+        for (int i = 0; i < count; i++) {
+            if (patterns[i] == pattern) return false;
+        }
+        if (count == capacity) patterns = growArray(patterns, count, capacity);
+        patterns[count++] = string(pattern);
+        return true;
+    }
+
+    bool matches(string_view path) const {
+        if (count == 0) return true;
+        for (int i = 0; i < count; i++) {
+            if (covers(patterns[i], path, false)) return true;
+        }
+        return false;
+    }
+
+    bool mayContain(string_view dir) const {
+        if (count == 0) return true;
+        for (int i = 0; i < count; i++) {
+            if (covers(patterns[i], dir, true)) return true;
+        }
+        return false;
+    }
+
+    void select(Tree* t, FileState& out) const {
+        if (t != NULL) select(t, "", out);
+    }
+
+    void filter(FileState& all, FileState& out) const {
+        for (File* f = all.first(); f != NULL; f = all.next(f)) {
+            if (matches(f->name)) out.putBlob(f->name, f->blob);
+        }
+    }
+
+    string encode() const {
+        string text;
+        for (int i = 0; i < count; i++) text += patterns[i] + "\n";
+        return text;
+    }
+
+    void decode(const string& text) {
+        clear();
+        size_t pos = 0;
+        while (pos < text.length()) {
+            size_t eol = text.find('\n', pos);
+            if (eol == string::npos) eol = text.length();
+            add(string_view(text).substr(pos, eol - pos));
+            pos = eol + 1;
+        }
+    }
+};
+
+#endif
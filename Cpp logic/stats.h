@@ -0,0 +1,241 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <ostream>
+#include <cstdio>
+#include "json.h"
+using namespace std;
+
+#ifndef MINIGIT_TRACE
+#define MINIGIT_TRACE 1
+#endif
+
+enum TraceCounter {
+    CTR_SHA1_BYTES, CTR_SHA1_CALLS, CTR_FAST_HASH_BYTES, CTR_FAST_HASH_CALLS, CTR_SNAPSHOT_COPIES,
+    CTR_SNAPSHOT_BYTES, CTR_OBJECTS, CTR_OBJECT_BYTES, CTR_FILE_LOOKUPS, CTR_FILE_PROBES, CTR_BLOB_LOOKUPS,
+    CTR_BLOB_PROBES, CTR_COMMIT_LOOKUPS, CTR_COMMIT_PROBES, CTR_COUNT
+};
+
+const char* const TRACE_COUNTER_NAMES[] = {
+    "sha1_bytes", "sha1_calls", "fast_hash_bytes", "fast_hash_calls", "snapshot_copies",
+    "snapshot_bytes_copied", "objects_allocated", "object_bytes_allocated", "file_lookups", "file_probes",
+    "blob_lookups", "blob_probes", "commit_lookups", "commit_probes",
+};
+
+enum TraceSpanId { SPAN_COMMIT, SPAN_CHECKOUT, SPAN_MERGE, SPAN_REVERT, SPAN_DIFF, SPAN_STATUS, SPAN_HASH, SPAN_COUNT };
+
+const char* const TRACE_SPAN_NAMES[] = {"commit", "checkout", "merge", "revert", "diff", "status", "hash"};
+
+class SpanStats {
+public:
+    atomic<unsigned long long> calls;
+    atomic<unsigned long long> nanos;
+    atomic<unsigned long long> maxNanos;
+
+    SpanStats() : calls(0), nanos(0), maxNanos(0) {}
+
+    void record(unsigned long long elapsed) {
+        calls.fetch_add(1, memory_order_relaxed);
+        nanos.fetch_add(elapsed, memory_order_relaxed);
+        unsigned long long seen = maxNanos.load(memory_order_relaxed);
+        while (elapsed > seen && !maxNanos.compare_exchange_weak(seen, elapsed, memory_order_relaxed)) {}
+    }
+};
+
+class CounterBlock {
+public:
+    atomic<unsigned long long> values[CTR_COUNT];
+    atomic<bool> owned;
+    CounterBlock* next;
+
+    CounterBlock() : owned(true), next(NULL) {
+        for (int i = 0; i < CTR_COUNT; i++) values[i].store(0, memory_order_relaxed);
+    }
+};
+
+class CounterLease {
+public:
+    CounterBlock* block;
+
+    CounterLease() : block(NULL) {}
+
+    ~CounterLease() {
+        if (block != NULL) block->owned.store(false, memory_order_release);
+    }
+};
+
+class TraceStats {
+private:
+    atomic<CounterBlock*> blocks;
+
+public:
+    SpanStats spans[SPAN_COUNT];
+
+    TraceStats() : blocks(NULL) { reset(); }
+
+    CounterBlock* claim() {
+        for (CounterBlock* b = blocks.load(memory_order_acquire); b != NULL; b = b->next) {
+            bool expected = false;
+            if (b->owned.compare_exchange_strong(expected, true, memory_order_acquire, memory_order_relaxed)) return b;
+        }
+        CounterBlock* mine = new CounterBlock();
+        CounterBlock* head = blocks.load(memory_order_relaxed);
+        do {
+            mine->next = head;
+        } while (!blocks.compare_exchange_weak(head, mine, memory_order_release, memory_order_relaxed));
+        return mine;
+    }
+
+    CounterBlock& local() {
+        thread_local CounterLease lease;
+        if (lease.block == NULL) lease.block = claim();
+        return *lease.block;
+    }
+
+    int blockCount() const {
+        int n = 0;
+        for (CounterBlock* b = blocks.load(memory_order_acquire); b != NULL; b = b->next) n++;
+        return n;
+    }
+
+    void add(TraceCounter c, unsigned long long n) {
+        atomic<unsigned long long>& value = local().values[c];
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+
+    void reset() {
+        for (CounterBlock* b = blocks.load(memory_order_acquire); b != NULL; b = b->next) {
+            for (int i = 0; i < CTR_COUNT; i++) b->values[i].store(0, memory_order_relaxed);
+        }
+        for (int i = 0; i < SPAN_COUNT; i++) {
+            spans[i].calls.store(0, memory_order_relaxed);
+            spans[i].nanos.store(0, memory_order_relaxed);
+            spans[i].maxNanos.store(0, memory_order_relaxed);
+        }
+    }
+
+    unsigned long long counter(TraceCounter c) const {
+        unsigned long long total = 0;
+        for (CounterBlock* b = blocks.load(memory_order_acquire); b != NULL; b = b->next)
+            total += b->values[c].load(memory_order_relaxed);
+        return total;
+    }
+
+private:
+    TraceStats(const TraceStats&);
+    TraceStats& operator=(const TraceStats&);
+};
+
+TraceStats& traceStats() {
+    static TraceStats stats;
+    return stats;
+}
+
+void traceCount(TraceCounter c, unsigned long long n) { traceStats().add(c, n); }
+
+class TraceSpan {
+private:
+    TraceSpanId span;
+    chrono::steady_clock::time_point start;
+
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+
+public:
+    TraceSpan(TraceSpanId s) : span(s), start(chrono::steady_clock::now()) {}
+
+    ~TraceSpan() {
+        chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+        traceStats().spans[span].record((unsigned long long)chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+    }
+};
+
+#if MINIGIT_TRACE
+#define TRACE_SPAN(span) TraceSpan traceSpan(span)
+#define TRACE_COUNT(counter, n) traceCount(counter, n)
+#else
+#define TRACE_SPAN(span) ((void)0)
+#define TRACE_COUNT(counter, n) ((void)0)
+#endif
+
+double averageProbes(const TraceStats& stats, TraceCounter lookups, TraceCounter probes) {
+    unsigned long long n = stats.counter(lookups);
+    return n > 0 ? (double)stats.counter(probes) / n : 0.0;
+}
+
+void writeStatsJson(JsonWriter& json) {
+    TraceStats& stats = traceStats();
+    json.field("tracing", MINIGIT_TRACE != 0);
+    json.key("counters").beginObject();
+    for (int i = 0; i < CTR_COUNT; i++) json.field(TRACE_COUNTER_NAMES[i], (long long)stats.counter((TraceCounter)i));
+    json.endObject();
+    json.key("spans").beginObject();
+    for (int i = 0; i < SPAN_COUNT; i++) {
+        SpanStats& s = stats.spans[i];
+        json.key(TRACE_SPAN_NAMES[i]).beginObject();
+        json.field("calls", (long long)s.calls.load(memory_order_relaxed));
+        json.field("totalNs", (long long)s.nanos.load(memory_order_relaxed));
+        json.field("maxNs", (long long)s.maxNanos.load(memory_order_relaxed));
+        json.endObject();
+    }
+    json.endObject();
+}
+
+string statsPrometheus() {
+    TraceStats& stats = traceStats();
+    string out;
+    for (int i = 0; i < CTR_COUNT; i++) {
+        string name = string("minigit_") + TRACE_COUNTER_NAMES[i] + "_total";
+        out += "# TYPE " + name + " counter\n";
+        out += name + " " + to_string(stats.counter((TraceCounter)i)) + "\n";
+    }
+    const char* metrics[3] = {"minigit_span_calls_total", "minigit_span_seconds_total", "minigit_span_max_seconds"};
+    const char* types[3] = {"counter", "counter", "gauge"};
+    for (int m = 0; m < 3; m++) {
+        out += string("# TYPE ") + metrics[m] + " " + types[m] + "\n";
+        for (int i = 0; i < SPAN_COUNT; i++) {
+            SpanStats& s = stats.spans[i];
+            out += string(metrics[m]) + "{span=\"" + TRACE_SPAN_NAMES[i] + "\"} ";
+            unsigned long long value = m == 0 ? s.calls.load(memory_order_relaxed)
+                                     : m == 1 ? s.nanos.load(memory_order_relaxed) : s.maxNanos.load(memory_order_relaxed);
+            char text[32];
+            if (m == 0) snprintf(text, sizeof(text), "%llu\n", value);
+            else snprintf(text, sizeof(text), "%llu.%09llu\n", value / 1000000000ULL, value % 1000000000ULL);
+            out += text;
+        }
+    }
+    return out;
+}
+
+void printStats(ostream& out) {
+    TraceStats& stats = traceStats();
+    out << "  === Engine Stats ===" << endl;
+    if (!MINIGIT_TRACE) out << "  (tracing compiled out; build without -DMINIGIT_TRACE=0 to collect)" << endl;
+    out << endl;
+    for (int i = 0; i < SPAN_COUNT; i++) {
+        SpanStats& s = stats.spans[i];
+        unsigned long long calls = s.calls.load(memory_order_relaxed), nanos = s.nanos.load(memory_order_relaxed);
+        string name = string(TRACE_SPAN_NAMES[i]) + ":";
+        name.resize(12, ' ');
+        out << "  " << name << calls << " call(s), " << nanos / 1000 << " us total, "
+            << (calls > 0 ? nanos / calls / 1000 : 0) << " us avg, " << s.maxNanos.load(memory_order_relaxed) / 1000
+            << " us max" << endl;
+    }
+    out << "\n  Hashed:     " << stats.counter(CTR_SHA1_BYTES) << " byte(s) SHA-1 in " << stats.counter(CTR_SHA1_CALLS)
+        << " call(s), " << stats.counter(CTR_FAST_HASH_BYTES) << " byte(s) fast hash in "
+        << stats.counter(CTR_FAST_HASH_CALLS) << " call(s)" << endl;
+    out << "  Snapshots:  " << stats.counter(CTR_SNAPSHOT_COPIES) << " copy-on-write detach(es), "
+        << stats.counter(CTR_SNAPSHOT_BYTES) << " byte(s) copied" << endl;
+    out << "  Objects:    " << stats.counter(CTR_OBJECTS) << " allocated, " << stats.counter(CTR_OBJECT_BYTES)
+        << " byte(s)" << endl;
+    out << "  Lookups:    " << stats.counter(CTR_FILE_LOOKUPS) << " file, " << stats.counter(CTR_BLOB_LOOKUPS) << " blob, "
+        << stats.counter(CTR_COMMIT_LOOKUPS) << " commit" << endl;
+    out << "  Probes/op:  " << averageProbes(stats, CTR_FILE_LOOKUPS, CTR_FILE_PROBES) << " file, "
+        << averageProbes(stats, CTR_BLOB_LOOKUPS, CTR_BLOB_PROBES) << " blob, "
+        << averageProbes(stats, CTR_COMMIT_LOOKUPS, CTR_COMMIT_PROBES) << " commit" << endl;
+}
+
+#endif
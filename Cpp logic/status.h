@@ -0,0 +1,193 @@
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <string_view>
+#include "minigit.h"
+#include "sparse.h"
+using namespace std;
+
+const int STATUS_ADDED = 1;
+const int STATUS_STAGED = 2;
+const int STATUS_MODIFIED = 4;
+const int STATUS_DELETED = 8;
+const int STATUS_UNTRACKED = 16;
+
+class StatusEntry {
+public:
+    string_view name;
+    u64 nameHash;
+    u64 stamp;
+    int flags;
+    int prev;
+    int next;
+};
+
+class StatusIndex {
+private:
+    int* slots;
+    int slotCount;
+    int capacity;
+    int* dirty;
+    int dirtyCount;
+    int dirtyCapacity;
+    bool full;
+    const SparseSet* sparse;
+
+    int find(string_view name, u64 h) {
+        int mask = slotCount - 1;
+        for (int i = (int)(h & mask); slots[i] != 0; i = (i + 1) & mask) {
+            StatusEntry& e = entries[slots[i] - 1];
+            if (e.nameHash == h && e.name == name) return slots[i] - 1;
+        }
+        return -1;
+    }
+
+    int insert(string_view name, u64 h) {
+        if (entryCount == capacity) entries = growArray(entries, entryCount, capacity);
+        if ((entryCount + 1) * 2 > slotCount) {
+            delete[] slots;
+            slotCount *= 2;
+            slots = new int[slotCount]();
+            for (int i = 0; i < entryCount; i++) place(i);
+        }
+        StatusEntry& e = entries[entryCount];
+        e.name = name;
+        e.nameHash = h;
+        e.stamp = 0;
+        e.flags = 0;
+        e.prev = -1;
+        e.next = -1;
+        place(entryCount);
+        return entryCount++;
+    }
+
+    void place(int entry) {
+        int mask = slotCount - 1;
+        int i = (int)(entries[entry].nameHash & mask);
+        while (slots[i] != 0) i = (i + 1) & mask;
+        slots[i] = entry + 1;
+    }
+
+    void link(int entry) {
+        StatusEntry& e = entries[entry];
+        e.prev = -1;
+        e.next = firstChanged;
+        if (firstChanged >= 0) entries[firstChanged].prev = entry;
+        firstChanged = entry;
+    }
+
+    void unlink(int entry) {
+        StatusEntry& e = entries[entry];
+        if (e.prev >= 0) entries[e.prev].next = e.next;
+        else firstChanged = e.next;
+        if (e.next >= 0) entries[e.next].prev = e.prev;
+        e.prev = e.next = -1;
+    }
+
+    void classify(int entry, FileState& work, FileState& staged, FileState* head) {
+        StatusEntry& e = entries[entry];
+        File* w = work.getFile(e.name);
+        File* s = staged.getFile(e.name);
+        File* h = (head != NULL) ? head->getFile(e.name) : NULL;
+        Blob* headBlob = (h != NULL) ? h->blob : NULL;
+        Blob* indexBlob = (s != NULL) ? s->blob : headBlob;
+        Blob* workBlob = (w != NULL) ? w->blob : NULL;
+        if (w == NULL && sparse != NULL && !sparse->matches(e.name)) workBlob = indexBlob;
+
+        int flags = 0;
+        if (indexBlob != headBlob) flags |= (headBlob == NULL) ? STATUS_ADDED : STATUS_STAGED;
+        if (indexBlob == NULL && workBlob != NULL) flags |= STATUS_UNTRACKED;
+        else if (indexBlob != NULL && workBlob == NULL) flags |= STATUS_DELETED;
+        else if (workBlob != indexBlob) flags |= STATUS_MODIFIED;
+
+        if (flags != 0 && e.flags == 0) link(entry);
+        else if (flags == 0 && e.flags != 0) unlink(entry);
+        e.flags = flags;
+        reclassified++;
+    }
+
+    void scan(FileState& files, FileState& work, FileState& staged, FileState* head) {
+        for (File* f = files.first(); f != NULL; f = files.next(f)) {
+            if (find(f->name, f->nameHash) >= 0) continue;
+            classify(insert(f->name, f->nameHash), work, staged, head);
+        }
+    }
+
+    void reset() {
+        entryCount = 0;
+        firstChanged = -1;
+        dirtyCount = 0;
+        for (int i = 0; i < slotCount; i++) slots[i] = 0;
+    }
+
+public:
+    StatusEntry* entries;
+    int entryCount;
+    int firstChanged;
+    u64 generation;
+    u64 scanned;
+    int reclassified;
+
+    StatusIndex() : slotCount(64), capacity(0), dirty(NULL), dirtyCount(0), dirtyCapacity(0), full(true), sparse(NULL),
+                    entries(NULL), entryCount(0), firstChanged(-1), generation(0), scanned(0), reclassified(0) {
+        slots = new int[slotCount]();
+    }
+
+    ~StatusIndex() {
+        delete[] slots;
+        delete[] dirty;
+        delete[] entries;
+    }
+
+    void skipOutside(const SparseSet* set) { sparse = set; }
+
+    void touch(string_view name, u64 nameHash) {
+        if (full) return;
+        generation++;
+        int entry = find(name, nameHash);
+        if (entry < 0) entry = insert(name, nameHash);
+        if (entries[entry].stamp <= scanned) {
+            if (dirtyCount == dirtyCapacity) dirty = growArray(dirty, dirtyCount, dirtyCapacity);
+            dirty[dirtyCount++] = entry;
+        }
+        entries[entry].stamp = generation;
+    }
+
+    void invalidate() {
+        generation++;
+        full = true;
+    }
+
+    void refresh(FileState& work, FileState& staged, FileState* head) {
+        reclassified = 0;
+        if (full) {
+            reset();
+            bool clean = staged.fileCount == 0 &&
+                         (head != NULL ? work.sharesWith(*head) : work.fileCount == 0);
+            if (!clean) {
+                scan(work, work, staged, head);
+                scan(staged, work, staged, head);
+                if (head != NULL) scan(*head, work, staged, head);
+            }
+            full = false;
+        } else {
+            for (int i = 0; i < dirtyCount; i++) classify(dirty[i], work, staged, head);
+        }
+        dirtyCount = 0;
+        scanned = generation;
+    }
+
+    int count(int flag) const {
+        int n = 0;
+        for (int e = firstChanged; e >= 0; e = entries[e].next) {
+            if (entries[e].flags & flag) n++;
+        }
+        return n;
+    }
+
+private:
+    StatusIndex(const StatusIndex&);
+    StatusIndex& operator=(const StatusIndex&);
+};
+
+#endif
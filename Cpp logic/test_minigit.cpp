@@ -1,8 +1,113 @@
 #include <iostream>
 #include <cassert>
+#include <sstream>
+#include <type_traits>
 #include "minigit.h"
+#include "objectstore.h"
+#include "diff.h"
+#include "merge.h"
+#include "status.h"
+#include "tree.h"
+#include "pool.h"
+#include "ingest.h"
+#include "repomanager.h"
+#include "repository.h"
+#include "json.h"
+#include "shell.h"
+#include "journal.h"
+#include "gc.h"
+#include "commitgraph.h"
+#include "stats.h"
+#include "chunker.h"
+#include "sparse.h"
+#include "transfer.h"
 using namespace std;
 
+class CountingVisitor : public TreeVisitor {
+public:
+    int changes;
+
+    CountingVisitor() : changes(0) {}
+
+    void changed(const string& path, Blob* before, Blob* after) {
+        (void)path;
+        (void)before;
+        (void)after;
+        changes++;
+    }
+};
+
+class TallyTask : public ParallelTask {
+public:
+    atomic<int>* hits;
+
+    TallyTask(int n) : hits(new atomic<int>[n]) {
+        for (int i = 0; i < n; i++) hits[i] = 0;
+    }
+
+    ~TallyTask() { delete[] hits; }
+
+    void run(int index) { hits[index]++; }
+};
+
+class CountTask : public ParallelTask {
+public:
+    void run(int index) {
+        (void)index;
+        traceCount(CTR_OBJECTS, 1);
+    }
+};
+
+class CounterRepo {
+public:
+    static atomic<int> live;
+    long long value;
+    atomic<int> writers;
+    bool overlapped;
+
+    CounterRepo() : value(0), writers(0), overlapped(false) { live++; }
+
+    ~CounterRepo() { live--; }
+};
+
+atomic<int> CounterRepo::live(0);
+
+void hammerRepo(RepoManager<CounterRepo>* repos, const string* name, int rounds) {
+    for (int i = 0; i < rounds; i++) {
+        if (i % 4 == 0) {
+            RepoLease<CounterRepo> repo = repos->write(*name);
+            if (++repo->writers > 1) repo->overlapped = true;
+            repo->value++;
+            repo->writers--;
+        } else {
+            RepoLease<CounterRepo> repo = repos->read(*name);
+            if (repo->writers != 0) repo->overlapped = true;
+        }
+    }
+}
+
+void readWhileHeld(RepoManager<CounterRepo>* repos, bool* entered) {
+    RepoLease<CounterRepo> repo = repos->read("shared");
+    *entered = repo.isValid();
+}
+
+void serveOnce(RepoManager<MiniGit>* repos, int listener) { serveOn(*repos, "origin", listener, 1); }
+
+CommitId labelId(const string& label) { return CommitId(generateHash(label)); }
+
+constexpr ObjectId parsedId(string_view hex) {
+    ObjectId id;
+    ObjectId::parse(hex, id);
+    return id;
+}
+
+CommitId hexId(string_view hex) { return CommitId(parsedId(hex)); }
+
+static_assert(parsedId("a9993e364706816aba3e25717850c26c9cd0d89d").prefix() == 0xa9993e364706816aULL,
+              "hex decoding runs at compile time");
+static_assert(!is_convertible<BlobId, CommitId>::value && !is_convertible<ObjectId, TreeId>::value,
+              "typed ids do not convert implicitly");
+
 int tests_passed = 0;
 int tests_total = 0;
 
@@ -21,15 +126,31 @@ int main() {
     cout << "  ========= MiniGit Test Suite =========" << endl << endl;
 
     cout << "  --- Hashing ---" << endl;
-    string h1 = generateHash("hello world");
-    string h2 = generateHash("hello world");
-    string h3 = generateHash("different text");
+    ObjectId h1 = generateHash("hello world");
+    ObjectId h2 = generateHash("hello world");
+    ObjectId h3 = generateHash("different text");
     check(h1 == h2, "Same input -> same hash");
     check(h1 != h3, "Different input -> different hash");
-    check(h1.length() > 0, "Hash is non-empty");
+    check(!h1.isNull(), "Hash is non-empty");
+    check(h1.hex().length() == 40, "Object IDs are 160-bit SHA-1");
+    check(generateHash("abc").hex() == "a9993e364706816aba3e25717850c26c9cd0d89d", "SHA-1 matches known vector");
+    check(generateHash("").hex() == "da39a3ee5e6b4b0d3255bfef95601890afd80709", "SHA-1 of empty input");
+    check(fastHash("") == 0xEF46DB3751D8E999ULL, "Fast hash matches known vector");
+
+    string big = "";
+    for (int i = 0; i < 1000; i++) big += (char)('a' + i % 26);
+    Sha1Hasher streamed;
+    FastHasher streamedFast;
+    for (int i = 0; i < 1000; i += 37) {
+        int n = (1000 - i < 37) ? 1000 - i : 37;
+        streamed.update(big.data() + i, n);
+        streamedFast.update(big.data() + i, n);
+    }
+    check(streamed.id() == generateHash(big), "Streaming SHA-1 matches one-shot");
+    check(streamedFast.digest() == fastHash(big), "Streaming fast hash matches one-shot");
     cout << endl;
 
-    cout << "  --- File Storage (Array) ---" << endl;
+    cout << "  --- File Storage (Hash Index) ---" << endl;
     FileState fs;
     fs.addFile("main.cpp", "#include <iostream>");
     fs.addFile("readme.txt", "Hello");
@@ -39,7 +160,7 @@ int main() {
 
     fs.addFile("main.cpp", "int main() {}");
     check(fs.fileCount == 2, "Update doesn't duplicate");
-    check(fs.getFile("main.cpp")->content == "int main() {}", "Content updated");
+    check(fs.getFile("main.cpp")->content() == "int main() {}", "Content updated");
 
     FileState snapshot = fs.copy();
     check(snapshot.fileCount == 2, "Snapshot deep copy works");
@@ -47,46 +168,129 @@ int main() {
     fs.removeFile("readme.txt");
     check(fs.fileCount == 1, "Remove shrinks array");
     check(snapshot.fileCount == 2, "Snapshot unaffected by remove");
+
+    FileState many;
+    for (int i = 0; i < 5000; i++) many.addFile("file" + to_string(i), to_string(i % 7));
+    check(many.fileCount == 5000, "No fixed cap on file count");
+    check(many.getFile("file4321")->content() == "2", "Indexed lookup among many files");
+    for (int i = 0; i < 5000; i += 2) many.removeFile("file" + to_string(i));
+    check(many.fileCount == 2500 && many.getFile("file10") == NULL, "Bulk remove");
+    check(many.getFile("file4999") != NULL, "Survivors still indexed after compaction");
+    bool ordered = true;
+    int expected = 1;
+    for (File* f = many.first(); f != NULL; f = many.next(f)) {
+        if (f->name != "file" + to_string(expected)) ordered = false;
+        expected += 2;
+    }
+    check(ordered, "Iteration keeps insertion order");
+    cout << endl;
+
+    cout << "  --- Blob Store (Hashing) ---" << endl;
+    BlobStore store;
+    Blob* b1 = store.intern("shared content");
+    Blob* b2 = store.intern("shared content");
+    Blob* b3 = store.intern("other content");
+    check(b1 == b2, "Identical content interned once");
+    check(b1 != b3, "Different content gets its own blob");
+    check(store.blobCount == 2, "Store holds 2 unique blobs");
+    check(store.find(b3->hash) == b3, "Find blob by hash");
+
+    FileState tracked(&store);
+    tracked.addFile("a.txt", "shared content");
+    tracked.addFile("b.txt", "shared content");
+    check(store.blobCount == 2, "Files with same content share a blob");
+    FileState trackedCopy = tracked.copy();
+    check(trackedCopy.getFile("a.txt")->blob == b1, "Snapshot references blob instead of copying");
     cout << endl;
 
     cout << "  --- Commit Tree (Binary Tree) ---" << endl;
-    Commit* c1 = new Commit("abc123", "Initial commit");
-    c1->snapshot = snapshot.copy();
-    check(c1->parent == NULL, "Root has no parent");
-    check(c1->childCount == 0, "Root has no children");
+    Commit* c1 = new Commit(labelId("abc123"), "Initial commit");
+    check(c1->parent() == NULL, "Root has no parent");
+    check(c1->childCount() == 0, "Root has no children");
+
+    Commit* c2 = new Commit(labelId("def456"), "Second commit");
+    c2->addParent(c1);
+    check(c2->parent() == c1, "Child linked to parent");
+    check(c1->childCount() == 1, "Parent has 1 child");
 
-    Commit* c2 = new Commit("def456", "Second commit");
-    c2->parent = c1;
-    c1->children[c1->childCount++] = c2;
-    check(c2->parent == c1, "Child linked to parent");
-    check(c1->childCount == 1, "Parent has 1 child");
+    Commit* c3 = new Commit(labelId("ghi789"), "Branch commit");
+    c3->addParent(c1);
+    check(c1->childCount() == 2, "Parent has 2 children (branching)");
 
-    Commit* c3 = new Commit("ghi789", "Branch commit");
-    c3->parent = c1;
-    c1->children[c1->childCount++] = c3;
-    check(c1->childCount == 2, "Parent has 2 children (branching)");
+    CommitGraph dag;
+    Commit* fanRoot = new Commit(labelId("fan"), "root", &dag);
+    Commit* fan[40];
+    for (int i = 0; i < 40; i++) {
+        fan[i] = new Commit(labelId("fan" + to_string(i)), "leaf", &dag);
+        fan[i]->addParent(fanRoot);
+    }
+    check(fanRoot->childCount() == 40, "Children are not capped");
+    check(findCommit(fanRoot, labelId("fan37")) == fan[37], "DFS reaches every child");
+    Commit* octopus = new Commit(labelId("octopus"), "merge", &dag);
+    for (int i = 0; i < 3; i++) octopus->addParent(fan[i]);
+    check(octopus->parentCount() == 3 && octopus->parent(2) == fan[2], "Commit keeps every parent");
+    check(octopus->generation() == 3, "Generation follows the deepest parent");
+    check(countCommits(octopus) == octopus->generation(), "Commit count reads the cached generation");
+    delete octopus;
+    for (int i = 0; i < 40; i++) delete fan[i];
+    delete fanRoot;
     cout << endl;
 
-    cout << "  --- Custom Stack (Undo/Redo) ---" << endl;
-    CommitStack undoStack;
-    CommitStack redoStack;
-    check(undoStack.isEmpty(), "Stack starts empty");
+    cout << "  --- Undo/Redo Journal ---" << endl;
+    {
+        BranchList journalBranches;
+        journalBranches.addBranch("main", NULL);
+        journalBranches.addBranch("topic", NULL);
+        Branch* mainBranch = journalBranches.first;
+        Branch* topic = mainBranch->next;
+        CommitIndex journalIndex;
+        CommitGraph journalGraph;
+        Commit* steps[300];
+        for (int i = 0; i < 300; i++) {
+            steps[i] = new Commit(labelId("step" + to_string(i)), "step", &journalGraph);
+            journalIndex.add(steps[i]);
+        }
+
+        Journal journal(&journalBranches, &journalIndex, 16 * sizeof(JournalEntry));
+        check(journal.undo() == NULL && journal.undoCount() == 0, "Journal starts empty");
+        journal.record(OP_COMMIT, mainBranch, mainBranch, NULL, steps[0]);
+        journal.record(OP_CHECKOUT, mainBranch, topic, steps[0], NULL);
+        check(journal.undoCount() == 2, "Record increases undo count");
 
-    undoStack.push(c1);
-    undoStack.push(c2);
-    check(undoStack.size() == 2, "Push increases size");
-    check(undoStack.peek() == c2, "Peek returns top");
+        JournalEntry* undone = journal.undo();
+        check(undone->op == OP_CHECKOUT && undone->from == mainBranch && undone->to == topic, "Undo returns newest entry");
+        check(journal.undoCount() == 1 && journal.redoCount() == 1, "Undo moves entry to redo side");
+        check(journal.redo() == undone && journal.redo() == NULL, "Redo returns undone entry");
+        journal.undo();
+        journal.record(OP_MERGE, mainBranch, mainBranch, steps[0], steps[1]);
+        check(journal.redoCount() == 0 && journal.undoCount() == 2, "Record drops redo entries");
 
-    Commit* popped = undoStack.pop();
-    redoStack.push(popped);
-    check(popped == c2, "Pop returns correct item");
-    check(undoStack.size() == 1, "Pop decreases size");
-    check(redoStack.size() == 1, "Redo stack has item");
+        journal.clear();
+        for (int i = 1; i < 300; i++) journal.record(OP_COMMIT, mainBranch, mainBranch, steps[i - 1], steps[i]);
+        check(journal.undoCount() == 299, "Journal keeps history beyond 100 entries");
+        check(journal.spilled() > 0 && journal.inMemory() <= 16, "Journal spills past its memory budget");
+        bool ordered = true;
+        for (int i = 299; i >= 1; i--) {
+            JournalEntry* e = journal.undo();
+            if (e == NULL || e->after != steps[i] || e->before != steps[i - 1] || e->to != mainBranch) ordered = false;
+        }
+        check(ordered && journal.undo() == NULL, "Spilled entries reload in order");
+        check(journal.spilled() == 0 && journal.redoCount() == 299, "Reloaded entries can be redone");
 
-    Commit* redone = redoStack.pop();
-    undoStack.push(redone);
-    check(redone == c2, "Redo pops correct item");
-    check(undoStack.size() == 2, "Undo stack restored");
+        journal.clear();
+        for (int i = 1; i <= 40; i++) {
+            Branch* b = i <= 18 ? topic : mainBranch;
+            journal.record(OP_COMMIT, b, b, steps[i - 1], steps[i]);
+        }
+        int beforeDelete = journal.undoCount();
+        journalBranches.deleteBranch("topic");
+        journal.refresh();
+        int expected = journal.undoCount(), undoable = 0;
+        while (journal.undo() != NULL) undoable++;
+        check(beforeDelete == 40 && expected == 22 && undoable == expected && journal.undoCount() == 0,
+              "Undo count skips spilled entries whose branch is gone");
+        for (int i = 0; i < 300; i++) delete steps[i];
+    }
     cout << endl;
 
     cout << "  --- Branch List (Linked List) ---" << endl;
@@ -106,6 +310,20 @@ int main() {
     bl.deleteBranch("feature");
     check(bl.count() == 1, "Delete removes branch");
     check(bl.findBranch("feature") == NULL, "Deleted branch gone");
+    for (int i = 0; i < 5000; i++) bl.addBranch("feature/ci-" + to_string(i), c2);
+    bl.addBranch("feature", c3);
+    bl.addBranch("featureless", c3);
+    check(bl.count() == 5003 && bl.findBranch("feature/ci-4321")->head == c2, "Hash index resolves thousands of branches");
+    check(bl.deleteBranch("feature/ci-17") && bl.findBranch("feature/ci-17") == NULL && bl.count() == 5002,
+          "Delete unlinks indexed branch");
+    Branch** under;
+    int matched = bl.sorted(under, "feature");
+    check(matched == 5000 && under[0]->name == "feature" && under[1]->name == "feature/ci-0", "Prefix listing stops at components");
+    delete[] under;
+    check(validRefName("feature/x") && validRefName("release/1.2"), "Hierarchical names are valid");
+    check(!validRefName("a//b") && !validRefName("/a") && !validRefName("a/") && !validRefName("a..b")
+          && !validRefName("HEAD") && !validRefName("x.lock") && !validRefName("a b") && !validRefName("a/.b"),
+          "Malformed ref names rejected");
     cout << endl;
 
     cout << "  --- Recursion (History Traversal) ---" << endl;
@@ -117,22 +335,1209 @@ int main() {
 
     int depth0 = countCommits(NULL);
     check(depth0 == 0, "countCommits returns 0 for NULL");
+
+    Commit* chain[5000];
+    for (int i = 0; i < 5000; i++) {
+        chain[i] = new Commit(labelId("deep" + to_string(i)), "m");
+        if (i > 0) chain[i]->addParent(chain[i - 1]);
+    }
+    check(countCommits(chain[4999]) == 5000, "Deep history counted without recursion");
+    check(chain[4999]->generation() == 5000, "Generation number cached on commit");
+    check(findCommit(chain[0], labelId("deep4999")) == chain[4999], "DFS find walks deep history without recursion");
+    ostringstream logOut;
+    LogOptions page;
+    page.maxCount = 3;
+    page.skip = 10;
+    check(printHistory(chain[4999], logOut, page) == 3, "log -n limits output");
+    check(logOut.str().find(chain[4989]->commitId.hex()) != string::npos
+          && logOut.str().find(chain[4990]->commitId.hex()) == string::npos,
+          "log --skip starts past skipped commits");
+    LogOptions future;
+    future.since = time(0) + 3600;
+    check(printHistory(chain[4999], logOut, future) == 0, "log --since stops at older commits");
+    Commit* forkRoot = new Commit(labelId("fork root"), "A");
+    Commit* newSide = new Commit(labelId("fork new"), "S");
+    Commit* oldSide = new Commit(labelId("fork old"), "B");
+    Commit* forkMerge = new Commit(labelId("fork merge"), "M");
+    oldSide->addParent(forkRoot);
+    newSide->addParent(forkRoot);
+    forkMerge->addParent(oldSide);
+    forkMerge->addParent(newSide);
+    forkRoot->time = oldSide->time = 1000;
+    LogOptions recent;
+    recent.since = 2000;
+    ostringstream forkOut;
+    check(printHistory(forkMerge, forkOut, recent) == 2 && forkOut.str().find(newSide->commitId.hex()) != string::npos,
+          "log --since keeps newer commits behind an older merge parent");
+    delete forkMerge;
+    delete newSide;
+    delete oldSide;
+    delete forkRoot;
+    for (int i = 0; i < 5000; i++) delete chain[i];
     cout << endl;
 
     cout << "  --- Backtracking (DFS Find) ---" << endl;
-    Commit* found = findCommit(c1, "ghi789");
+    Commit* found = findCommit(c1, labelId("ghi789"));
     check(found == c3, "DFS finds c3 by ID");
 
-    Commit* found2 = findCommit(c1, "abc123");
+    Commit* found2 = findCommit(c1, labelId("abc123"));
     check(found2 == c1, "DFS finds root by ID");
 
-    Commit* notFound = findCommit(c1, "zzz000");
+    Commit* notFound = findCommit(c1, labelId("zzz000"));
     check(notFound == NULL, "DFS returns NULL for missing");
 
-    Commit* hist = findInHistory(c2, "abc123");
+    Commit* hist = findInHistory(c2, labelId("abc123"));
     check(hist == c1, "findInHistory walks parent chain");
     cout << endl;
 
+    cout << "  --- Commit Index (Hash Map) ---" << endl;
+    CommitIndex index;
+    Commit* ids[300];
+    for (int i = 0; i < 300; i++) {
+        ids[i] = new Commit(labelId("commit " + to_string(i)), "c");
+        index.add(ids[i]);
+    }
+    check(index.count == 300, "Index holds 300 commits");
+    check(index.find(ids[123]->commitId) == ids[123], "Exact ID lookup");
+    check(index.find(generateHash("missing")) == NULL, "Unknown ID not found");
+    bool ambiguous = false;
+    string abbrev = index.abbreviate(ids[42]->commitId);
+    check(abbrev.length() >= 7 && abbrev.length() < 40, "Abbreviation is short");
+    check(index.resolve(abbrev, ambiguous) == ids[42] && !ambiguous, "Abbreviated ID resolves");
+    check(index.resolve("", ambiguous) == NULL, "Empty prefix rejected");
+    Commit* twinA = new Commit(hexId("fedcba" + string(34, '1')), "a");
+    Commit* twinB = new Commit(hexId("fedcba" + string(34, '2')), "b");
+    index.add(twinA);
+    index.add(twinB);
+    check(index.resolve("fedcba", ambiguous) == NULL && ambiguous, "Ambiguous prefix is reported");
+    check(index.resolve("fedcba2", ambiguous) == twinB, "Longer prefix disambiguates");
+    check(index.abbreviate(twinA->commitId) == "fedcba1", "Abbreviation grows past shared prefix");
+    delete twinA;
+    delete twinB;
+    for (int i = 0; i < 300; i++) delete ids[i];
+    cout << endl;
+
+    cout << "  --- Object Store (Pack + Index) ---" << endl;
+    char dirTemplate[] = "/tmp/minigit-test-XXXXXX";
+    string dir = mkdtemp(dirTemplate);
+    BlobStore diskBlobs;
+    TreeStore diskTrees(&diskBlobs);
+    Blob* stored = diskBlobs.intern("persisted content");
+    Commit* diskCommit = new Commit(labelId("disk commit"), "Saved to disk");
+    FileState diskFiles(&diskBlobs);
+    diskFiles.putBlob("notes.txt", stored);
+    diskCommit->tree = diskTrees.build(diskFiles);
+    {
+        ObjectStore objects;
+        check(objects.open(dir), "Create pack in empty directory");
+        check(objects.write(OBJ_BLOB, stored->hash, stored->fast, stored->content()), "Append blob");
+        check(!objects.write(OBJ_BLOB, stored->hash, stored->fast, stored->content()), "Duplicate object not appended");
+        storeTree(objects, diskCommit->tree);
+        objects.write(OBJ_COMMIT, diskCommit->commitId, 0, encodeCommit(diskCommit));
+        check(objects.has(diskCommit->commitId), "Pending object visible before index flush");
+    }
+    {
+        ObjectStore objects;
+        objects.open(dir);
+        check(objects.objectCount() == 3, "Index reloaded from disk");
+        int type;
+        u64 fast, size;
+        const char* data;
+        check(objects.read(diskCommit->commitId, type, fast, data, size) && type == OBJ_COMMIT, "Read commit record");
+        BlobStore reloaded;
+        TreeStore reloadedTrees(&reloaded);
+        string parentIds;
+        Commit* back = decodeCommit(diskCommit->commitId, data, size, objects, reloaded, parentIds,
+                                    sharedCommitGraph(), NULL, &reloadedTrees);
+        check(back != NULL && back->message == "Saved to disk" && parentIds.empty(), "Commit decodes");
+        Blob* note = (back != NULL) ? lookupPath(back->tree, "notes.txt") : NULL;
+        check(note != NULL && note->content() == "persisted content", "Blob content round-trips");
+        check(note != NULL && note->mapped != NULL, "Loaded blob reads from the mapping");
+        string legacy;
+        putU64(legacy, 0);
+        putU32(legacy, 0);
+        putBytes(legacy, "Legacy");
+        putU32(legacy, 1);
+        putBytes(legacy, "docs/notes.txt");
+        putId(legacy, stored->hash);
+        Commit* old = decodeCommit(labelId("legacy"), legacy.data(), legacy.size(), objects, reloaded, parentIds,
+                                   sharedCommitGraph(), NULL, &reloadedTrees);
+        check(old != NULL && old->tree->fileCount == 1 && lookupPath(old->tree, "docs/notes.txt") == note,
+              "Legacy file-list commit decodes into a tree");
+        delete old;
+        delete back;
+        objects.destroy();
+    }
+    {
+        ObjectStore objects;
+        objects.open(dir);
+        BlobStore grownBlobs;
+        string payload(64 * 1024, 'x');
+        Blob* first = NULL;
+        bool readable = true;
+        for (int i = 0; i < 400; i++) {
+            string body = payload + to_string(i);
+            BlobId id(generateHash(body));
+            objects.write(OBJ_BLOB, id, fastHash(body), body);
+            Blob* b = loadBlob(id, objects, grownBlobs);
+            if (i == 0) first = b;
+            if (b == NULL || b->content() != body) readable = false;
+        }
+        check(readable && objects.mappingCount() <= 6, "Growing pack keeps a logarithmic number of mappings");
+        objects.retireMappings(grownBlobs);
+        check(objects.mappingCount() == 1 && first->content() == payload + "0", "Retired mappings re-point loaded blobs");
+        objects.destroy();
+    }
+    delete diskCommit;
+    cout << endl;
+
+    cout << "  --- Delta Compression ---" << endl;
+    string baseText = "";
+    for (int i = 0; i < 2000; i++) baseText += "config line " + to_string(i) + "\n";
+    string editedText = baseText;
+    editedText.replace(editedText.find("line 1000"), 9, "line 1000 changed");
+    string delta = createDelta(baseText, editedText);
+    string rebuilt;
+    check(delta.length() < editedText.length() / 20, "One-line edit yields a small delta");
+    check(applyDelta(baseText, delta, rebuilt) && rebuilt == editedText, "Delta reconstructs target");
+    check(!applyDelta(editedText, delta, rebuilt), "Delta rejects wrong base");
+    string unrelated = createDelta("short", "completely different content");
+    check(applyDelta("short", unrelated, rebuilt) && rebuilt == "completely different content", "Insert-only delta");
+
+    char deltaTemplate[] = "/tmp/minigit-test-XXXXXX";
+    string deltaDir = mkdtemp(deltaTemplate);
+    BlobStore versions;
+    Blob* v1 = versions.intern(baseText);
+    Blob* v2 = versions.intern(editedText);
+    {
+        ObjectStore objects;
+        objects.open(deltaDir);
+        storeBlob(objects, v1, NULL);
+        u64 before = objects.packBytes();
+        storeBlob(objects, v2, v1);
+        check(objects.packBytes() - before < editedText.length() / 10, "Second version stored as delta");
+        check(objects.deltaDepth(v2->hash) == 1, "Delta chain depth recorded");
+    }
+    {
+        ObjectStore objects;
+        objects.open(deltaDir);
+        BlobStore lazy;
+        Blob* loaded = loadBlob(v2->hash, objects, lazy);
+        check(loaded != NULL && loaded->isDelta(), "Delta blob loads lazily");
+        check(loaded != NULL && loaded->content() == editedText && !loaded->isDelta(), "Lazy delta reconstructs on read");
+        objects.destroy();
+    }
+    cout << endl;
+
+    cout << "  --- Line Diff (Myers) ---" << endl;
+    LineDiff lineDiff;
+    lineDiff.compute("a\nb\nc\nd\ne", "a\nb\nX\nd\ne\nf");
+    check(lineDiff.added == 2 && lineDiff.removed == 1, "Minimal edit script");
+    ostringstream hunks;
+    lineDiff.writeUnified(hunks, "a/x", "b/x");
+    check(hunks.str().find("@@ -1,5 +1,6 @@") != string::npos, "Unified hunk header");
+    check(hunks.str().find("  -c\n  +X\n") != string::npos, "Hunk shows replaced line");
+    LineDiff same;
+    same.compute("one\ntwo", "one\ntwo");
+    ostringstream none;
+    same.writeUnified(none, "a/x", "b/x");
+    check(same.added == 0 && same.removed == 0 && none.str().empty(), "Identical text has no hunks");
+    string manyOld = "", manyNew = "";
+    for (int i = 0; i < 3000; i++) {
+        manyOld += to_string(i) + "\n";
+        manyNew += to_string((i * 7) % 3000) + "\n";
+    }
+    LineDiff heavy;
+    heavy.compute(manyOld, manyNew);
+    int equalLines = 0;
+    for (int i = 0; i < heavy.script.count; i++) {
+        if (heavy.script.ops[i].kind == DIFF_EQUAL) equalLines++;
+    }
+    check(equalLines + heavy.removed == 3000 && equalLines + heavy.added == 3000, "Patience fallback covers every line");
+    cout << endl;
+
+    cout << "  --- Three-way Merge ---" << endl;
+    Commit* mb = new Commit(labelId("b000"), "base");
+    Commit* mo1 = new Commit(labelId("b001"), "ours 1");
+    Commit* mo2 = new Commit(labelId("b002"), "ours 2");
+    Commit* mt1 = new Commit(labelId("b003"), "theirs 1");
+    mo1->addParent(mb);
+    mo2->addParent(mo1);
+    mt1->addParent(mb);
+    check(mergeBase(mo2, mt1) == mb, "Merge base of diverged branches");
+    check(mergeBase(mo2, mb) == mb, "Merge base of ancestor is ancestor");
+    Commit* mm = new Commit(labelId("b005"), "merge", mo2->graph);
+    mm->addParent(mo2);
+    mm->addParent(mt1);
+    Commit* mt2 = new Commit(labelId("b006"), "theirs 2");
+    mt2->addParent(mt1);
+    check(mergeBase(mm, mt2) == mt1, "Merge parent moves the base forward");
+    Commit* lone = new Commit(labelId("b004"), "unrelated");
+    check(mergeBase(mo2, lone) == NULL, "Unrelated histories have no base");
+    string merged;
+    check(mergeText("a\nb\nc\nd\n", "A\nb\nc\nd\n", "a\nb\nc\nD\n", "ours", "theirs", merged)
+          && merged == "A\nb\nc\nD\n", "Disjoint edits merge cleanly");
+    check(mergeText("a\nb\n", "a\nX\n", "a\nX\n", "ours", "theirs", merged) && merged == "a\nX\n",
+          "Identical edits merge cleanly");
+    check(!mergeText("a\nb\nc\n", "a\nX\nc\n", "a\nY\nc\n", "ours", "theirs", merged)
+          && merged == "a\n<<<<<<< ours\nX\n=======\nY\n>>>>>>> theirs\nc\n", "Overlapping edits leave markers");
+    BlobStore mergeBlobs;
+    FileState baseTree(&mergeBlobs), oursTree(&mergeBlobs), theirsTree(&mergeBlobs);
+    baseTree.addFile("keep.txt", "same");
+    baseTree.addFile("gone.txt", "old");
+    baseTree.addFile("both.txt", "1\n2\n3\n4\n");
+    oursTree = baseTree.copy();
+    theirsTree = baseTree.copy();
+    oursTree.addFile("both.txt", "one\n2\n3\n4\n");
+    theirsTree.addFile("both.txt", "1\n2\n3\nfour\n");
+    theirsTree.removeFile("gone.txt");
+    theirsTree.addFile("new.txt", "fresh");
+    TreeMerge treeMerge(&mergeBlobs);
+    treeMerge.run(&baseTree, oursTree, theirsTree, "ours", "theirs");
+    check(treeMerge.conflicts == 0 && treeMerge.autoMerged == 1, "Only files changed on both sides are merged");
+    check(treeMerge.result.getFile("keep.txt")->blob == baseTree.getFile("keep.txt")->blob, "Unchanged file resolved by hash");
+    check(treeMerge.result.getFile("gone.txt") == NULL, "Deletion on one side carried over");
+    check(treeMerge.result.getFile("new.txt") != NULL, "Addition on one side carried over");
+    check(treeMerge.result.getFile("both.txt")->content() == "one\n2\n3\nfour\n", "Line merge combines both edits");
+    delete mb;
+    delete mo1;
+    delete mo2;
+    delete mt1;
+    delete mm;
+    delete mt2;
+    delete lone;
+    cout << endl;
+
+    cout << "  --- Arena Allocator ---" << endl;
+    {
+        Arena arena(1024);
+        CommitGraph arenaGraph;
+        Commit* prev = NULL;
+        for (int i = 0; i < 200; i++) {
+            Commit* c = arena.create<Commit>(labelId("arena" + to_string(i)), "m", &arenaGraph);
+            c->addParent(prev);
+            prev = c;
+        }
+        check(arena.objectCount == 200 && countCommits(prev) == 200, "Commits bump-allocated from arena");
+        check(arena.chunkCount < 200, "Many commits share each chunk");
+        BranchList arenaBranches(&arena);
+        arenaBranches.addBranch("main", prev);
+        arenaBranches.addBranch("topic", prev);
+        arenaBranches.deleteBranch("topic");
+        check(arenaBranches.count() == 1 && arena.objectCount == 202, "Branch nodes owned by arena");
+        double* aligned = arena.create<double>(1.5);
+        check(((size_t)aligned % alignof(double)) == 0 && *aligned == 1.5, "Allocations are aligned");
+        arena.release();
+        check(arena.objectCount == 0 && arena.chunkCount == 0 && arenaGraph.commits[0] == NULL,
+              "Release destroys every object at once");
+    }
+    cout << endl;
+
+    cout << "  --- Copy-on-Write Snapshots ---" << endl;
+    {
+        BlobStore cowBlobs;
+        FileState tree(&cowBlobs);
+        for (int i = 0; i < 10000; i++) tree.addFile("dir/file" + to_string(i), "v" + to_string(i % 50));
+        FileState view = tree.copy();
+        check(view.sharesWith(tree) && view.fileCount == 10000, "Copy shares the tree instead of cloning");
+        FileState second = view;
+        view.addFile("dir/file7", "edited");
+        check(!view.sharesWith(tree) && second.sharesWith(tree), "Write detaches only the writer");
+        check(tree.getFile("dir/file7")->content() == "v7" && view.getFile("dir/file7")->content() == "edited",
+              "Original tree untouched by the write");
+        view.addFile("dir/file8", "v8");
+        check(view.getFile("dir/file8")->blob == tree.getFile("dir/file8")->blob, "Unchanged entries keep shared blobs");
+        second.clear();
+        check(second.fileCount == 0 && tree.fileCount == 10000, "Clearing a view leaves the shared tree");
+        view.removeFile("dir/file9");
+        check(view.getFile("dir/file9") == NULL && tree.getFile("dir/file9") != NULL, "Removal is private to the view");
+        FileState rewritten = tree;
+        rewritten.addFile("dir/file3", "v3");
+        check(rewritten.sharesWith(tree), "Writing the same blob does not detach");
+    }
+    cout << endl;
+
+    cout << "  --- Incremental Status ---" << endl;
+    {
+        BlobStore statusBlobs;
+        FileState headTree(&statusBlobs);
+        for (int i = 0; i < 2000; i++) headTree.addFile("f" + to_string(i), "body" + to_string(i));
+        FileState work = headTree, staged(&statusBlobs);
+        StatusIndex status;
+        status.refresh(work, staged, &headTree);
+        check(status.firstChanged < 0 && status.reclassified == 0, "Checkout of HEAD is clean without a scan");
+
+        work.addFile("f10", "edited");
+        File* edited = work.getFile("f10");
+        status.touch(edited->name, edited->nameHash);
+        work.addFile("notes.txt", "new");
+        File* fresh = work.getFile("notes.txt");
+        status.touch(fresh->name, fresh->nameHash);
+        staged.addFile("f20", "staged");
+        work.addFile("f20", "staged");
+        File* stagedFile = staged.getFile("f20");
+        status.touch(stagedFile->name, stagedFile->nameHash);
+        status.refresh(work, staged, &headTree);
+        check(status.reclassified == 3, "Only touched entries are rechecked");
+        check(status.count(STATUS_MODIFIED) == 1 && status.count(STATUS_UNTRACKED) == 1
+              && status.count(STATUS_STAGED) == 1, "Entries classified against HEAD");
+
+        status.refresh(work, staged, &headTree);
+        check(status.reclassified == 0 && status.count(STATUS_MODIFIED) == 1, "Repeated status does no work");
+
+        work.addFile("f10", "body10");
+        status.touch(edited->name, edited->nameHash);
+        status.refresh(work, staged, &headTree);
+        check(status.count(STATUS_MODIFIED) == 0, "Reverting an edit makes the entry clean");
+
+        status.invalidate();
+        status.refresh(work, staged, &headTree);
+        check(status.count(STATUS_UNTRACKED) == 1 && status.count(STATUS_STAGED) == 1,
+              "Full rescan after HEAD change agrees");
+    }
+    cout << endl;
+
+    cout << "  --- Tree Objects ---" << endl;
+    {
+        BlobStore treeBlobs;
+        TreeStore trees(&treeBlobs);
+        FileState left(&treeBlobs);
+        for (int i = 0; i < 500; i++) left.addFile("vendor/lib/file" + to_string(i) + ".c", "code" + to_string(i));
+        left.addFile("src/main.cpp", "int main() {}");
+        left.addFile("README", "hello");
+        FileState right = left.copy();
+        right.addFile("src/main.cpp", "int main() { return 1; }");
+
+        Tree* a = trees.build(left);
+        Tree* b = trees.build(right);
+        check(a != b && a->hash != b->hash && a->fileCount == 502, "Root trees differ by content hash");
+        check(a->find("vendor")->tree == b->find("vendor")->tree, "Identical subdirectory is one shared tree");
+        check(trees.build(left) == a, "Rebuilding the same state yields the same tree");
+
+        CountingVisitor counter;
+        diffTrees(a, b, counter);
+        check(counter.changes == 1, "Diff prunes identical subtrees");
+
+        ChangeList edit;
+        edit.push("vendor/lib/file7.c", treeBlobs.intern("patched"));
+        Tree* c = trees.update(b, edit);
+        check(c->find("src")->tree == b->find("src")->tree && c->find("vendor")->tree != b->find("vendor")->tree,
+              "Incremental update rebuilds only the changed path");
+        FileState rebuilt = right.copy();
+        rebuilt.addFile("vendor/lib/file7.c", "patched");
+        check(trees.build(rebuilt) == c, "Incremental and full builds agree");
+
+        ChangeList removal;
+        removal.push("src/main.cpp", NULL);
+        Tree* d = trees.update(c, removal);
+        check(d->find("src") == NULL && d->fileCount == 501, "Emptied directory is dropped");
+
+        ChangeList nested;
+        nested.push("README/notes.txt", treeBlobs.intern("nested"));
+        ChangeList clash;
+        clash.push("docs", treeBlobs.intern("file"));
+        clash.push("docs/guide.txt", treeBlobs.intern("guide"));
+        check(trees.update(d, nested) == NULL && trees.conflict == "README" && trees.update(NULL, clash) == NULL
+              && trees.conflict == "docs", "File and directory with the same name are rejected");
+        ChangeList replace;
+        replace.push("README", NULL);
+        replace.push("README/notes.txt", treeBlobs.intern("nested"));
+        Tree* e = trees.update(d, replace);
+        check(e != NULL && e->find("README")->tree != NULL && e->fileCount == 501, "Removed file can become a directory");
+        ChangeList sorted;
+        sorted.push("a.b/x", treeBlobs.intern("1"));
+        sorted.push("a/y", treeBlobs.intern("2"));
+        sorted.push("a-c", treeBlobs.intern("3"));
+        Tree* f = trees.update(NULL, sorted);
+        FileState flat(&treeBlobs);
+        flat.addFile("a/y", "2");
+        flat.addFile("a-c", "3");
+        flat.addFile("a.b/x", "1");
+        check(f != NULL && f->count == 3 && f->entries[0].name == "a" && f->entries[1].name == "a-c"
+              && f->entries[2].name == "a.b" && trees.build(flat) == f, "Tree entries stay sorted by name");
+        {
+            MiniGit repo;
+            ostringstream out;
+            ConsoleCapture capture(out);
+            repo.init();
+            repo.add("lib", "file");
+            repo.commit("file");
+            repo.add("lib/x.c", "nested");
+            check(!repo.commit("nested") && repo.activeBranch()->head->message == "file"
+                  && out.str().find("'lib' would be both a file and a directory") != string::npos,
+                  "Commit refuses a path that is both a file and a directory");
+        }
+
+        FileState theirs = left.copy();
+        theirs.addFile("README", "hello there");
+        TreeMerge pruned(&treeBlobs, &trees);
+        pruned.run(a, b, trees.build(theirs), right, "ours", "theirs");
+        check(pruned.conflicts == 0 && pruned.changes.count == 1 && pruned.subtreesVisited == 1,
+              "Merge walks only directories changed on both sides");
+        check(pruned.result.getFile("README")->content() == "hello there"
+              && pruned.result.getFile("src/main.cpp")->content() == "int main() { return 1; }",
+              "Merged state combines both sides");
+        check(pruned.resultTree == trees.build(pruned.result), "Merge result tree matches its files");
+
+        char treeTemplate[] = "/tmp/minigit-tree-XXXXXX";
+        ObjectStore objects;
+        objects.open(mkdtemp(treeTemplate));
+        check(storeTree(objects, c), "Store tree objects");
+        int before = objects.objectCount();
+        storeTree(objects, b);
+        check(objects.objectCount() - before == 4, "Only trees and blobs missing from the pack are written");
+        BlobStore loadedBlobs;
+        TreeStore loadedTrees(&loadedBlobs);
+        Tree* back = loadTree(c->hash, objects, loadedBlobs, loadedTrees);
+        check(back != NULL && back->hash == c->hash && back->fileCount == c->fileCount, "Tree round-trips through the pack");
+        objects.destroy();
+    }
+    cout << endl;
+
+    cout << "  --- Parallel Ingestion ---" << endl;
+    {
+        WorkStealingPool pool(4);
+        TallyTask tally(10000);
+        check(pool.run(tally, 10000) == 4, "Pool runs on the requested workers");
+        bool once = true;
+        for (int i = 0; i < 10000; i++) once = once && tally.hits[i] == 1;
+        check(once, "Every task runs exactly once");
+
+        char ingestTemplate[] = "/tmp/minigit-ingest-XXXXXX";
+        string root = mkdtemp(ingestTemplate);
+        mkdir((root + "/src").c_str(), 0755);
+        for (int i = 0; i < 200; i++) {
+            string path = root + (i % 2 ? "/src/f" : "/f") + to_string(i);
+            FILE* out = fopen(path.c_str(), "w");
+            fprintf(out, "line %d\n", i % 50);
+            fclose(out);
+        }
+        IngestBatch parallel, serial;
+        parallel.collect(root);
+        serial.collect(root);
+        WorkStealingPool single(1);
+        parallel.hashAll(pool);
+        serial.hashAll(single);
+        bool same = parallel.count == 200 && serial.count == 200;
+        for (int i = 0; same && i < parallel.count; i++) {
+            same = parallel.items[i].name == serial.items[i].name && parallel.items[i].hash == serial.items[i].hash
+                   && parallel.items[i].hash == generateHash(parallel.items[i].content);
+        }
+        check(same, "Parallel hashing matches serial order and digests");
+        bool sorted = true;
+        for (int i = 1; i < parallel.count; i++) sorted = sorted && parallel.items[i - 1].name < parallel.items[i].name;
+        check(sorted, "Ingested files ordered by name");
+        check(IngestBatch::repoName("./src/a.txt") == "src/a.txt", "Leading ./ stripped from staged names");
+
+        BlobStore ingestBlobs;
+        for (int i = 0; i < parallel.count; i++) {
+            IngestItem& item = parallel.items[i];
+            ingestBlobs.intern(item.content, item.hash, item.fast);
+        }
+        check(ingestBlobs.blobCount == 50, "Duplicate contents share one blob");
+
+        char packTemplate[] = "/tmp/minigit-pwrite-XXXXXX";
+        ObjectStore objects;
+        objects.open(mkdtemp(packTemplate));
+        string text;
+        for (int i = 0; i < 400; i++) text += "shared line " + to_string(i) + "\n";
+        Blob* v1 = ingestBlobs.intern(text);
+        Blob* v2 = ingestBlobs.intern(text + "appended\n");
+        storeBlob(objects, v1, NULL);
+        BlobWriter writer(objects);
+        writer.changed("doc.txt", v1, v2);
+        writer.changed("copy.txt", NULL, v2);
+        check(writer.flush(pool) && objects.deltaDepth(v2->hash) == 1, "Deltas computed in parallel are written once");
+        objects.destroy();
+
+        for (int i = 0; i < 200; i++) unlink((root + (i % 2 ? "/src/f" : "/f") + to_string(i)).c_str());
+        rmdir((root + "/src").c_str());
+        rmdir(root.c_str());
+    }
+    cout << endl;
+
+    cout << "  --- Repository Manager ---" << endl;
+    {
+        RepoManager<CounterRepo> repos;
+        for (int i = 0; i < 100; i++) repos.insert("repo" + to_string(i), new CounterRepo());
+        check(repos.count() == 100 && repos.contains("repo99"), "No fixed cap on repositories");
+        CounterRepo* duplicate = new CounterRepo();
+        check(!repos.insert("repo5", duplicate), "Duplicate name rejected");
+        delete duplicate;
+        check(!repos.read("missing").isValid(), "Unknown repository gives an empty lease");
+
+        repos.insert("shared", new CounterRepo());
+        bool entered = false;
+        {
+            RepoLease<CounterRepo> held = repos.read("shared");
+            thread reader(readWhileHeld, &repos, &entered);
+            reader.join();
+        }
+        check(entered, "Readers share a repository");
+
+        string name = "shared";
+        thread workers[4];
+        for (int t = 0; t < 4; t++) workers[t] = thread(hammerRepo, &repos, &name, 2000);
+        for (int t = 0; t < 4; t++) workers[t].join();
+        {
+            RepoLease<CounterRepo> repo = repos.read("shared");
+            check(repo->value == 2000 && !repo->overlapped, "Writers serialize against readers and each other");
+        }
+
+        int before = CounterRepo::live;
+        {
+            RepoLease<CounterRepo> doomed = repos.detach("repo42");
+            check(doomed.isValid() && !repos.contains("repo42"), "Detached repository is unlisted");
+            check(CounterRepo::live == before, "Detached repository lives until its lease ends");
+        }
+        check(CounterRepo::live == before - 1 && repos.count() == 100, "Detached repository freed");
+        string* names;
+        int listed = repos.names(names);
+        check(listed == 100 && names[0] == "repo0" && names[listed - 1] == "shared", "Listing keeps creation order");
+        delete[] names;
+    }
+    cout << endl;
+
+    cout << "  --- Embedded Engine ---" << endl;
+    {
+        JsonWriter json;
+        json.beginObject().field("name", "a\"b\n").key("list").beginArray().value(1).value(true).null().endArray();
+        json.field("ok", false).endObject();
+        check(json.out == "{\"name\":\"a\\\"b\\n\",\"list\":[1,true,null],\"ok\":false}", "JSON writer escapes and separates");
+
+        char engineTemplate[] = "/tmp/minigit-engine-XXXXXX";
+        string root = mkdtemp(engineTemplate);
+        RepoManager<MiniGit> repos;
+        ostringstream text;
+        {
+            ConsoleCapture capture(text);
+            check(createRepository(repos, root, "demo"), "Library creates repository");
+            check(!createRepository(repos, root, "demo"), "Library rejects duplicate repository");
+            RepoLease<MiniGit> git = repos.write("demo");
+            check(!git->commit("early"), "Commands report failure before init");
+            check(git->init() && git->add("a.txt", "one") && git->diff("a.txt"),
+                  "Diff of a file before the first commit succeeds");
+            check(git->commit("first"), "Commands report success");
+            check(git->add("b.txt", "two") && git->diff("b.txt") && !git->diff("c.txt"),
+                  "Diff of a file missing from the last commit succeeds");
+            git->add("a.txt", "one\nmore");
+            LineDiff hunks;
+            DiffHunk hunk;
+            int at = 0;
+            check(git->diff("a.txt", &hunks) && hunks.added == 1 && hunks.nextHunk(at, hunk) && hunk.newCount == 2
+                  && hunks.marker(hunk.end - 1) == '+' && hunks.line(hunk.end - 1) == "more"
+                  && text.str().find("+more") == string::npos, "Diff hands back hunks instead of printing them");
+            check(!git->checkout("missing"), "Missing branch reports failure");
+            for (int i = 0; i < 100; i++) git->branch("ci/run-" + to_string(i));
+            check(!git->branch("ci//bad") && git->checkout("ci/run-7"), "Hierarchical branches created");
+        }
+        check(text.str().find("Created and switched to repository: demo") != string::npos, "Console output is captured");
+        ostringstream later;
+        {
+            ConsoleCapture capture(later);
+            RepoManager<MiniGit> reopened;
+            check(openRepositories(reopened, root) == 1, "Library reopens stored repositories");
+            RepoLease<MiniGit> git = reopened.read("demo");
+            check(git->isInitialized() && git->activeBranch()->head->message == "first", "Reopened repository keeps history");
+            struct stat packedRefs;
+            check(git->branchList().count() == 101 && git->activeBranch()->name == "ci/run-7"
+                  && stat((root + "/demo/packed-refs").c_str(), &packedRefs) == 0, "Packed and loose refs reload");
+            check(deleteRepository(repos, "demo") && repos.count() == 0, "Library deletes repository");
+        }
+        rmdir(root.c_str());
+    }
+    cout << endl;
+
+    cout << "  --- Batch Shell ---" << endl;
+    {
+        Tokenizer tokens("  add  notes.txt  two  words\r");
+        check(tokens.next() == "add" && tokens.next() == "notes.txt", "Tokenizer splits on whitespace");
+        check(tokens.rest() == " two  words", "Tokenizer keeps the rest of the line");
+        check(commandTable().find("checkout").id == CMD_CHECKOUT && commandTable().find("quit").id == CMD_EXIT
+              && commandTable().find("checkou").id == CMD_UNKNOWN, "Command table resolves names");
+        check(commandTable().find("log").reading && !commandTable().find("commit").reading, "Command table marks reads");
+
+        char shellTemplate[] = "/tmp/minigit-shell-XXXXXX";
+        string root = mkdtemp(shellTemplate);
+        RepoManager<MiniGit> repos;
+        Shell shell(repos, root);
+        ostringstream out;
+        int lines;
+        {
+            ConsoleCapture capture(out);
+            lines = shell.runBatch("repo create demo\ninit\n# comment\nadd a.txt hello world\ncommit first\n"
+                                   "bogus\nexit\nadd b.txt never\n");
+        }
+        RepoLease<MiniGit> git = repos.read("demo");
+        check(lines == 7 && shell.activeName == "demo", "Batch stops at exit");
+        check(git->activeBranch()->head != NULL && git->working().getFile("b.txt") == NULL, "Batch runs commands in order");
+        check(git->working().getFile("a.txt")->content() == "hello world", "Batch passes content verbatim");
+        check(out.str().find("Unknown command: bogus") != string::npos && out.str().find("Goodbye!") != string::npos,
+              "Batch output is buffered");
+        git->destroyStorage();
+        rmdir(root.c_str());
+    }
+    cout << endl;
+
+    cout << "  --- Garbage Collection ---" << endl;
+    {
+        char gcTemplate[] = "/tmp/minigit-gc-XXXXXX";
+        string root = mkdtemp(gcTemplate);
+        RepoManager<MiniGit> repos;
+        ostringstream out;
+        ConsoleCapture capture(out);
+        createRepository(repos, root, "gc");
+        RepoLease<MiniGit> git = repos.write("gc");
+        git->init();
+        git->add("a.txt", string(4000, 'a'));
+        git->commit("keep");
+        Commit* kept = git->activeBranch()->head;
+        git->add("a.txt", string(4000, 'z'));
+        git->commit("drop");
+        Commit* droppedCommit = git->activeBranch()->head;
+        CommitId dropped = droppedCommit->commitId;
+        git->undo();
+        git->add("b.txt", "bee");
+        git->commit("tip");
+        CommitId tip = git->activeBranch()->head->commitId;
+
+        check(git->gc() && git->gcState().prunedCommits == 1 && git->gcState().liveCommits == 2,
+              "GC prunes commit dropped from redo journal");
+        check(git->commits().find(dropped) == NULL && git->commits().find(tip) != NULL, "Pruned commit leaves the index");
+        check(git->gcState().freedBlobs == 1 && git->gcState().freedTrees == 1, "GC frees the pruned commit's blob and tree");
+        check(git->gcState().bytesAfter < git->gcState().bytesBefore, "Repack shrinks the pack");
+        check(lookupPath(kept->tree, "a.txt")->content() == string(4000, 'a')
+              && git->working().getFile("b.txt")->content() == "bee", "Live blobs stay readable after repack");
+
+        for (int i = 0; i < 300; i++) git->add("f" + to_string(i) + ".txt", "file " + to_string(i));
+        git->commit("many");
+        check(git->activeBranch()->head == droppedCommit && git->activeBranch()->head->parent()->commitId == tip,
+              "New commit reuses a pruned commit");
+        git->add("e.txt", "discarded");
+        git->commit("discarded");
+        git->undo();
+        git->add("c.txt", "sea");
+        git->commit("after undo");
+        check(git->gc(true, 0) && git->gcPending(), "Incremental GC stops at slice budget");
+        git->add("d.txt", "dee");
+        git->add("e.txt", "discarded");
+        git->commit("during gc");
+        CommitId during = git->activeBranch()->head->commitId;
+        int slices = 1;
+        while (git->gcPending() && slices < 100000) {
+            git->gcSlice(0);
+            slices++;
+        }
+        check(!git->gcPending() && slices > 2 && git->gcState().prunedCommits == 1, "Incremental GC finishes in slices");
+
+        ObjectStore pack;
+        pack.open(root + "/gc");
+        check(!pack.has(dropped) && pack.has(tip) && pack.has(during), "Repacked store keeps only reachable commits");
+        pack.close();
+        RepoManager<MiniGit> reopened;
+        openRepositories(reopened, root);
+        RepoLease<MiniGit> again = reopened.read("gc");
+        check(again->activeBranch()->head->commitId == during && again->working().getFile("d.txt")->content() == "dee"
+              && again->working().getFile("f7.txt")->content() == "file 7", "Repository reopens after GC");
+        check(again->working().getFile("e.txt") != NULL && again->working().getFile("e.txt")->content() == "discarded",
+              "Commit made during GC keeps a blob the GC had pruned");
+        struct stat graphFile;
+        check(stat((root + "/gc/commit-graph").c_str(), &graphFile) == 0 && graphFile.st_size > 20, "GC writes commit-graph file");
+        git->destroyStorage();
+        rmdir(root.c_str());
+    }
+    {
+        MiniGit repo;
+        ostringstream out;
+        ConsoleCapture capture(out);
+        repo.init();
+        for (int i = 0; i < 200; i++) {
+            repo.add("f.txt", "version " + to_string(i));
+            repo.commit("v" + to_string(i));
+        }
+        repo.add("junk.txt", "junk");
+        repo.commit("junk");
+        repo.undo();
+        repo.add("b.txt", "bee");
+        repo.commit("tip");
+        check(repo.gc(true, 0) && repo.gcState().phase == GC_COMMITS, "Incremental GC slices commit marking");
+        repo.add("during.txt", "new");
+        repo.commit("during");
+        Commit* during = repo.activeBranch()->head;
+        int sweepSlices = 0;
+        while (repo.gcPending()) {
+            if (repo.gcState().phase == GC_SWEEP) sweepSlices++;
+            repo.gcSlice(0);
+        }
+        check(repo.commits().find(during->commitId) == during && repo.gcState().prunedCommits == 1,
+              "Commit made during marking survives the prune");
+        check(sweepSlices > 1 && repo.working().getFile("during.txt")->content() == "new", "Incremental GC slices the sweep");
+    }
+    {
+        MiniGit repo;
+        ostringstream out;
+        ConsoleCapture capture(out);
+        repo.init();
+        repo.add("a", "hello");
+        repo.commit("first");
+        repo.add("a", "world");
+        repo.commit("second");
+        Commit* undone = repo.activeBranch()->head;
+        repo.undo();
+        repo.add("a", "world");
+        repo.commit("second");
+        Commit* head = repo.activeBranch()->head;
+        check(head->commitId != undone->commitId || head == undone, "Identical re-commit reuses the undone commit");
+        check(repo.commits().find(head->commitId) == head, "Re-committed head stays in the index");
+        repo.gc();
+        check(repo.commits().find(head->commitId) == head && repo.revert(head->commitId.hex()),
+              "Revert finds the re-committed head after GC");
+        CommitIndex index;
+        Commit* original = new Commit(labelId("twin"), "a");
+        Commit* twin = new Commit(labelId("twin"), "b");
+        check(index.add(original) && index.add(original) && !index.add(twin) && index.find(twin->commitId) == original,
+              "Index rejects a different commit with a colliding ID");
+        delete original;
+        delete twin;
+    }
+    cout << endl;
+
+    cout << "  --- Commit Graph ---" << endl;
+    {
+        u64 filter[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 25; i++) bloomAdd(filter, 4, fastHash("path" + to_string(i)));
+        bool present = true;
+        int falsePositives = 0;
+        for (int i = 0; i < 25; i++) present = present && bloomTest(filter, 4, fastHash("path" + to_string(i)));
+        for (int i = 0; i < 1000; i++) falsePositives += bloomTest(filter, 4, fastHash("other" + to_string(i)));
+        check(present && falsePositives < 50, "Bloom filter has no false negatives and few false positives");
+
+        MiniGit repo;
+        ostringstream out;
+        ConsoleCapture capture(out);
+        repo.init();
+        Commit* first = NULL;
+        for (int i = 0; i < 60; i++) {
+            repo.add("f" + to_string(i % 6) + ".txt", "rev " + to_string(i));
+            if (i % 10 == 3) repo.add("docs/target.txt", "target " + to_string(i));
+            repo.commit("c" + to_string(i));
+            if (first == NULL) first = repo.activeBranch()->head;
+        }
+        Commit* head = repo.activeBranch()->head;
+        u64 key = fastHash("docs/target.txt");
+        int maybe = 0, touching = 0;
+        for (HistoryIterator it(head); Commit* c = it.next(); ) {
+            maybe += c->graph->mayChange(c->node, key);
+            touching += touchesPath(c, "docs/target.txt", key);
+        }
+        check(touching == 6 && maybe < 12, "Path filters skip most commits");
+
+        LogOptions opts;
+        opts.path = "docs/target.txt";
+        ostringstream logged;
+        check(printHistory(head, logged, opts) == 6 && logged.str().find("Msg:    c53") != string::npos
+              && logged.str().find("Msg:    c54") == string::npos, "log <file> lists only commits touching it");
+        opts.skip = 2;
+        opts.maxCount = 1;
+        ostringstream paged;
+        check(printHistory(head, paged, opts) == 1 && paged.str().find("Msg:    c33") != string::npos,
+              "log <file> pages over matching commits");
+        check(isAncestor(first, head) && !isAncestor(head, first) && isAncestor(head, head), "Ancestry uses generations");
+
+        string encoded = encodeCommitGraph(repo.commits());
+        for (int i = 0; i < repo.commits().count; i++) {
+            Commit* c = repo.commits().at(i);
+            c->graph->bloomWords[c->node] = BLOOM_UNKNOWN;
+        }
+        int reloaded = loadCommitGraph(encoded, repo.commits());
+        ostringstream again;
+        check(reloaded == 60 && printHistory(head, again, opts) == 1 && again.str() == paged.str(),
+              "Commit-graph file round-trips filters");
+        check(loadCommitGraph(encoded.substr(0, encoded.length() - 1), repo.commits()) == 0,
+              "Truncated commit-graph is ignored");
+    }
+    cout << endl;
+
+    cout << "  --- Engine Stats ---" << endl;
+    {
+        traceStats().reset();
+        MiniGit repo;
+        ostringstream out;
+        {
+            ConsoleCapture capture(out);
+            repo.init();
+            repo.add("a.txt", "alpha");
+            repo.commit("first");
+            repo.branch("topic");
+            repo.checkout("topic");
+            repo.add("a.txt", "beta");
+            repo.commit("second");
+            repo.checkout("main");
+            repo.merge("topic");
+            repo.status();
+            repo.diff("a.txt");
+        }
+        TraceStats& stats = traceStats();
+        check(stats.spans[SPAN_COMMIT].calls == 2 && stats.spans[SPAN_CHECKOUT].calls == 2
+              && stats.spans[SPAN_MERGE].calls == 1 && stats.spans[SPAN_STATUS].calls == 1
+              && stats.spans[SPAN_DIFF].calls == 1, "Spans count each traced command");
+        check(stats.spans[SPAN_COMMIT].nanos >= stats.spans[SPAN_COMMIT].maxNanos && stats.spans[SPAN_COMMIT].maxNanos > 0,
+              "Spans accumulate elapsed time");
+        check(stats.counter(CTR_SHA1_BYTES) >= 9 && stats.counter(CTR_SHA1_CALLS) >= 4, "Counters track bytes hashed");
+        check(stats.counter(CTR_FILE_LOOKUPS) > 0 && stats.counter(CTR_FILE_PROBES) >= stats.counter(CTR_FILE_LOOKUPS)
+              && stats.counter(CTR_COMMIT_LOOKUPS) > 0, "Counters track lookup probes");
+        check(stats.counter(CTR_OBJECTS) >= 5 && stats.counter(CTR_SNAPSHOT_COPIES) > 0, "Counters track allocations and copies");
+
+        JsonWriter json;
+        json.beginObject();
+        writeStatsJson(json);
+        json.endObject();
+        check(json.out.find("\"merge\":{\"calls\":1,") != string::npos, "Stats dump as JSON");
+        string prom = statsPrometheus();
+        check(prom.find("minigit_span_calls_total{span=\"commit\"} 2\n") != string::npos
+              && prom.find("# TYPE minigit_sha1_bytes_total counter") != string::npos, "Stats dump as Prometheus text");
+        stats.reset();
+        check(stats.counter(CTR_SHA1_BYTES) == 0 && stats.spans[SPAN_COMMIT].calls == 0, "Stats reset");
+
+        WorkStealingPool workers(4);
+        CountTask counting;
+        int blocksBefore = stats.blockCount();
+        for (int round = 0; round < 20; round++) workers.run(counting, 64);
+        check(stats.counter(CTR_OBJECTS) == 20 * 64 && stats.blockCount() <= blocksBefore + 4,
+              "Exited worker threads hand their counter blocks to later ones");
+        stats.reset();
+    }
+    cout << endl;
+
+    cout << "  --- Chunked Blobs ---" << endl;
+    {
+        string big(4 * 1024 * 1024, '\0');
+        u64 seed = 12345;
+        for (size_t i = 0; i < big.length(); i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            big[i] = (char)(seed >> 56);
+        }
+        bool bounded = true;
+        int cuts = 0;
+        for (size_t pos = 0; pos < big.length(); cuts++) {
+            size_t cut = cutPoint(big.data() + pos, big.length() - pos);
+            bounded = bounded && cut <= CHUNK_MAX_SIZE && (cut >= CHUNK_MIN_SIZE || pos + cut == big.length());
+            pos += cut;
+        }
+        check(bounded && cuts > 16 && cuts < 256, "Cut points stay within chunk size bounds");
+
+        BlobStore pieces;
+        string baseText(300, 'b'), editedText = string(150, 'b') + "edit" + string(150, 'b');
+        Blob* original = pieces.intern(baseText);
+        string patch = createDelta(baseText, editedText);
+        Blob* patched = pieces.adoptDelta(BlobId(generateHash(editedText)), fastHash(editedText), original, patch.data(),
+                                         patch.length(), editedText.length());
+        Blob* parts[2] = {patched, pieces.intern("tail")};
+        Blob* spliced = pieces.adoptChunks(BlobId(generateHash(editedText + "tail")), fastHash(editedText + "tail"), parts, 2,
+                                          editedText.length() + 4);
+        check(spliced->content() == editedText + "tail" && !patched->isDelta(), "Chunk join resolves delta chunks");
+
+        char chunkTemplate[] = "/tmp/minigit-chunk-XXXXXX";
+        string root = mkdtemp(chunkTemplate);
+        string work = root + "/big.bin";
+        string name = IngestBatch::repoName(work);
+        FILE* file = fopen(work.c_str(), "wb");
+        fwrite(big.data(), 1, big.length(), file);
+        fclose(file);
+
+        RepoManager<MiniGit> repos;
+        ostringstream out;
+        ConsoleCapture capture(out);
+        createRepository(repos, root, "chunks");
+        RepoLease<MiniGit> git = repos.write("chunks");
+        git->init();
+        git->addPaths(&work, 1);
+        git->commit("big file");
+        Blob* first = git->working().getFile(name)->blob;
+        check(first->isChunked() && first->size == big.length() && first->content() == big,
+              "Large file streams into chunks and joins back");
+
+        string edited = big.substr(0, 2000000) + "inserted in the middle" + big.substr(2000000);
+        file = fopen(work.c_str(), "wb");
+        fwrite(edited.data(), 1, edited.length(), file);
+        fclose(file);
+        unsigned long long hashedBefore = traceStats().counter(CTR_SHA1_BYTES);
+        git->addPaths(&work, 1);
+        unsigned long long hashed = traceStats().counter(CTR_SHA1_BYTES) - hashedBefore;
+        Blob* second = git->working().getFile(name)->blob;
+        check(second != first && sharedChunks(first, second) >= second->chunkCount - 2,
+              "Mid-file edit reuses unchanged chunks");
+        check(hashed > 0 && hashed <= 2 * CHUNK_MAX_SIZE, "Only changed chunks are SHA-1 hashed");
+        git->commit("edit");
+
+        string copy = root + "/copy.bin";
+        string roundtrip;
+        check(git->exportFile(name, copy) && IngestBatch::readWhole(copy, roundtrip) && roundtrip == edited,
+              "Export streams chunks back to disk");
+        git->add("same.bin", edited);
+        check(git->working().getFile("same.bin")->blob == second, "In-memory content chunks to the same blob");
+        git->gc();
+
+        RepoManager<MiniGit> reopened;
+        openRepositories(reopened, root);
+        RepoLease<MiniGit> again = reopened.read("chunks");
+        Blob* loaded = again->working().getFile(name)->blob;
+        check(loaded->isChunked() && loaded->hash == second->hash && loaded->content() == edited,
+              "Chunked blob reloads from pack after GC");
+        git->destroyStorage();
+        unlink(work.c_str());
+        unlink(copy.c_str());
+        rmdir(root.c_str());
+    }
+    cout << endl;
+
+    cout << "  --- Sparse Checkout ---" << endl;
+    {
+        SparseSet set;
+        set.add("src/");
+        set.add("./*.txt");
+        set.add("lib/*/*.h");
+        check(set.matches("src/a.h") && set.matches("src/deep/b.cpp") && set.matches("top.txt")
+              && set.matches("lib/x/y.h"), "Sparse patterns match directories and globs");
+        check(!set.matches("docs/top.txt") && !set.matches("lib/x/y.cpp") && !set.matches("srcx/a.h")
+              && !set.matches("src"), "Sparse patterns reject other paths");
+        check(set.mayContain("src") && set.mayContain("src/deep") && set.mayContain("lib") && set.mayContain("lib/x")
+              && !set.mayContain("docs") && !set.mayContain("lib/x/z"), "Directory pruning follows patterns");
+
+        MiniGit repo;
+        ostringstream out;
+        ConsoleCapture capture(out);
+        repo.init();
+        repo.add("src/main.cpp", "main");
+        repo.add("src/util.h", "util");
+        for (int i = 0; i < 50; i++) repo.add("vendor/lib" + to_string(i) + ".c", "vendored " + to_string(i));
+        repo.commit("base");
+        string patterns[1] = {"src/"};
+        check(repo.setSparse(patterns, 1, true) && repo.working().fileCount == 2
+              && repo.working().getFile("vendor/lib3.c") == NULL, "Sparse set keeps only matching files");
+        out.str("");
+        repo.status();
+        check(out.str().find("working tree clean (2 file(s))") != string::npos, "Status ignores files outside the sparse set");
+
+        repo.add("src/util.h", "util v2");
+        repo.commit("edit inside");
+        Commit* head = repo.activeBranch()->head;
+        check(head->tree->fileCount == 52 && lookupPath(head->tree, "vendor/lib7.c")->content() == "vendored 7"
+              && repo.working().fileCount == 2, "Sparse commit keeps files outside the set");
+
+        repo.branch("topic");
+        repo.checkout("topic");
+        check(repo.working().fileCount == 2, "Checkout materializes only the sparse set");
+        repo.add("vendor/lib1.c", "patched");
+        repo.commit("outside edit");
+        repo.checkout("main");
+        repo.merge("topic");
+        check(lookupPath(repo.activeBranch()->head->tree, "vendor/lib1.c")->content() == "patched"
+              && repo.working().getFile("vendor/lib1.c") == NULL, "Merge carries changes outside the sparse set");
+
+        repo.write("src/main.cpp", "unstaged");
+        check(!repo.setSparse(NULL, 0, true), "Sparse change refused with unstaged edits");
+        repo.add("src/main.cpp", "unstaged");
+        check(repo.setSparse(NULL, 0, true) && repo.working().fileCount == 52
+              && repo.working().getFile("src/main.cpp")->content() == "unstaged", "Disabling sparse restores every file");
+
+        char sparseTemplate[] = "/tmp/minigit-sparse-XXXXXX";
+        string root = mkdtemp(sparseTemplate);
+        {
+            RepoManager<MiniGit> repos;
+            createRepository(repos, root, "sparse");
+            RepoLease<MiniGit> git = repos.write("sparse");
+            git->init();
+            git->add("a/one.txt", "1");
+            git->add("b/two.txt", "2");
+            git->commit("two dirs");
+            string keep[1] = {"a/"};
+            git->setSparse(keep, 1, true);
+        }
+        RepoManager<MiniGit> reopened;
+        openRepositories(reopened, root);
+        {
+            RepoLease<MiniGit> again = reopened.write("sparse");
+            check(again->working().fileCount == 1 && again->working().getFile("a/one.txt") != NULL,
+                  "Sparse patterns persist across reopen");
+            again->destroyStorage();
+        }
+        rmdir(root.c_str());
+    }
+    cout << endl;
+
+    cout << "  --- Object IDs ---" << endl;
+    {
+        ObjectId known = parsedId("A9993E364706816ABA3E25717850C26C9CD0D89D");
+        ObjectId bad;
+        check(known == generateHash("abc") && known.hex() == "a9993e364706816aba3e25717850c26c9cd0d89d",
+              "Hex parse round-trips either case");
+        check(!ObjectId::parse("a9993e364706816aba3e25717850c26c9cd0d89", bad)
+              && !ObjectId::parse("g9993e364706816aba3e25717850c26c9cd0d89d", bad) && bad.isNull(),
+              "Short or non-hex IDs are rejected");
+        ostringstream printed;
+        printed << BlobId(known);
+        check(printed.str() == known.hex() && known.abbrev(7) == "a9993e3", "IDs stream and abbreviate as hex");
+        check(known.compareHex("a9993e") == 0 && known.compareHex("a9994") < 0 && known.commonNibbles(generateHash("")) == 0,
+              "Prefix comparison works on raw bytes");
+        unsigned char header[RECORD_HEADER_SIZE];
+        encodeRecordHeader(header, OBJ_TREE, known, 7, 1234);
+        check(header[0] == OBJ_TREE && ObjectId::fromRaw(header + 1) == known && readU64(header + 21) == 7
+              && readU64(header + 29) == 1234, "Record header has a fixed layout");
+        BlobStore idBlobs;
+        Blob* blob = idBlobs.intern("typed");
+        check(blob->hash == BlobId(generateHash("typed")) && idBlobs.find(blob->hash) == blob, "Blob IDs index the store");
+        string journalLine;
+        blob->hash.appendHex(journalLine);
+        check(journalLine == blob->hash.hex(), "appendHex writes in place");
+    }
+    cout << endl;
+
+    cout << "  --- Commit Pipeline ---" << endl;
+    {
+        char pipeTemplate[] = "/tmp/minigit-pipe-XXXXXX";
+        string root = mkdtemp(pipeTemplate);
+        string script = "repo create burst\ninit\n";
+        for (int i = 0; i < 40; i++) script += "add f" + to_string(i % 5) + ".txt rev " + to_string(i) + "\ncommit c" + to_string(i) + "\n";
+        script += "sync\nstatus\n";
+        ostringstream out;
+        {
+            ConsoleCapture capture(out);
+            RepoManager<MiniGit> repos;
+            Shell shell(repos, root);
+            shell.runBatch(script);
+            RepoLease<MiniGit> git = repos.write("burst");
+            git->add("undone.txt", "x");
+            git->commit("undone");
+            git->undo();
+        }
+        check(out.str().find("40 commit(s) durable in ") != string::npos, "sync waits for every queued commit");
+        check(out.str().find("Durable:    40 of 40 commit(s)") != string::npos, "status reports durable commits");
+        RepoManager<MiniGit> reopened;
+        openRepositories(reopened, root);
+        RepoLease<MiniGit> again = reopened.read("burst");
+        check(again->activeBranch()->head->message == "c39" && countCommits(again->activeBranch()->head) == 40
+              && again->working().getFile("f4.txt")->content() == "rev 39", "Burst of commits reopens intact");
+        check(again->working().getFile("undone.txt") == NULL && again->activeBranch()->head->parent()->message == "c38",
+              "Ref updates stay ordered behind queued commits");
+        again->destroyStorage();
+        ostringstream racing;
+        {
+            ConsoleCapture capture(racing);
+            RepoManager<MiniGit> repos;
+            Shell shell(repos, root);
+            string burst = "repo create racer\ninit\n";
+            for (int i = 0; i < 20; i++) burst += "add r.txt v" + to_string(i) + "\ncommit r" + to_string(i) + "\nstatus\n";
+            shell.runBatch(burst);
+            repos.write("racer")->destroyStorage();
+        }
+        check(racing.str().find("Pack:       ") != string::npos, "Status reads pack counters while commits are being written");
+        rmdir(root.c_str());
+    }
+    cout << endl;
+
+    cout << "  --- Clone and Fetch ---" << endl;
+    {
+        char cloneTemplate[] = "/tmp/minigit-clone-XXXXXX";
+        string root = mkdtemp(cloneTemplate);
+        string script = "repo create origin\ninit\n";
+        for (int i = 0; i < 12; i++) script += "add src/f" + to_string(i % 4) + ".txt v" + to_string(i) + "\ncommit c" + to_string(i) + "\n";
+        script += "branch dev\ncheckout dev\nadd notes.txt draft\ncommit notes\ncheckout main\nclone origin copy\n";
+        ostringstream out, fetched, net;
+        RepoManager<MiniGit> repos;
+        Shell shell(repos, root);
+        {
+            ConsoleCapture capture(out);
+            shell.runBatch(script);
+        }
+        {
+            RepoLease<MiniGit> origin = repos.read("origin");
+            RepoLease<MiniGit> copy = repos.read("copy");
+            check(copy.isValid() && copy->activeBranch()->name == "main"
+                      && copy->activeBranch()->head->commitId == origin->activeBranch()->head->commitId
+                      && countCommits(copy->activeBranch()->head) == 12,
+                  "Clone reproduces history with identical ids");
+            check(copy->working().getFile("src/f3.txt")->content() == "v11" && copy->working().fileCount == 4
+                      && copy->branchList().findBranch("dev")->head->message == "notes",
+                  "Clone checks out the head and copies every branch");
+            Commit* head = origin->activeBranch()->head;
+            string treeRecord = encodeTree(head->tree);
+            string commitRecord = encodeCommit(head);
+            check(commitRecordId(commitRecord) == head->commitId && verifyTreeRecord(head->tree->hash, treeRecord),
+                  "Commit and tree ids are the hashes of their records");
+            treeRecord[treeRecord.length() - 1] ^= 1;
+            commitRecord[commitRecord.length() - 1] ^= 1;
+            check(!verifyTreeRecord(head->tree->hash, treeRecord) && commitRecordId(commitRecord) != head->commitId,
+                  "Tampered tree and commit records fail verification");
+        }
+        {
+            ConsoleCapture capture(fetched);
+            shell.runBatch("repo switch origin\nadd src/f0.txt v12\ncommit c12\nrepo switch copy\nfetch origin\nfetch origin\n");
+        }
+        {
+            RepoLease<MiniGit> copy = repos.read("copy");
+            Branch* tracking = copy->branchList().findBranch("origin/main");
+            check(tracking != NULL && tracking->head->message == "c12" && copy->activeBranch()->head->message == "c11",
+                  "Fetch records remote heads under <remote>/ without moving local branches");
+        }
+        check(fetched.str().find("Fetched 1 new commit(s) from origin: 4 object(s)") != string::npos,
+              "Fetch sends only the objects the receiver lacks");
+        check(fetched.str().find("Already up to date with origin.") != string::npos, "Repeated fetch negotiates nothing");
+
+        int port = 0;
+        int listener = listenOn(0, port);
+        thread server(serveOnce, &repos, listener);
+        {
+            ConsoleCapture capture(net);
+            shell.runBatch("clone 127.0.0.1:" + to_string(port) + " remote\n");
+        }
+        server.join();
+        ::close(listener);
+        {
+            RepoLease<MiniGit> remote = repos.read("remote");
+            check(remote.isValid() && remote->activeBranch()->head->message == "c12"
+                      && remote->working().getFile("src/f0.txt")->content() == "v12",
+                  "Clone over a socket matches the served repo");
+        }
+        {
+            RepoManager<MiniGit> reopened;
+            openRepositories(reopened, root);
+            RepoLease<MiniGit> copy = reopened.read("copy");
+            Branch* tracking = copy->branchList().findBranch("origin/main");
+            check(tracking != NULL && tracking->head->message == "c12" && countCommits(tracking->head) == 13,
+                  "Fetched objects and refs survive a reopen");
+        }
+        string large(3 * CHUNK_THRESHOLD, '\0');
+        for (size_t i = 0; i < large.length(); i++) large[i] = (char)((i * 2654435761u) >> 13);
+        ostringstream chunked;
+        {
+            ConsoleCapture capture(chunked);
+            RepoLease<MiniGit> origin = repos.write("origin");
+            origin->add("big.bin", large);
+            origin->commit("big");
+        }
+        {
+            ConsoleCapture capture(chunked);
+            shell.runBatch("clone origin big\nrepo switch copy\nfetch origin\n");
+        }
+        {
+            RepoLease<MiniGit> big = repos.read("big");
+            File* file = big.isValid() ? big->working().getFile("big.bin") : NULL;
+            check(file != NULL && file->blob->isChunked() && file->content() == large, "Clone sends chunked blobs");
+            RepoLease<MiniGit> copy = repos.read("copy");
+            Branch* tracking = copy->branchList().findBranch("origin/main");
+            check(tracking != NULL && tracking->head->message == "big" && chunked.str().find("failed") == string::npos,
+                  "Fetch sends chunked blobs");
+        }
+        static const char* names[] = {"origin", "copy", "remote", "big"};
+        for (int i = 0; i < 4; i++) {
+            RepoLease<MiniGit> doomed = repos.detach(names[i]);
+            if (doomed.isValid()) doomed->destroyStorage();
+        }
+        rmdir(root.c_str());
+    }
+    cout << endl;
+
     cout << "  =======================================" << endl;
     cout << "  Results: " << tests_passed << " / " << tests_total << " passed" << endl;
     if (tests_passed == tests_total)
@@ -0,0 +1,339 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "minigit.h"
+#include "tree.h"
+#include "objectstore.h"
+#include "gc.h"
+using namespace std;
+
+const u32 TRANSFER_VERSION = 1;
+const size_t TRANSFER_BUFFER_SIZE = 64 * 1024;
+const u32 TRANSFER_MAX_REFS = 1 << 20;
+const u32 TRANSFER_MAX_HAVES = 4096;
+const u32 TRANSFER_MAX_NAME = 4096;
+const u64 TRANSFER_MAX_OBJECT = 1ULL << 30;
+
+class FdStream {
+private:
+    int fd;
+    char* out;
+    size_t outUsed;
+    char* in;
+    size_t inStart;
+    size_t inEnd;
+    Sha1Hasher hasher;
+    bool hashing;
+
+    FdStream(const FdStream&);
+    FdStream& operator=(const FdStream&);
+
+public:
+    bool ok;
+    u64 bytesIn;
+    u64 bytesOut;
+
+    FdStream(int f)
+        : fd(f), out(new char[TRANSFER_BUFFER_SIZE]), outUsed(0), in(new char[TRANSFER_BUFFER_SIZE]), inStart(0),
+          inEnd(0), hashing(false), ok(true), bytesIn(0), bytesOut(0) {}
+
+    ~FdStream() {
+        delete[] out;
+        delete[] in;
+    }
+
+    void beginHash() {
+        hasher = Sha1Hasher();
+        hashing = true;
+    }
+
+    ObjectId endHash() {
+        hashing = false;
+        return hasher.id();
+    }
+
+    bool flush() {
+        size_t sent = 0;
+        while (ok && sent < outUsed) {
+            ssize_t n = ::send(fd, out + sent, outUsed - sent, MSG_NOSIGNAL);
+            if (n <= 0) ok = false;
+            else sent += (size_t)n;
+        }
+        outUsed = 0;
+        return ok;
+    }
+
+    void write(const char* data, size_t n) {
+        if (hashing) hasher.update(data, n);
+        bytesOut += n;
+        while (ok && n > 0) {
+            if (outUsed == TRANSFER_BUFFER_SIZE) flush();
+            size_t take = TRANSFER_BUFFER_SIZE - outUsed;
+            if (take > n) take = n;
+            memcpy(out + outUsed, data, take);
+            outUsed += take;
+            data += take;
+            n -= take;
+        }
+    }
+
+    void write(string_view data) { write(data.data(), data.length()); }
+
+    void writeU32(u32 v) {
+        unsigned char b[4];
+        for (int i = 0; i < 4; i++) b[i] = (unsigned char)((v >> (i * 8)) & 0xff);
+        write((const char*)b, 4);
+    }
+
+    void writeId(const ObjectId& id) { write((const char*)id.bytes, ID_BYTES); }
+
+    void writeBytes(string_view data) {
+        writeU32((u32)data.length());
+        write(data);
+    }
+
+    bool read(char* data, size_t n) {
+        while (ok && n > 0) {
+            if (inStart == inEnd) {
+                ssize_t got = ::recv(fd, in, TRANSFER_BUFFER_SIZE, 0);
+                if (got <= 0) {
+                    ok = false;
+                    break;
+                }
+                inStart = 0;
+                inEnd = (size_t)got;
+            }
+            size_t take = inEnd - inStart;
+            if (take > n) take = n;
+            memcpy(data, in + inStart, take);
+            if (hashing) hasher.update(data, take);
+            bytesIn += take;
+            inStart += take;
+            data += take;
+            n -= take;
+        }
+        return ok;
+    }
+
+    bool readU32(u32& v) {
+        unsigned char b[4];
+        if (!read((char*)b, 4)) return false;
+        v = ::readU32(b);
+        return true;
+    }
+
+    bool readId(ObjectId& id) { return read((char*)id.bytes, ID_BYTES); }
+
+    bool readBytes(string& text, u32 limit) {
+        u32 n;
+        if (!readU32(n) || n > limit) return ok = false;
+        text.assign(n, '\0');
+        return n == 0 || read(&text[0], n);
+    }
+
+    bool expect(const char* magic) {
+        char got[4];
+        if (!read(got, 4) || memcmp(got, magic, 4) != 0) return ok = false;
+        u32 version;
+        if (!readU32(version) || version != TRANSFER_VERSION) return ok = false;
+        return true;
+    }
+
+    void begin(const char* magic) {
+        write(magic, 4);
+        writeU32(TRANSFER_VERSION);
+    }
+};
+
+int missingCommits(CommitGraph* g, Commit** wants, int wantCount, Commit** haves, int haveCount, Commit**& out) {
+    const unsigned char WANTED = 1, COMMON = 2, QUEUED = 4;
+    unsigned char* flags = new unsigned char[g->nodeCount > 0 ? g->nodeCount : 1]();
+    GenerationQueue queue(g);
+    int wantOnly = 0;
+    for (int i = 0; i < haveCount; i++) {
+        int node = haves[i]->node;
+        if (flags[node] & QUEUED) continue;
+        flags[node] = COMMON | QUEUED;
+        queue.push(node);
+    }
+    for (int i = 0; i < wantCount; i++) {
+        int node = wants[i]->node;
+        if (flags[node] & QUEUED) continue;
+        flags[node] = WANTED | QUEUED;
+        queue.push(node);
+        wantOnly++;
+    }
+
+    int count = 0, capacity = 16;
+    out = new Commit*[capacity];
+    while (!queue.isEmpty() && wantOnly > 0) {
+        int node = queue.pop();
+        unsigned char side = flags[node] & (WANTED | COMMON);
+        if (!(side & COMMON)) {
+            wantOnly--;
+            if (count == capacity) out = growArray(out, count, capacity);
+            out[count++] = g->commits[node];
+        }
+        for (int i = 0; i < g->parentCounts[node]; i++) {
+            int p = g->parent(node, i);
+            unsigned char before = flags[p];
+            flags[p] |= side | QUEUED;
+            if (!(before & QUEUED)) {
+                queue.push(p);
+                if (!(side & COMMON)) wantOnly++;
+            } else if (!(before & COMMON) && (side & COMMON)) {
+                wantOnly--;
+            }
+        }
+    }
+    delete[] flags;
+    reverse(out, out + count);
+    return count;
+}
+
+class PackEntry {
+public:
+    Commit* commit;
+    Tree* tree;
+    Blob* blob;
+
+    PackEntry() : commit(NULL), tree(NULL), blob(NULL) {}
+};
+
+class PackBuilder {
+private:
+    IdSet sent;
+
+    PackBuilder(const PackBuilder&);
+    PackBuilder& operator=(const PackBuilder&);
+
+    PackEntry& push() {
+        if (count == capacity) entries = growArray(entries, count, capacity);
+        entries[count] = PackEntry();
+        return entries[count++];
+    }
+
+    void addBlob(Blob* b) {
+        if (b == NULL || !sent.insert(b->hash)) return;
+        for (int i = 0; i < b->chunkCount; i++) addBlob(b->chunks[i]);
+        push().blob = b;
+    }
+
+    void addTree(Tree* before, Tree* after) {
+        if (after == NULL || after == before || !sent.insert(after->hash)) return;
+        push().tree = after;
+        for (int i = 0; i < after->count; i++) {
+            TreeEntry& e = after->entries[i];
+            TreeEntry* old = before != NULL ? before->find(e.name) : NULL;
+            if (e.tree != NULL) addTree(old != NULL ? old->tree : NULL, e.tree);
+            else if (old == NULL || old->blob != e.blob) addBlob(e.blob);
+        }
+    }
+
+    static void sendRecord(FdStream& io, int type, const ObjectId& id, u64 fast, string_view data) {
+        unsigned char header[RECORD_HEADER_SIZE];
+        encodeRecordHeader(header, type, id, fast, data.length());
+        io.write((const char*)header, RECORD_HEADER_SIZE);
+        io.write(data);
+    }
+
+public:
+    PackEntry* entries;
+    int count;
+    int capacity;
+
+    PackBuilder() : entries(NULL), count(0), capacity(0) {}
+
+    ~PackBuilder() { delete[] entries; }
+
+    void addCommit(Commit* c) {
+        Commit* p = c->parent();
+        addTree(p != NULL ? p->tree : NULL, c->tree);
+        push().commit = c;
+    }
+
+    bool send(FdStream& io) {
+        io.beginHash();
+        io.begin("MGPK");
+        io.writeU32((u32)count);
+        for (int i = 0; i < count && io.ok; i++) {
+            PackEntry& e = entries[i];
+            if (e.commit != NULL) {
+                sendRecord(io, OBJ_COMMIT, e.commit->commitId, 0, encodeCommit(e.commit));
+            } else if (e.tree != NULL) {
+                sendRecord(io, OBJ_TREE, e.tree->hash, fastHash(string_view((const char*)e.tree->hash.bytes, ID_BYTES)),
+                           encodeTree(e.tree));
+            } else if (e.blob->isChunked()) {
+                sendRecord(io, OBJ_CHUNKS, e.blob->hash, e.blob->fast,
+                           encodeChunkList(e.blob->chunks, e.blob->chunkCount, e.blob->size));
+            } else {
+                sendRecord(io, OBJ_BLOB, e.blob->hash, e.blob->fast, e.blob->content());
+            }
+        }
+        ObjectId checksum = io.endHash();
+        io.writeId(checksum);
+        return io.flush();
+    }
+};
+
+bool isRemoteSpec(string_view spec) {
+    size_t colon = spec.rfind(':');
+    if (colon == string_view::npos || colon + 1 >= spec.length()) return false;
+    for (size_t i = colon + 1; i < spec.length(); i++) {
+        if (spec[i] < '0' || spec[i] > '9') return false;
+    }
+    return true;
+}
+
+int connectTo(const string& spec) {
+    size_t colon = spec.rfind(':');
+    string host = colon == 0 ? string("127.0.0.1") : spec.substr(0, colon);
+    string port = spec.substr(colon + 1);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = NULL;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) return -1;
+    int fd = -1;
+    for (addrinfo* a = found; a != NULL && fd < 0; a = a->ai_next) {
+        fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+int listenOn(int port, int& bound) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    socklen_t len = sizeof(addr);
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 8) != 0
+        || getsockname(fd, (sockaddr*)&addr, &len) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    bound = ntohs(addr.sin_port);
+    return fd;
+}
+
+#endif
@@ -0,0 +1,446 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include "minigit.h"
+using namespace std;
+
+const int TREE_ENTRY_BLOB = 1;
+const int TREE_ENTRY_TREE = 2;
+
+class TreeEntry {
+public:
+    string_view name;
+    Blob* blob;
+    Tree* tree;
+
+    TreeEntry() : blob(NULL), tree(NULL) {}
+};
+
+class Tree {
+public:
+    TreeId hash;
+    TreeEntry* entries;
+    int count;
+    int fileCount;
+    Tree* next;
+
+    Tree(const TreeId& h, TreeEntry* e, int n, int files)
+        : hash(h), entries(e), count(n), fileCount(files), next(NULL) {}
+
+    TreeEntry* find(string_view name) const {
+        int lo = 0, hi = count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (entries[mid].name < name) lo = mid + 1;
+            else hi = mid;
+        }
+        return (lo < count && entries[lo].name == name) ? &entries[lo] : NULL;
+    }
+};
+
+class PathChange {
+public:
+    string_view path;
+    Blob* blob;
+};
+
+bool pathBefore(const PathChange& a, const PathChange& b) { return a.path < b.path; }
+
+class PathGroup {
+public:
+    string_view name;
+    int first;
+    int end;
+    bool directory;
+};
+
+bool groupBefore(const PathGroup& a, const PathGroup& b) {
+    int order = a.name.compare(b.name);
+    if (order != 0) return order < 0;
+    if (a.directory != b.directory) return b.directory;
+    return a.first < b.first;
+}
+
+bool entryBefore(const TreeEntry& a, const TreeEntry& b) { return a.name < b.name; }
+
+class ChangeList {
+public:
+    PathChange* items;
+    int count;
+    int capacity;
+
+    ChangeList() : items(NULL), count(0), capacity(0) {}
+
+    ~ChangeList() { delete[] items; }
+
+    void clear() { count = 0; }
+
+    void push(string_view path, Blob* blob) {
+        if (count == capacity) items = growArray(items, count, capacity);
+        items[count].path = path;
+        items[count].blob = blob;
+        count++;
+    }
+
+    void sortByPath() { sort(items, items + count, pathBefore); }
+
+private:
+    ChangeList(const ChangeList&);
+    ChangeList& operator=(const ChangeList&);
+};
+
+class UpdateLevel {
+public:
+    PathGroup* groups;
+    int groupCapacity;
+    TreeEntry* work;
+    int workCapacity;
+
+    UpdateLevel() : groups(NULL), groupCapacity(0), work(NULL), workCapacity(0) {}
+
+    ~UpdateLevel() {
+        delete[] groups;
+        delete[] work;
+    }
+
+    PathGroup* reserveGroups(int n) {
+        if (n > groupCapacity) {
+            delete[] groups;
+            groupCapacity = max(n, groupCapacity * 2);
+            groups = new PathGroup[groupCapacity];
+        }
+        return groups;
+    }
+
+    TreeEntry* reserveWork(int n) {
+        if (n > workCapacity) {
+            delete[] work;
+            workCapacity = max(n, workCapacity * 2);
+            work = new TreeEntry[workCapacity];
+        }
+        return work;
+    }
+
+private:
+    UpdateLevel(const UpdateLevel&);
+    UpdateLevel& operator=(const UpdateLevel&);
+};
+
+class TreeStore {
+private:
+    Arena arena;
+    Tree** buckets;
+    int bucketCount;
+    BlobStore* blobs;
+    UpdateLevel** levels;
+    int levelCount;
+    int levelCapacity;
+
+    UpdateLevel& level(int depth) {
+        while (depth >= levelCount) {
+            if (levelCount == levelCapacity) levels = growArray(levels, levelCount, levelCapacity);
+            levels[levelCount++] = new UpdateLevel();
+        }
+        return *levels[depth];
+    }
+
+    void grow() {
+        Tree** old = buckets;
+        int oldCount = bucketCount;
+        bucketCount *= 2;
+        buckets = new Tree*[bucketCount]();
+        for (int i = 0; i < oldCount; i++) {
+            Tree* curr = old[i];
+            while (curr != NULL) {
+                Tree* next = curr->next;
+                link(curr);
+                curr = next;
+            }
+        }
+        delete[] old;
+    }
+
+    void link(Tree* t) {
+        int b = (int)(t->hash.prefix() % bucketCount);
+        t->next = buckets[b];
+        buckets[b] = t;
+    }
+
+    Tree* update(Tree* base, PathChange* changes, int count, size_t depth, int nesting) {
+        PathGroup* groups = level(nesting).reserveGroups(count);
+        int groupCount = 0;
+        for (int i = 0; i < count; i = groups[groupCount++].end) {
+            string_view rest = changes[i].path.substr(depth);
+            size_t slash = rest.find('/');
+            PathGroup& g = groups[groupCount];
+            g.name = rest.substr(0, slash);
+            g.first = i;
+            g.end = i + 1;
+            g.directory = slash != string_view::npos;
+            if (g.directory) {
+                string_view prefix = changes[i].path.substr(0, depth + slash + 1);
+                while (g.end < count && changes[g.end].path.compare(0, prefix.length(), prefix) == 0) g.end++;
+            }
+        }
+        sort(groups, groups + groupCount, groupBefore);
+
+        int baseCount = (base != NULL) ? base->count : 0;
+        TreeEntry* work = level(nesting).reserveWork(baseCount + groupCount > 0 ? baseCount + groupCount : 1);
+        int n = 0, b = 0, g = 0;
+        bool ok = true;
+        while (ok && (b < baseCount || g < groupCount)) {
+            int order = (b >= baseCount) ? 1 : (g >= groupCount) ? -1 : base->entries[b].name.compare(groups[g].name);
+            if (order < 0) {
+                work[n++] = base->entries[b++];
+                continue;
+            }
+            string_view name = groups[g].name;
+            int first = groups[g].first;
+            TreeEntry entry;
+            if (order == 0) entry = base->entries[b++];
+            else entry.name = blobs->internName(name, fastHash(name));
+            for (; ok && g < groupCount && groups[g].name == name; g++) {
+                if (!groups[g].directory) {
+                    entry.blob = changes[groups[g].first].blob;
+                    continue;
+                }
+                Tree* sub = update(entry.tree, changes + groups[g].first, groups[g].end - groups[g].first,
+                                   depth + name.length() + 1, nesting + 1);
+                if (sub == NULL) ok = false;
+                else entry.tree = (sub->count > 0) ? sub : NULL;
+            }
+            if (ok && entry.blob != NULL && entry.tree != NULL) {
+                conflict = string(changes[first].path.substr(0, depth + name.length()));
+                ok = false;
+            }
+            if (entry.blob != NULL || entry.tree != NULL) work[n++] = entry;
+        }
+        return ok ? intern(work, n) : NULL;
+    }
+
+public:
+    int treeCount;
+    string conflict;
+
+    TreeStore(BlobStore* b)
+        : bucketCount(64), blobs(b), levels(NULL), levelCount(0), levelCapacity(0), treeCount(0) {
+        buckets = new Tree*[bucketCount]();
+    }
+
+    ~TreeStore() {
+        for (int i = 0; i < levelCount; i++) delete levels[i];
+        delete[] levels;
+        delete[] buckets;
+    }
+
+    Tree* find(const ObjectId& id) {
+        for (Tree* t = buckets[id.prefix() % bucketCount]; t != NULL; t = t->next) {
+            if (t->hash == id) return t;
+        }
+        return NULL;
+    }
+
+    int collect(Tree**& out) {
+        out = new Tree*[treeCount > 0 ? treeCount : 1];
+        int n = 0;
+        for (int i = 0; i < bucketCount; i++) {
+            for (Tree* t = buckets[i]; t != NULL; t = t->next) out[n++] = t;
+        }
+        return n;
+    }
+
+    void release(Tree* t) {
+        Tree** link = &buckets[t->hash.prefix() % bucketCount];
+        while (*link != t) link = &(*link)->next;
+        *link = t->next;
+        t->next = NULL;
+        treeCount--;
+    }
+
+    Tree* intern(const TreeEntry* entries, int count) {
+        Sha1Hasher hasher;
+        hasher.update("tree\0", 5);
+        int files = 0;
+        for (int i = 0; i < count; i++) {
+            char kind = (char)(entries[i].tree != NULL ? TREE_ENTRY_TREE : TREE_ENTRY_BLOB);
+            hasher.update(&kind, 1);
+            hasher.update(entries[i].name);
+            hasher.update("\0", 1);
+            if (entries[i].tree != NULL) {
+                hasher.updateHex(entries[i].tree->hash);
+                files += entries[i].tree->fileCount;
+            } else {
+                hasher.updateHex(entries[i].blob->hash);
+                files++;
+            }
+        }
+        TreeId id(hasher.id());
+        Tree* existing = find(id);
+        if (existing != NULL) return existing;
+
+        TreeEntry* own = (TreeEntry*)arena.allocate(sizeof(TreeEntry) * (count > 0 ? count : 1), alignof(TreeEntry));
+        for (int i = 0; i < count; i++) own[i] = entries[i];
+        Tree* t = arena.create<Tree>(id, own, count, files);
+        link(t);
+        treeCount++;
+        if (treeCount > bucketCount) grow();
+        return t;
+    }
+
+    Tree* update(Tree* base, ChangeList& changes) {
+        conflict.clear();
+        if (changes.count == 0) return base != NULL ? base : intern(NULL, 0);
+        changes.sortByPath();
+        return update(base, changes.items, changes.count, 0, 0);
+    }
+
+    Tree* build(FileState& files) {
+        ChangeList all;
+        for (File* f = files.first(); f != NULL; f = files.next(f)) all.push(f->name, f->blob);
+        return update(NULL, all);
+    }
+
+private:
+    TreeStore(const TreeStore&);
+    TreeStore& operator=(const TreeStore&);
+};
+
+class TreeVisitor {
+public:
+    virtual ~TreeVisitor() {}
+    virtual void changed(const string& path, Blob* before, Blob* after) = 0;
+};
+
+void listTree(const TreeEntry& entry, string& path, bool removed, TreeVisitor& visitor) {
+    size_t mark = path.length();
+    path.append(entry.name.data(), entry.name.length());
+    if (entry.tree == NULL) {
+        if (removed) visitor.changed(path, entry.blob, NULL);
+        else visitor.changed(path, NULL, entry.blob);
+    } else {
+        path += '/';
+        for (int i = 0; i < entry.tree->count; i++) listTree(entry.tree->entries[i], path, removed, visitor);
+    }
+    path.resize(mark);
+}
+
+void diffTrees(Tree* a, Tree* b, string& path, TreeVisitor& visitor) {
+    if (a == b) return;
+    int na = (a != NULL) ? a->count : 0;
+    int nb = (b != NULL) ? b->count : 0;
+    int i = 0, j = 0;
+    while (i < na || j < nb) {
+        int order;
+        if (i >= na) order = 1;
+        else if (j >= nb) order = -1;
+        else order = a->entries[i].name.compare(b->entries[j].name);
+
+        if (order < 0) {
+            listTree(a->entries[i++], path, true, visitor);
+        } else if (order > 0) {
+            listTree(b->entries[j++], path, false, visitor);
+        } else {
+            TreeEntry& ea = a->entries[i++];
+            TreeEntry& eb = b->entries[j++];
+            if (ea.tree != NULL && eb.tree != NULL) {
+                if (ea.tree == eb.tree) continue;
+                size_t mark = path.length();
+                path.append(ea.name.data(), ea.name.length());
+                path += '/';
+                diffTrees(ea.tree, eb.tree, path, visitor);
+                path.resize(mark);
+            } else if (ea.tree == NULL && eb.tree == NULL) {
+                if (ea.blob == eb.blob) continue;
+                size_t mark = path.length();
+                path.append(ea.name.data(), ea.name.length());
+                visitor.changed(path, ea.blob, eb.blob);
+                path.resize(mark);
+            } else {
+                listTree(ea, path, true, visitor);
+                listTree(eb, path, false, visitor);
+            }
+        }
+    }
+}
+
+void diffTrees(Tree* a, Tree* b, TreeVisitor& visitor) {
+    string path;
+    diffTrees(a, b, path, visitor);
+}
+
+class SnapshotPatcher : public TreeVisitor {
+public:
+    FileState& files;
+
+    SnapshotPatcher(FileState& f) : files(f) {}
+
+    void changed(const string& path, Blob* before, Blob* after) {
+        (void)before;
+        if (after != NULL) files.putBlob(path, after);
+        else files.removeFile(path);
+    }
+};
+
+Blob* lookupPath(Tree* t, string_view path) {
+    while (t != NULL) {
+        size_t slash = path.find('/');
+        TreeEntry* e = t->find(path.substr(0, slash));
+        if (e == NULL) return NULL;
+        if (slash == string_view::npos) return e->blob;
+        t = e->tree;
+        path.remove_prefix(slash + 1);
+    }
+    return NULL;
+}
+
+void listFiles(Tree* t, FileState& out) {
+    out.clear();
+    SnapshotPatcher patcher(out);
+    diffTrees(NULL, t, patcher);
+}
+
+bool touchesPath(Commit* c, const string& path, u64 key) {
+    if (!c->graph->mayChange(c->node, key)) return false;
+    Commit* p = c->parent();
+    return lookupPath(c->tree, path) != lookupPath(p != NULL ? p->tree : NULL, path);
+}
+
+int printHistory(Commit* node, ostream& out, const LogOptions& opts) {
+    HistoryIterator it(node);
+    u64 key = fastHash(opts.path);
+    int printed = 0, skipped = 0;
+    Commit* c;
+    while ((opts.maxCount < 0 || printed < opts.maxCount) && (c = it.next()) != NULL) {
+        if (c->time < opts.since) {
+            if (it.allBefore(opts.since)) break;
+            continue;
+        }
+        if (!opts.path.empty() && !touchesPath(c, opts.path, key)) continue;
+        if (skipped < opts.skip) {
+            skipped++;
+            continue;
+        }
+        out << "  commit " << c->commitId << '\n';
+        if (c->parentCount() > 1) {
+            out << "  Merge: ";
+            for (int i = 0; i < c->parentCount(); i++) out << ' ' << c->parent(i)->commitId.abbrev(7);
+            out << '\n';
+        }
+        out << "  Date:   " << c->timestamp << '\n'
+            << "  Msg:    " << c->message << '\n'
+            << "  Files:  " << (c->tree != NULL ? c->tree->fileCount : 0) << '\n'
+            << '\n';
+        printed++;
+    }
+    return printed;
+}
+
+void printHistory(Commit* node) {
+    printHistory(node, cout, LogOptions());
+    cout.flush();
+}
+
+#endif
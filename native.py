@@ -0,0 +1,74 @@
+import ctypes
+import json
+import os
+import subprocess
+import threading
+from typing import Optional, Dict
+
+BASE_DIR = os.path.dirname(os.path.abspath(__file__))
+ENGINE_DIR = os.path.join(BASE_DIR, "Cpp logic")
+ABI_VERSION = 1
+
+_build_lock = threading.Lock()
+
+
+def library_path() -> str:
+    return os.environ.get("MINIGIT_LIB", os.path.join(ENGINE_DIR, "libminigit.so"))
+
+
+def build_library(path: str):
+    subprocess.run(
+        ["g++", "-std=c++17", "-O2", "-shared", "-fPIC", "-pthread",
+         "-o", path, os.path.join(ENGINE_DIR, "libminigit.cpp")],
+        check=True,
+    )
+
+
+def load_library() -> ctypes.CDLL:
+    path = library_path()
+    with _build_lock:
+        if not os.path.exists(path):
+            build_library(path)
+    lib = ctypes.CDLL(path)
+
+    lib.mg_abi_version.restype = ctypes.c_int
+    lib.mg_abi_version.argtypes = []
+    lib.mg_host_open.restype = ctypes.c_void_p
+    lib.mg_host_open.argtypes = [ctypes.c_char_p]
+    lib.mg_host_close.restype = None
+    lib.mg_host_close.argtypes = [ctypes.c_void_p]
+    lib.mg_execute.restype = ctypes.c_void_p
+    lib.mg_execute.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p,
+                               ctypes.c_char_p, ctypes.c_char_p]
+    lib.mg_free.restype = None
+    lib.mg_free.argtypes = [ctypes.c_void_p]
+
+    if lib.mg_abi_version() != ABI_VERSION:
+        raise RuntimeError(f"libminigit ABI {lib.mg_abi_version()} does not match {ABI_VERSION}")
+    return lib
+
+
+def _encode(value: Optional[str]) -> Optional[bytes]:
+    return value.encode("utf-8") if value is not None else None
+
+
+class NativeHost:
+
+    def __init__(self, storage_root: str):
+        self.lib = load_library()
+        self.handle = self.lib.mg_host_open(_encode(storage_root))
+
+    def call(self, op: str, repo: Optional[str] = None,
+             arg1: Optional[str] = None, arg2: Optional[str] = None) -> Dict:
+        raw = self.lib.mg_execute(self.handle, _encode(repo), _encode(op), _encode(arg1), _encode(arg2))
+        if not raw:
+            return {"success": False, "message": "Native engine returned no result."}
+        try:
+            return json.loads(ctypes.string_at(raw).decode("utf-8", errors="replace"))
+        finally:
+            self.lib.mg_free(raw)
+
+    def close(self):
+        if self.handle:
+            self.lib.mg_host_close(self.handle)
+            self.handle = None
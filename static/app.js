@@ -7,6 +7,7 @@ const termTitle = document.getElementById("termTitle");
 
 let history = [];
 let histIdx = -1;
+let activeRepo = null;
 
 
 input.addEventListener("keydown", (e) => {
@@ -56,7 +57,9 @@ async function api(method, endpoint, body = null) {
     try {
         const opts = { method, headers: { "Content-Type": "application/json" } };
         if (body) opts.body = JSON.stringify(body);
-        const res = await fetch(API + endpoint, opts);
+        const url = activeRepo ? API + endpoint + (endpoint.includes("?") ? "&" : "?") + "repo=" + encodeURIComponent(activeRepo)
+                               : API + endpoint;
+        const res = await fetch(url, opts);
         return await res.json();
     } catch (err) {
         return { success: false, message: "Connection error: " + err.message };
@@ -189,11 +192,13 @@ async function handleCommand(raw) {
             if (!filename) { printLine("Usage: diff <filename>", "error"); break; }
             const r = await api("POST", "/diff", { filename });
             printLine(r.message, r.success ? (r.status === "modified" ? "error" : "success") : "error");
-            if (r.committedContent !== undefined) {
-                printLine("\n  --- committed ---", "info");
-                printLine("  " + r.committedContent, "info");
-                printLine("  --- working ---", "info");
-                printLine("  " + r.workingContent, "info");
+            if (r.hunks && r.hunks.length > 0) {
+                printLine("\n  --- a/" + r.filename, "info");
+                printLine("  +++ b/" + r.filename, "info");
+                r.hunks.forEach((h) => {
+                    printLine("  @@ -" + h.oldStart + "," + h.oldCount + " +" + h.newStart + "," + h.newCount + " @@", "heading");
+                    h.lines.forEach((l) => printLine("  " + l, l[0] === "+" ? "success" : l[0] === "-" ? "error" : "info"));
+                });
             }
             break;
         }
@@ -280,13 +285,17 @@ async function handleRepoCommand(parts) {
             if (!name) { printLine("Usage: repo create <name>", "error"); return; }
             const r = await api("POST", "/repo/create", { name });
             printLine(r.message, r.success ? "success" : "error");
+            if (r.success) activeRepo = name;
             break;
         }
         case "switch": {
             if (!name) { printLine("Usage: repo switch <name>", "error"); return; }
             const r = await api("POST", "/repo/switch", { name });
             printLine(r.message, r.success ? "success" : "error");
-            if (r.success) refreshAll();
+            if (r.success) {
+                activeRepo = name;
+                refreshAll();
+            }
             break;
         }
         case "delete": {
@@ -1,16 +0,0 @@
-import json
-import os
-
-FILE = "data.json"
-
-
-def load_data():
-    if not os.path.exists(FILE):
-        return []
-    with open(FILE, "r") as f:
-        return json.load(f)
-
-
-def save_data(data):
-    with open(FILE, "w") as f:
-        json.dump(data, f, indent=4)